@@ -1,82 +1,133 @@
+// Base 10 conversion of 256-bit integers
+//
+//     A 256-bit value is at most five groups of 19 digits, one limb of radix
+//     10^19 each (10^19 < 2^64).  Printing divides the limbs by 10^19 until
+//     they are zero (at most 4 times 4 128/64-bit divisions) and writes each
+//     group two digits at a time from a table.  Parsing is the reverse, a
+//     multiply-accumulate of the limbs per group of 19 digits.
 
-#include <stddef.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include "base10.h"
-#include "utils.h"
-
-void decimalint_add(DecimalInt out, const DecimalInt x1, const DecimalInt x2) {
-  uint8_t carry = 0;
+#include <string.h>
 
-  for (size_t i = 0; i < DIGITS; ++i) {
-    const uint8_t a = x1[i] + x2[i] + carry;
-    out[i] = a % 10;
-    carry = a / 10;
-  }
+#include "base10.h"
 
-  if (carry != 0) {
-    printf("decimalint_add: overflow");
-    exit(1);
-  }
+typedef unsigned __int128 uint128_t;
+
+#define DEC_RADIX  10000000000000000000ull // 10^19
+#define DEC_DIGITS 19
+#define DEC_GROUPS 5
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Returns (hi*2^64 + lo) / 10^19 and sets *rem to the remainder, for hi < 10^19
+static inline uint64_t div_radix(const uint64_t hi, const uint64_t lo, uint64_t *rem)
+{
+#if defined(__x86_64__)
+    uint64_t q, r;
+    __asm__("divq %4" : "=a"(q), "=d"(r) : "a"(lo), "d"(hi), "r"(DEC_RADIX));
+    *rem = r;
+    return q;
+#else
+    const uint128_t n = ((uint128_t)hi << 64) | lo;
+    *rem = (uint64_t)(n % DEC_RADIX);
+    return (uint64_t)(n / DEC_RADIX);
+#endif
 }
 
-void decimalint_copy(DecimalInt out, const DecimalInt x) {
-  for (size_t i = 0; i < DIGITS; ++i) {
-    out[i] = x[i];
-  }
+// The DEC_DIGITS digits of x < 10^19, zero padded
+static void group_to_digits(char out[DEC_DIGITS], uint64_t x)
+{
+    for (size_t i = DEC_DIGITS - 2; i < DEC_DIGITS; i -= 2) {
+        memcpy(&out[i], &digit_pairs[2*(x % 100)], 2);
+        x /= 100;
+    }
+    out[0] = '0' + x;
 }
 
-void decimalint_from_bigint(DecimalInt out, const uint64_t x[4]) {
-  const size_t NUM_BITS = 64 * 4;
-
-  DecimalInt tmp;
-
-  DecimalInt one;
-  one[0] = 1;
-  for (size_t i = 1; i < DIGITS; ++i) {
-    one[i] = 0;
-  }
-
-  for (size_t i = 0; i < DIGITS; ++i) {
-    out[i] = 0;
-  }
-
-  // Double and add
-  for (size_t i = 0; i < NUM_BITS; ++i) {
-    decimalint_add(tmp, out, out);
+size_t bigint_to_string(char *out, const uint64_t x[4])
+{
+    uint64_t n[4] = { x[0], x[1], x[2], x[3] };
+    size_t top = 4;
+    while (top > 0 && n[top - 1] == 0) {
+        top--;
+    }
 
-    const size_t j = NUM_BITS - 1 - i;
-    size_t limb_idx = j / 64;
-    size_t in_limb_idx = (j % 64);
-    bool bj = (x[limb_idx] >> in_limb_idx) & 1;
+    // Least significant group first, each division removes almost a limb
+    uint64_t groups[DEC_GROUPS];
+    size_t count = 0;
+    do {
+        uint64_t rem = 0;
+        for (size_t i = top; i-- > 0;) {
+            n[i] = div_radix(rem, n[i], &rem);
+        }
+        groups[count++] = rem;
+        while (top > 0 && n[top - 1] == 0) {
+            top--;
+        }
+    } while (top > 0);
+
+    // The top group without its leading zeros
+    char digits[DEC_DIGITS];
+    group_to_digits(digits, groups[count - 1]);
+    size_t skip = 0;
+    while (skip < DEC_DIGITS - 1 && digits[skip] == '0') {
+        skip++;
+    }
+    size_t len = DEC_DIGITS - skip;
+    memcpy(out, &digits[skip], len);
 
-    if (bj) {
-      decimalint_add(out, tmp, one);
-    } else {
-      decimalint_copy(out, tmp);
+    for (size_t g = count - 1; g-- > 0;) {
+        group_to_digits(&out[len], groups[g]);
+        len += DEC_DIGITS;
     }
-  }
-}
+    out[len] = '\0';
 
-void decimalint_to_string(char* out, const DecimalInt x) {
-  int i = DIGITS - 1;
+    return len;
+}
 
-  while (x[i] == 0 && i != 0) {
-    i -= 1;
-  }
+bool bigint_from_string(uint64_t x[4], const char *str)
+{
+    const size_t len = strlen(str);
+    if (len == 0) {
+        return false;
+    }
 
-  size_t j = 0;
-  while (i >= 0) {
-    out[j] = '0' + x[i];
+    // The first group takes the remainder of the digits
+    uint64_t n[4] = { 0, 0, 0, 0 };
+    size_t group_len = len % DEC_DIGITS ? len % DEC_DIGITS : DEC_DIGITS;
+    for (size_t i = 0; i < len; i += group_len, group_len = DEC_DIGITS) {
+        uint64_t group = 0;
+        uint64_t scale = 1;
+        for (size_t j = i; j < i + group_len; j++) {
+            const unsigned digit = (unsigned char)str[j] - '0';
+            if (digit > 9) {
+                return false;
+            }
+            group = 10*group + digit;
+            scale *= 10;
+        }
+
+        // n = n*10^group_len + group
+        uint128_t acc = group;
+        for (size_t k = 0; k < 4; k++) {
+            acc += (uint128_t)n[k] * scale;
+            n[k] = (uint64_t)acc;
+            acc >>= 64;
+        }
+        if (acc != 0) {
+            return false;
+        }
+    }
 
-    i -= 1;
-    j += 1;
-  }
-  out[j] = '\0';
+    memcpy(x, n, sizeof(n));
+    return true;
 }
-
-void bigint_to_string(char* out, const uint64_t x[4]) {
-  DecimalInt tmp;
-  decimalint_from_bigint(tmp, x);
-  decimalint_to_string(out, tmp);
-}
\ No newline at end of file
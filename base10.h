@@ -1,6 +1,18 @@
+#pragma once
+
 #include <stdint.h>
-#define DIGITS 78
+#include <stddef.h>
+#include <stdbool.h>
+
+#define DIGITS 78 // of 2^256 - 1
 
-typedef uint8_t DecimalInt[DIGITS];
+// Writes x (little endian limbs) in base 10 without leading zeros, plus the
+// terminating null, to out, which must hold DIGITS + 1 bytes (DIGITS for
+// values below 10^77, which includes all field elements and scalars).
+// Returns the number of digits.
+size_t bigint_to_string(char *out, const uint64_t x[4]);
 
-void bigint_to_string(char* out, const uint64_t x[4]);
+// Parses a non-empty string of decimal digits, leading zeros allowed, into
+// x.  Returns false if str has any other character or the value does not
+// fit in 256 bits.
+bool bigint_from_string(uint64_t x[4], const char *str);
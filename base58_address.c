@@ -0,0 +1,137 @@
+// Fixed-length base58 for Mina addresses
+//
+//     The generic b58enc/b58tobin convert one base58 digit (or one byte) at a
+//     time, with a division per byte of the intermediate buffer, quadratic in
+//     the length.  Here the 40 byte payload is five 64-bit limbs and the 55
+//     digits are six groups of up to ten digits, one limb of radix 58^10 each
+//     (58^10 < 2^64).  Encoding divides the limbs by 58^10 five times (25
+//     128/64-bit divisions) and splits each group with divisions by the
+//     constant 58; decoding is the reverse with multiplications.
+
+#include <string.h>
+
+#include "base58_address.h"
+
+typedef unsigned __int128 uint128_t;
+
+#define B58_RADIX  430804206899405824ull // 58^10
+#define B58_LIMBS  5
+#define B58_GROUPS 6                     // 5 + 5*10 digits
+#define B58_TOP_DIGITS (B58_ADDRESS_DIGITS - 10*(B58_GROUPS - 1))
+#define B58_MIN_TOP    11316496ull       // 58^4, the top digit is not zero
+
+static const char b58digits_ordered[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+static const int8_t b58digits_map[] = {
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1, 0, 1, 2, 3, 4, 5, 6,  7, 8,-1,-1,-1,-1,-1,-1,
+    -1, 9,10,11,12,13,14,15, 16,-1,17,18,19,20,21,-1,
+    22,23,24,25,26,27,28,29, 30,31,32,-1,-1,-1,-1,-1,
+    -1,33,34,35,36,37,38,39, 40,41,42,43,-1,44,45,46,
+    47,48,49,50,51,52,53,54, 55,56,57,-1,-1,-1,-1,-1,
+};
+
+// Returns (hi*2^64 + lo) / 58^10 and sets *rem to the remainder, for hi < 58^10
+static inline uint64_t div_radix(const uint64_t hi, const uint64_t lo, uint64_t *rem)
+{
+#if defined(__x86_64__)
+    uint64_t q, r;
+    __asm__("divq %4" : "=a"(q), "=d"(r) : "a"(lo), "d"(hi), "r"(B58_RADIX));
+    *rem = r;
+    return q;
+#else
+    const uint128_t n = ((uint128_t)hi << 64) | lo;
+    *rem = (uint64_t)(n % B58_RADIX);
+    return (uint64_t)(n / B58_RADIX);
+#endif
+}
+
+bool b58enc_address(char b58[B58_ADDRESS_DIGITS + 1], const uint8_t bin[B58_ADDRESS_BYTES])
+{
+    // Big endian limbs, n[0] is the most significant
+    uint64_t n[B58_LIMBS];
+    for (size_t i = 0; i < B58_LIMBS; i++) {
+        n[i] = 0;
+        for (size_t j = 0; j < 8; j++) {
+            n[i] = (n[i] << 8) | bin[8*i + j];
+        }
+    }
+
+    // Each division removes almost a limb, skip the leading zero limbs
+    uint64_t groups[B58_GROUPS];
+    size_t first = 0;
+    for (size_t g = B58_GROUPS - 1; g > 0; g--) {
+        uint64_t rem = 0;
+        for (size_t i = first; i < B58_LIMBS; i++) {
+            n[i] = div_radix(rem, n[i], &rem);
+        }
+        groups[g] = rem;
+        while (first < B58_LIMBS - 1 && n[first] == 0) {
+            first++;
+        }
+    }
+    groups[0] = n[B58_LIMBS - 1];
+
+    // Fewer than 55 digits, or more than 40 bytes could hold
+    if (groups[0] < B58_MIN_TOP) {
+        b58[0] = '\0';
+        return false;
+    }
+
+    char *out = &b58[B58_TOP_DIGITS - 1];
+    for (size_t j = 0; j < B58_TOP_DIGITS; j++) {
+        *out-- = b58digits_ordered[groups[0] % 58];
+        groups[0] /= 58;
+    }
+    for (size_t g = 1; g < B58_GROUPS; g++) {
+        out = &b58[B58_TOP_DIGITS + 10*g - 1];
+        for (size_t j = 0; j < 10; j++) {
+            *out-- = b58digits_ordered[groups[g] % 58];
+            groups[g] /= 58;
+        }
+    }
+    b58[B58_ADDRESS_DIGITS] = '\0';
+
+    return true;
+}
+
+bool b58tobin_address(uint8_t bin[B58_ADDRESS_BYTES], const char *b58)
+{
+    if (strnlen(b58, B58_ADDRESS_DIGITS + 1) != B58_ADDRESS_DIGITS) {
+        return false;
+    }
+
+    uint64_t n[B58_LIMBS] = { 0 };
+    const unsigned char *in = (const unsigned char *)b58;
+    for (size_t g = 0; g < B58_GROUPS; g++) {
+        const size_t digits = g == 0 ? B58_TOP_DIGITS : 10;
+        uint64_t v = 0;
+        for (size_t j = 0; j < digits; j++) {
+            const unsigned char c = *in++;
+            if (c & 0x80 || b58digits_map[c] < 0) {
+                return false;
+            }
+            v = v*58 + (uint64_t)b58digits_map[c];
+        }
+
+        // n = n*58^10 + v
+        uint128_t acc = v;
+        for (size_t i = B58_LIMBS; i-- > 0; ) {
+            acc += (uint128_t)n[i]*(g == 0 ? 0 : B58_RADIX);
+            n[i] = (uint64_t)acc;
+            acc >>= 64;
+        }
+        if (acc != 0) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < B58_LIMBS; i++) {
+        for (size_t j = 0; j < 8; j++) {
+            bin[8*i + j] = (uint8_t)(n[i] >> (56 - 8*j));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,20 @@
+// Fixed-length base58 for Mina addresses
+//
+//     Equivalent to b58enc/b58tobin for the 40 byte address payload (version,
+//     compressed public key and checksum) and its 55 character encoding, which
+//     always has exactly 55 digits because the version byte is 0xcb.
+//
+//     b58enc_address writes 55 characters and a null byte to b58, and fails
+//     if the value would not need all 55 digits.  b58tobin_address fails
+//     unless b58 is exactly 55 base58 digits whose value fits in 40 bytes.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define B58_ADDRESS_BYTES  40
+#define B58_ADDRESS_DIGITS 55
+
+bool b58enc_address(char b58[B58_ADDRESS_DIGITS + 1], const uint8_t bin[B58_ADDRESS_BYTES]);
+bool b58tobin_address(uint8_t bin[B58_ADDRESS_BYTES], const char *b58);
@@ -0,0 +1,982 @@
+// Benchmarks of the signer's primitives
+//
+//     ./benchmarks [--json] [name filter], or make bench [BENCH_ARGS=...]
+//
+//     Every benchmark runs its operation n times in a loop.  It is first
+//     warmed up for BENCH_WARMUP_NS and sized so that one call takes about
+//     BENCH_SAMPLE_NS, then timed over BENCH_SAMPLES calls.  The report has
+//     the median, 10th and 90th percentile and minimum of the time per
+//     operation over the samples, TSC cycles per operation of the median
+//     sample (x86 only, 0 elsewhere) and operations per second at the
+//     median.  Operations are chained (x = f(x)) where they can be, so the
+//     numbers are latencies.  Batch APIs are timed per element (key,
+//     address, hash) over batches of BENCH_BATCH, MSMs per call.  Backends
+//     the CPU does not support are skipped.
+//
+//     --json prints one object with every result instead of the table, for
+//     comparing builds.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crypto.h"
+#include "pasta_fp.h"
+#include "pasta_fq.h"
+#include "pasta_sparse.h"
+#include "pasta_adx.h"
+#include "poseidon.h"
+#include "blake2.h"
+#include "sha256.h"
+#include "sha256_simd.h"
+#include "blake2b_simd.h"
+#include "base10.h"
+#include "libbase58.h"
+#include "base58_address.h"
+#include "msm.h"
+#include "keygen.h"
+#include "vanity.h"
+#include "cpu.h"
+#include "dispatch.h"
+#include "signer_context.h"
+#include "signature_cache.h"
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#define BENCH_WARMUP_NS 20000000ull // 20 ms
+#define BENCH_SAMPLE_NS  5000000ull //  5 ms
+#define BENCH_SAMPLES   21
+#define BENCH_BATCH     1024
+#define BENCH_MSM_MAX   ((size_t)1 << 16)
+
+#define DEFAULT_TOKEN_ID 1
+
+typedef struct bench_t {
+    const char *name;
+    void (*run)(size_t n);
+    bool (*supported)(void);    // NULL if always
+} Bench;
+
+typedef struct bench_result_t {
+    size_t ops_per_sample;
+    double ns_median;
+    double ns_p10;
+    double ns_p90;
+    double ns_min;
+    double cycles;
+    double ops_per_sec;
+} BenchResult;
+
+// Inputs, set up once by bench_setup
+
+static Field _a, _b;
+static Scalar _s, _t;
+static Group _p, _q;
+static Affine _pub;
+static Keypair _kp;
+static Compressed _pub_compressed;
+static Transaction _txn;
+static Signature _sig;
+static SignerContext _ctx;
+static SignatureCache _cache;
+static uint8_t _record[TRANSACTION_BYTES];
+static uint8_t _sig_record[SIGNATURE_BYTES];
+static uint8_t _pub_record[COMPRESSED_BYTES];
+static uint8_t _message[400];
+static uint8_t _address_bin[B58_ADDRESS_BYTES];
+static char _address[MINA_ADDRESS_LEN];
+static Keypair _keypairs[BENCH_BATCH];
+static char _addresses[BENCH_BATCH][MINA_ADDRESS_LEN];
+static const char *_address_ptrs[BENCH_BATCH];
+static Compressed _parsed[BENCH_BATCH];
+static AddressStatus _parse_status[BENCH_BATCH];
+static uint8_t _hash_msgs[64][400];
+static uint8_t _hash_digests[64][SHA256_BLOCK_SIZE];
+static uint64_t _derive_fields[LIMBS_PER_FIELD*3];
+static uint8_t _derive_bits[75];
+static DeriveCtx _derive;
+
+// Built on first use by msm_setup, (i + 1)*G with random scalars
+static Affine _msm_points[BENCH_MSM_MAX];
+static Scalar _msm_scalars[BENCH_MSM_MAX];
+
+// Results go here so the loops are not optimized away
+static volatile uint64_t _sink;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void)
+{
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void bench_setup(void)
+{
+    const uint64_t a[4] = { 0x2f474795455d409d, 0xb443b9b74b8255d9, 0x270c412f2c9a5d66, 0x08e00f71ba43dd6b };
+    const uint64_t b[4] = { 0x34786d38fffffffd, 0x992c350be41914ad, 0x7fffffffffffffff, 0x3fffffffffffffff };
+    field_copy(_a, a);
+    field_copy(_b, b);
+    scalar_from_words(_s, a);
+    scalar_from_words(_t, b);
+
+    generate_pubkey(&_pub, _s);
+    affine_to_group(&_p, &_pub);
+    group_dbl(&_q, &_p);
+
+    scalar_copy(_kp.priv, _s);
+    _kp.pub = _pub;
+    compress(&_pub_compressed, &_pub);
+
+    // The payment from reference_signer.c
+    prepare_memo(_txn.memo, "this is a memo");
+    _txn.fee = 3;
+    _txn.fee_token = DEFAULT_TOKEN_ID;
+    read_public_key_compressed(&_txn.fee_payer_pk, "B62qiy32p8kAKnny8ZFwoMhYpBppM1DWVCqAPBYNcXnsAHhnfAAuXgg");
+    _txn.nonce = 200;
+    _txn.valid_until = 10000;
+    _txn.tag[0] = 0;
+    _txn.tag[1] = 0;
+    _txn.tag[2] = 0;
+    _txn.source_pk = _txn.fee_payer_pk;
+    read_public_key_compressed(&_txn.receiver_pk, "B62qrcFstkpqXww1EkSGrqMCwCNho86kuqBd4FrAAUsPxNKdiPzAUsy");
+    _txn.token_id = DEFAULT_TOKEN_ID;
+    _txn.amount = 42;
+    _txn.token_locked = false;
+    sign(&_sig, &_kp, &_txn, MAINNET_ID);
+    signer_context_init(&_ctx, MAINNET_ID);
+    signature_cache_init(&_cache, 1024);
+    transaction_to_bytes(_record, &_txn);
+    signature_to_bytes(_sig_record, &_sig);
+    compressed_to_bytes(_pub_record, &_pub_compressed);
+
+    for (size_t i = 0; i < sizeof(_message); i++) {
+        _message[i] = (uint8_t)(i * 131 + 7);
+    }
+    generate_address(_address, sizeof(_address), &_pub);
+    b58tobin_address(_address_bin, _address);
+
+    generate_keypairs_batch(_keypairs, BENCH_BATCH);
+    generate_addresses_batch(&_addresses[0][0], _keypairs, BENCH_BATCH, 1);
+    for (size_t i = 0; i < BENCH_BATCH; i++) {
+        _address_ptrs[i] = _addresses[i];
+    }
+    for (size_t i = 0; i < 64; i++) {
+        memcpy(_hash_msgs[i], _message, sizeof(_hash_msgs[i]));
+        _hash_msgs[i][0] = (uint8_t)i;
+    }
+
+    // Shaped like a payment: three fields and 599 bits
+    field_copy(&_derive_fields[0], _a);
+    field_copy(&_derive_fields[LIMBS_PER_FIELD], _b);
+    field_copy(&_derive_fields[2*LIMBS_PER_FIELD], _a);
+    memcpy(_derive_bits, _message, sizeof(_derive_bits));
+    derive_init(&_derive, &_kp, MAINNET_ID);
+}
+
+// Field and scalar arithmetic
+
+static void run_field_mul(size_t n)
+{
+    Field x;
+    field_copy(x, _a);
+    for (size_t i = 0; i < n; i++) {
+        field_mul(x, x, _b);
+    }
+    _sink = x[0];
+}
+
+static void run_field_sq(size_t n)
+{
+    Field x;
+    field_copy(x, _a);
+    for (size_t i = 0; i < n; i++) {
+        field_sq(x, x);
+    }
+    _sink = x[0];
+}
+
+// The multiplication backends directly, rather than through dispatch
+
+static void run_mul_with(void (*mul)(uint64_t[4], const uint64_t[4], const uint64_t[4]), size_t n)
+{
+    Field x;
+    field_copy(x, _a);
+    for (size_t i = 0; i < n; i++) {
+        mul(x, x, _b);
+    }
+    _sink = x[0];
+}
+
+static void run_sq_with(void (*sq)(uint64_t[4], const uint64_t[4]), size_t n)
+{
+    Field x;
+    field_copy(x, _a);
+    for (size_t i = 0; i < n; i++) {
+        sq(x, x);
+    }
+    _sink = x[0];
+}
+
+static void run_fp_mul_fiat(size_t n)   { run_mul_with(fiat_pasta_fp_mul, n); }
+static void run_fp_sq_fiat(size_t n)    { run_sq_with(fiat_pasta_fp_square, n); }
+static void run_fq_mul_fiat(size_t n)   { run_mul_with(fiat_pasta_fq_mul, n); }
+static void run_fq_sq_fiat(size_t n)    { run_sq_with(fiat_pasta_fq_square, n); }
+static void run_fp_mul_sparse(size_t n) { run_mul_with(pasta_fp_mul_sparse, n); }
+static void run_fp_sq_sparse(size_t n)  { run_sq_with(pasta_fp_square_sparse, n); }
+static void run_fq_mul_sparse(size_t n) { run_mul_with(pasta_fq_mul_sparse, n); }
+static void run_fq_sq_sparse(size_t n)  { run_sq_with(pasta_fq_square_sparse, n); }
+static void run_fp_mul_adx(size_t n)    { run_mul_with(pasta_fp_mul_adx, n); }
+static void run_fp_sq_adx(size_t n)     { run_sq_with(pasta_fp_square_adx, n); }
+static void run_fq_mul_adx(size_t n)    { run_mul_with(pasta_fq_mul_adx, n); }
+static void run_fq_sq_adx(size_t n)     { run_sq_with(pasta_fq_square_adx, n); }
+
+static void run_field_inv(size_t n)
+{
+    Field x;
+    field_copy(x, _a);
+    for (size_t i = 0; i < n; i++) {
+        field_inv(x, x);
+    }
+    _sink = x[0];
+}
+
+static void run_field_sqrt(size_t n)
+{
+    // Squares have roots, and x^2 chains through the root's square
+    Field x, y;
+    field_sq(x, _a);
+    for (size_t i = 0; i < n; i++) {
+        fiat_pasta_fp_sqrt(y, x);
+        field_sq(x, y);
+    }
+    _sink = x[0];
+}
+
+static void run_scalar_mul(size_t n)
+{
+    Scalar x;
+    scalar_copy(x, _s);
+    for (size_t i = 0; i < n; i++) {
+        scalar_mul(x, x, _t);
+    }
+    _sink = x[0];
+}
+
+// Group operations
+
+static void run_group_dbl(size_t n)
+{
+    Group r = _p, t;
+    for (size_t i = 0; i < n; i++) {
+        group_dbl(&t, &r);
+        r = t;
+    }
+    _sink = r.X[0];
+}
+
+static void run_group_add(size_t n)
+{
+    Group r = _p, t;
+    for (size_t i = 0; i < n; i++) {
+        group_add(&t, &r, &_q);
+        r = t;
+    }
+    _sink = r.X[0];
+}
+
+static void run_group_madd(size_t n)
+{
+    Group r = _q, t;
+    for (size_t i = 0; i < n; i++) {
+        group_madd(&t, &r, &_p);
+        r = t;
+    }
+    _sink = r.X[0];
+}
+
+static void run_group_scalar_mul(size_t n)
+{
+    Group r = _p, t;
+    for (size_t i = 0; i < n; i++) {
+        group_scalar_mul(&t, _s, &r);
+        r = t;
+    }
+    _sink = r.X[0];
+}
+
+// The ladder used for secret scalars, on a normalized point
+static void run_group_scalar_mul_coz(size_t n)
+{
+    Group r;
+    Scalar k;
+    scalar_copy(k, _s);
+    for (size_t i = 0; i < n; i++) {
+        group_scalar_mul_coz(&r, k, &_pub);
+        k[0] ^= r.X[0] & 0xff;
+    }
+    _sink = k[0];
+}
+
+static void run_generator_mul_public(size_t n)
+{
+    Group r;
+    Scalar k;
+    scalar_copy(k, _s);
+    for (size_t i = 0; i < n; i++) {
+        generator_mul_public(&r, k);
+        k[0] ^= r.X[0] & 0xff;
+    }
+    _sink = k[0];
+}
+
+static void run_generator_mul_secret(size_t n)
+{
+    Group r;
+    Scalar k;
+    scalar_copy(k, _s);
+    for (size_t i = 0; i < n; i++) {
+        generator_mul_secret(&r, k);
+        k[0] ^= r.X[0] & 0xff;
+    }
+    _sink = k[0];
+}
+
+static void msm_setup(void)
+{
+    static bool done;
+    if (done) {
+        return;
+    }
+    static Group chain[BENCH_MSM_MAX];
+    Group acc = _p, tmp;
+    for (size_t i = 0; i < BENCH_MSM_MAX; i++) {
+        chain[i] = acc;
+        group_madd(&tmp, &acc, &_p);
+        acc = tmp;
+        scalar_copy(_msm_scalars[i], _s);
+        _msm_scalars[i][0] ^= i*0x9e3779b97f4a7c15ULL;
+    }
+    affine_from_group_batch(_msm_points, chain, BENCH_MSM_MAX);
+    done = true;
+}
+
+// One MSM of size points per operation
+static void run_msm(const size_t size, size_t n)
+{
+    Group r;
+    msm_setup();
+    for (size_t i = 0; i < n; i++) {
+        group_msm(&r, _msm_scalars, _msm_points, size);
+    }
+    _sink = r.X[0];
+}
+
+static void run_msm_256(size_t n)   { run_msm(256, n); }
+static void run_msm_4096(size_t n)  { run_msm(4096, n); }
+static void run_msm_65536(size_t n) { run_msm(65536, n); }
+
+// Keys and addresses
+
+static void run_generate_keypair(size_t n)
+{
+    Keypair kp;
+    for (size_t i = 0; i < n; i++) {
+        generate_keypair(&kp, 0);
+    }
+    _sink = kp.pub.x[0];
+}
+
+static void run_generate_keypairs_batch(size_t n)
+{
+    static Keypair kps[BENCH_BATCH];
+    for (size_t done = 0; done < n; done += BENCH_BATCH) {
+        generate_keypairs_batch(kps, n - done < BENCH_BATCH ? n - done : BENCH_BATCH);
+    }
+    _sink = kps[0].pub.x[0];
+}
+
+static void run_addresses_batch(const size_t threads, size_t n)
+{
+    static char addresses[BENCH_BATCH][MINA_ADDRESS_LEN];
+    for (size_t done = 0; done < n; done += BENCH_BATCH) {
+        generate_addresses_batch(&addresses[0][0], _keypairs, n - done < BENCH_BATCH ? n - done : BENCH_BATCH, threads);
+    }
+    _sink = (uint8_t)addresses[0][10];
+}
+
+static void run_addresses_batch_1t(size_t n) { run_addresses_batch(1, n); }
+static void run_addresses_batch_4t(size_t n) { run_addresses_batch(4, n); }
+
+static void run_vanity(const size_t threads, size_t n)
+{
+    // A full address is never found, every candidate is checked
+    const char *unreachable = "B62qoCvDGrbMFn5bj7PRmQC7CVvXzNQSoXXo5BmwVGTZUdUV3aCgkaK";
+    Keypair kp;
+    char address[MINA_ADDRESS_LEN];
+    uint64_t candidates;
+    vanity_search(&kp, address, sizeof(address), unreachable, threads, n, &candidates);
+    _sink = candidates;
+}
+
+static void run_vanity_1t(size_t n) { run_vanity(1, n); }
+static void run_vanity_4t(size_t n) { run_vanity(4, n); }
+
+static void run_read_public_key(size_t n)
+{
+    Compressed c;
+    for (size_t i = 0; i < n; i++) {
+        read_public_key_compressed(&c, _address_ptrs[i % BENCH_BATCH]);
+    }
+    _sink = c.x[0];
+}
+
+static void run_parse_addresses_batch(size_t n)
+{
+    for (size_t done = 0; done < n; done += BENCH_BATCH) {
+        parse_addresses_batch(_parsed, _parse_status, _address_ptrs, n - done < BENCH_BATCH ? n - done : BENCH_BATCH);
+    }
+    _sink = _parsed[0].x[0];
+}
+
+// Hashes and encodings
+
+static void run_poseidon(const uint8_t type, size_t n)
+{
+    // Three fields, as in a legacy payment's random oracle input
+    Field input[3];
+    field_copy(input[0], _a);
+    field_copy(input[1], _b);
+    field_copy(input[2], _a);
+    for (size_t i = 0; i < n; i++) {
+        PoseidonCtx ctx;
+        Scalar out;
+        poseidon_init(&ctx, type, MAINNET_ID);
+        poseidon_update(&ctx, input, 3);
+        poseidon_digest(out, &ctx);
+        input[0][0] ^= out[0];
+    }
+    _sink = input[0][0];
+}
+
+static void run_poseidon_legacy(size_t n)
+{
+    run_poseidon(POSEIDON_LEGACY, n);
+}
+
+static void run_poseidon_kimchi(size_t n)
+{
+    run_poseidon(POSEIDON_KIMCHI, n);
+}
+
+static void run_blake2b_with(const unsigned backend, size_t n)
+{
+    uint8_t out[32];
+    for (size_t i = 0; i < n; i++) {
+        blake2b_with(backend, out, sizeof(out), _message, sizeof(_message), NULL, 0);
+        _message[0] = out[0];
+    }
+    _sink = _message[0];
+}
+
+// Per message, in batches of 64 messages of 400 bytes
+static void run_blake2b_many_with(const unsigned backend, size_t n)
+{
+    static uint8_t digests[64][32];
+    const void *in[64];
+    size_t inlen[64];
+    for (size_t i = 0; i < 64; i++) {
+        in[i] = _hash_msgs[i];
+        inlen[i] = sizeof(_hash_msgs[i]);
+    }
+    for (size_t done = 0; done < n; done += 64) {
+        blake2b_many_with(backend, digests, 32, in, inlen, n - done < 64 ? n - done : 64);
+    }
+    _sink = digests[0][0];
+}
+
+static void run_blake2b_generic(size_t n)      { run_blake2b_with(BLAKE2B_SIMD_GENERIC, n); }
+static void run_blake2b_avx2(size_t n)         { run_blake2b_with(BLAKE2B_SIMD_AVX2, n); }
+static void run_blake2b_many_generic(size_t n) { run_blake2b_many_with(BLAKE2B_SIMD_GENERIC, n); }
+static void run_blake2b_many_avx2(size_t n)    { run_blake2b_many_with(BLAKE2B_SIMD_AVX2, n); }
+
+static void run_blake2b(size_t n)
+{
+    uint8_t out[32];
+    for (size_t i = 0; i < n; i++) {
+        blake2b(out, sizeof(out), _message, sizeof(_message), NULL, 0);
+        _message[0] = out[0];
+    }
+    _sink = _message[0];
+}
+
+static void run_sha256(size_t n)
+{
+    // The address checksum input
+    uint8_t out[SHA256_BLOCK_SIZE];
+    for (size_t i = 0; i < n; i++) {
+        sha256_hash(_address_bin, B58_ADDRESS_BYTES - 4, out, sizeof(out));
+        _address_bin[4] = out[0];
+    }
+    _sink = _address_bin[4];
+}
+
+static void run_sha256_with(const unsigned backend, size_t n)
+{
+    uint8_t out[SHA256_BLOCK_SIZE];
+    for (size_t i = 0; i < n; i++) {
+        sha256_hash_with(backend, _address_bin, B58_ADDRESS_BYTES - 4, out);
+        _address_bin[4] = out[0];
+    }
+    _sink = _address_bin[4];
+}
+
+// Per message, in batches of 64 checksum inputs
+static void run_sha256_many_with(const int backend, size_t n)
+{
+    for (size_t done = 0; done < n; done += 64) {
+        const size_t count = n - done < 64 ? n - done : 64;
+        if (backend < 0) {
+            sha256_hash_many(_hash_msgs, sizeof(_hash_msgs[0]), B58_ADDRESS_BYTES - 4, _hash_digests, count);
+        }
+        else {
+            sha256_hash_many_with((unsigned)backend, _hash_msgs, sizeof(_hash_msgs[0]), B58_ADDRESS_BYTES - 4,
+                                  _hash_digests, count);
+        }
+    }
+    _sink = _hash_digests[0][0];
+}
+
+static void run_sha256_many(size_t n)         { run_sha256_many_with(-1, n); }
+static void run_sha256_generic(size_t n)      { run_sha256_with(SHA256_SIMD_GENERIC, n); }
+static void run_sha256_shani(size_t n)        { run_sha256_with(SHA256_SIMD_SHANI, n); }
+static void run_sha256_avx2(size_t n)         { run_sha256_with(SHA256_SIMD_AVX2, n); }
+static void run_sha256_many_generic(size_t n) { run_sha256_many_with(SHA256_SIMD_GENERIC, n); }
+static void run_sha256_many_shani(size_t n)   { run_sha256_many_with(SHA256_SIMD_SHANI, n); }
+static void run_sha256_many_avx2(size_t n)    { run_sha256_many_with(SHA256_SIMD_AVX2, n); }
+
+static void run_base58_encode(size_t n)
+{
+    char b58[B58_ADDRESS_DIGITS + 1];
+    for (size_t i = 0; i < n; i++) {
+        _address_bin[39] = (uint8_t)i;
+        b58enc_address(b58, _address_bin);
+    }
+    _sink = (uint8_t)b58[54];
+}
+
+static void run_base58_decode(size_t n)
+{
+    uint8_t bin[B58_ADDRESS_BYTES];
+    for (size_t i = 0; i < n; i++) {
+        b58tobin_address(bin, _address);
+    }
+    _sink = bin[39];
+}
+
+// libbase58's general codec, for comparison with the fixed-length one
+static void run_b58enc(size_t n)
+{
+    char b58[B58_ADDRESS_DIGITS + 1];
+    for (size_t i = 0; i < n; i++) {
+        size_t len = sizeof(b58);
+        _address_bin[39] = (uint8_t)i;
+        b58enc(b58, &len, _address_bin, B58_ADDRESS_BYTES);
+    }
+    _sink = (uint8_t)b58[54];
+}
+
+static void run_b58tobin(size_t n)
+{
+    uint8_t bin[B58_ADDRESS_BYTES];
+    for (size_t i = 0; i < n; i++) {
+        size_t len = sizeof(bin);
+        b58tobin(bin, &len, _address, B58_ADDRESS_DIGITS);
+    }
+    _sink = bin[39];
+}
+
+static void run_generate_address(size_t n)
+{
+    char address[MINA_ADDRESS_LEN];
+    for (size_t i = 0; i < n; i++) {
+        generate_address(address, sizeof(address), &_keypairs[i % BENCH_BATCH].pub);
+    }
+    _sink = (uint8_t)address[10];
+}
+
+static void run_base10_parse(size_t n)
+{
+    uint64_t x[4] = { _a[0], _a[1], _a[2], _a[3] & 0x3fffffffffffffff };
+    char dec[DIGITS + 1];
+    bigint_to_string(dec, x);
+    for (size_t i = 0; i < n; i++) {
+        dec[70] = '0' + i % 10;
+        bigint_from_string(x, dec);
+    }
+    _sink = x[0];
+}
+
+static void run_signature_to_hex(size_t n)
+{
+    Signature sig = _sig;
+    char hex[2*SIGNATURE_BYTES + 1];
+    for (size_t i = 0; i < n; i++) {
+        sig.s[0] ^= i;
+        signature_to_hex(hex, &sig);
+    }
+    _sink = (uint8_t)hex[0];
+}
+
+static void run_signature_from_hex(size_t n)
+{
+    Signature sig = _sig;
+    char hex[2*SIGNATURE_BYTES + 1];
+    signature_to_hex(hex, &sig);
+    for (size_t i = 0; i < n; i++) {
+        hex[0] = '0' + i % 2;
+        signature_from_hex(&sig, hex);
+    }
+    _sink = sig.s[0];
+}
+
+static void run_signature_to_bytes(size_t n)
+{
+    Signature sig = _sig;
+    uint8_t bytes[SIGNATURE_BYTES];
+    for (size_t i = 0; i < n; i++) {
+        sig.s[0] ^= i;
+        signature_to_bytes(bytes, &sig);
+    }
+    _sink = bytes[0];
+}
+
+static void run_signature_from_bytes(size_t n)
+{
+    Signature sig;
+    uint8_t bytes[SIGNATURE_BYTES];
+    memcpy(bytes, _sig_record, sizeof(bytes));
+    for (size_t i = 0; i < n; i++) {
+        bytes[0] = (uint8_t)i;
+        signature_from_bytes(&sig, bytes);
+    }
+    _sink = sig.s[0];
+}
+
+static void run_base10(size_t n)
+{
+    uint64_t x[4] = { _a[0], _a[1], _a[2], _a[3] & 0x3fffffffffffffff };
+    char dec[DIGITS + 1];
+    for (size_t i = 0; i < n; i++) {
+        x[0] += bigint_to_string(dec, x);
+    }
+    _sink = x[0];
+}
+
+// Signer
+
+static void run_derive_nonce(size_t n)
+{
+    ROInput msg = { _derive_fields, _derive_bits, 3, 3, 599, 8*sizeof(_derive_bits) };
+    Scalar k;
+    for (size_t i = 0; i < n; i++) {
+        _derive_bits[0] = (uint8_t)i;
+        derive_nonce(k, &_derive, &msg);
+    }
+    _sink = k[0];
+}
+
+// With the per-key setup, as without a SignerContext
+static void run_derive_init_nonce(size_t n)
+{
+    ROInput msg = { _derive_fields, _derive_bits, 3, 3, 599, 8*sizeof(_derive_bits) };
+    DeriveCtx ctx;
+    Scalar k;
+    for (size_t i = 0; i < n; i++) {
+        _derive_bits[0] = (uint8_t)i;
+        derive_init(&ctx, &_kp, MAINNET_ID);
+        derive_nonce(k, &ctx, &msg);
+    }
+    derive_clear(&ctx);
+    _sink = k[0];
+}
+
+static void run_sign(size_t n)
+{
+    Signature sig;
+    for (size_t i = 0; i < n; i++) {
+        _txn.nonce = (Nonce)i;
+        sign(&sig, &_kp, &_txn, MAINNET_ID);
+    }
+    _txn.nonce = 200;
+    _sink = sig.s[0];
+}
+
+static void run_verify(size_t n)
+{
+    uint64_t ok = 0;
+    for (size_t i = 0; i < n; i++) {
+        ok += verify(&_sig, &_pub_compressed, &_txn, MAINNET_ID);
+    }
+    _sink = ok;
+}
+
+// The same through one SignerContext, as a signing service would
+static void run_sign_context(size_t n)
+{
+    Signature sig;
+    for (size_t i = 0; i < n; i++) {
+        _txn.nonce = (Nonce)i;
+        sign_with_context(&_ctx, &sig, &_kp, &_txn);
+    }
+    _txn.nonce = 200;
+    _sink = sig.s[0];
+}
+
+static void run_verify_context(size_t n)
+{
+    uint64_t ok = 0;
+    for (size_t i = 0; i < n; i++) {
+        ok += verify_with_context(&_ctx, &_sig, &_pub_compressed, &_txn);
+    }
+    _sink = ok;
+}
+
+// Straight from the binary records
+static void run_sign_record(size_t n)
+{
+    uint8_t sig[SIGNATURE_BYTES];
+    for (size_t i = 0; i < n; i++) {
+        _record[16] = (uint8_t)i; // nonce
+        sign_record(&_ctx, sig, &_kp, _record);
+    }
+    _record[16] = 200;
+    _sink = sig[0];
+}
+
+static void run_verify_record(size_t n)
+{
+    uint64_t ok = 0;
+    for (size_t i = 0; i < n; i++) {
+        ok += verify_record(&_ctx, _sig_record, _pub_record, _record);
+    }
+    _sink = ok;
+}
+
+// Re-signing the same transaction, every call but the first a cache hit
+static void run_sign_cached(size_t n)
+{
+    Signature sig;
+    for (size_t i = 0; i < n; i++) {
+        sign_cached(&_cache, &_ctx, &sig, &_kp, &_txn);
+    }
+    _sink = sig.s[0];
+}
+
+static bool sha256_shani_supported(void)  { return sha256_simd_supported(SHA256_SIMD_SHANI); }
+static bool sha256_avx2_supported(void)   { return sha256_simd_supported(SHA256_SIMD_AVX2); }
+static bool blake2b_avx2_supported(void)  { return blake2b_simd_supported(BLAKE2B_SIMD_AVX2); }
+
+static const Bench _benches[] = {
+    { "field_mul",              run_field_mul },
+    { "field_sq",               run_field_sq },
+    { "field_inv",              run_field_inv },
+    { "field_sqrt",             run_field_sqrt },
+    { "scalar_mul",             run_scalar_mul },
+    { "fp_mul_fiat",            run_fp_mul_fiat },
+    { "fp_sq_fiat",             run_fp_sq_fiat },
+    { "fq_mul_fiat",            run_fq_mul_fiat },
+    { "fq_sq_fiat",             run_fq_sq_fiat },
+    { "fp_mul_sparse",          run_fp_mul_sparse },
+    { "fp_sq_sparse",           run_fp_sq_sparse },
+    { "fq_mul_sparse",          run_fq_mul_sparse },
+    { "fq_sq_sparse",           run_fq_sq_sparse },
+    { "fp_mul_adx",             run_fp_mul_adx,            pasta_adx_supported },
+    { "fp_sq_adx",              run_fp_sq_adx,             pasta_adx_supported },
+    { "fq_mul_adx",             run_fq_mul_adx,            pasta_adx_supported },
+    { "fq_sq_adx",              run_fq_sq_adx,             pasta_adx_supported },
+    { "group_dbl",              run_group_dbl },
+    { "group_add",              run_group_add },
+    { "group_madd",             run_group_madd },
+    { "group_scalar_mul",       run_group_scalar_mul },
+    { "group_scalar_mul_coz",   run_group_scalar_mul_coz },
+    { "generator_mul_public",   run_generator_mul_public },
+    { "generator_mul_secret",   run_generator_mul_secret },
+    { "group_msm_256",          run_msm_256 },
+    { "group_msm_4096",         run_msm_4096 },
+    { "group_msm_65536",        run_msm_65536 },
+    { "poseidon_legacy",        run_poseidon_legacy },
+    { "poseidon_kimchi",        run_poseidon_kimchi },
+    { "blake2b_400",            run_blake2b },
+    { "blake2b_generic",        run_blake2b_generic },
+    { "blake2b_avx2",           run_blake2b_avx2,          blake2b_avx2_supported },
+    { "blake2b_many_generic",   run_blake2b_many_generic },
+    { "blake2b_many_avx2",      run_blake2b_many_avx2,     blake2b_avx2_supported },
+    { "sha256_36",              run_sha256 },
+    { "sha256_many",            run_sha256_many },
+    { "sha256_generic",         run_sha256_generic },
+    { "sha256_shani",           run_sha256_shani,          sha256_shani_supported },
+    { "sha256_avx2",            run_sha256_avx2,           sha256_avx2_supported },
+    { "sha256_many_generic",    run_sha256_many_generic },
+    { "sha256_many_shani",      run_sha256_many_shani,     sha256_shani_supported },
+    { "sha256_many_avx2",       run_sha256_many_avx2,      sha256_avx2_supported },
+    { "base58_encode",          run_base58_encode },
+    { "base58_decode",          run_base58_decode },
+    { "b58enc",                 run_b58enc },
+    { "b58tobin",               run_b58tobin },
+    { "base10",                 run_base10 },
+    { "base10_parse",           run_base10_parse },
+    { "signature_to_hex",       run_signature_to_hex },
+    { "signature_from_hex",     run_signature_from_hex },
+    { "signature_to_bytes",     run_signature_to_bytes },
+    { "signature_from_bytes",   run_signature_from_bytes },
+    { "generate_keypair",       run_generate_keypair },
+    { "keypairs_batch",         run_generate_keypairs_batch },
+    { "generate_address",       run_generate_address },
+    { "addresses_batch_1t",     run_addresses_batch_1t },
+    { "addresses_batch_4t",     run_addresses_batch_4t },
+    { "vanity_1t",              run_vanity_1t },
+    { "vanity_4t",              run_vanity_4t },
+    { "read_public_key",        run_read_public_key },
+    { "parse_addresses_batch",  run_parse_addresses_batch },
+    { "derive_nonce",           run_derive_nonce },
+    { "derive_init_nonce",      run_derive_init_nonce },
+    { "sign",                   run_sign },
+    { "verify",                 run_verify },
+    { "sign_context",           run_sign_context },
+    { "verify_context",         run_verify_context },
+    { "sign_record",            run_sign_record },
+    { "verify_record",          run_verify_record },
+    { "sign_cached",            run_sign_cached },
+};
+
+static int compare_doubles(const void *a, const void *b)
+{
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, const size_t len, const double q)
+{
+    return sorted[(size_t)(q*(len - 1) + 0.5)];
+}
+
+static void bench_run(BenchResult *result, const Bench *bench)
+{
+    // Warm up while doubling n up to one sample's worth of time
+    size_t n = 1;
+    uint64_t elapsed = 0;
+    const uint64_t warmup_end = now_ns() + BENCH_WARMUP_NS;
+    for (;;) {
+        const uint64_t start = now_ns();
+        bench->run(n);
+        elapsed = now_ns() - start;
+        if (elapsed >= BENCH_SAMPLE_NS && start >= warmup_end) {
+            break;
+        }
+        if (elapsed < BENCH_SAMPLE_NS) {
+            n *= 2;
+        }
+    }
+    // Scale to the sample time
+    n = (size_t)((double)n * BENCH_SAMPLE_NS / elapsed);
+    if (n == 0) {
+        n = 1;
+    }
+
+    double ns[BENCH_SAMPLES], cycles[BENCH_SAMPLES], sorted[BENCH_SAMPLES];
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        const uint64_t start_cycles = now_cycles();
+        const uint64_t start = now_ns();
+        bench->run(n);
+        ns[i] = (double)(now_ns() - start)/n;
+        cycles[i] = (double)(now_cycles() - start_cycles)/n;
+    }
+    memcpy(sorted, ns, sizeof(sorted));
+    qsort(sorted, BENCH_SAMPLES, sizeof(sorted[0]), compare_doubles);
+
+    result->ops_per_sample = n;
+    result->ns_median = percentile(sorted, BENCH_SAMPLES, 0.5);
+    result->ns_p10 = percentile(sorted, BENCH_SAMPLES, 0.1);
+    result->ns_p90 = percentile(sorted, BENCH_SAMPLES, 0.9);
+    result->ns_min = sorted[0];
+    result->ops_per_sec = 1e9/result->ns_median;
+
+    // Cycles of the sample the median time came from
+    result->cycles = 0;
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        if (ns[i] == result->ns_median) {
+            result->cycles = cycles[i];
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool json = false;
+    const char *filter = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        }
+        else {
+            filter = argv[i];
+        }
+    }
+
+    bench_setup();
+
+    char backends[128];
+    dispatch_describe(backends, sizeof(backends));
+    if (json) {
+        printf("{\n  \"samples\": %d,\n  \"cpu_features\": %u,\n  \"dispatch\": \"%s\",\n  \"benchmarks\": [",
+               BENCH_SAMPLES, cpu_features(), backends);
+    }
+    else {
+        printf("%s\n\n", backends);
+        printf("%-22s %12s %12s %12s %12s %14s\n", "benchmark", "ns/op", "p10", "p90", "cycles/op", "ops/s");
+    }
+
+    bool first = true;
+    for (size_t i = 0; i < sizeof(_benches)/sizeof(_benches[0]); i++) {
+        if ((filter && !strstr(_benches[i].name, filter))
+            || (_benches[i].supported && !_benches[i].supported())) {
+            continue;
+        }
+        BenchResult r;
+        bench_run(&r, &_benches[i]);
+
+        if (json) {
+            printf("%s\n    { \"name\": \"%s\", \"ops_per_sample\": %zu, \"ns_per_op\": %.3f, "
+                   "\"ns_p10\": %.3f, \"ns_p90\": %.3f, \"ns_min\": %.3f, \"cycles_per_op\": %.1f, "
+                   "\"ops_per_sec\": %.1f }",
+                   first ? "" : ",", _benches[i].name, r.ops_per_sample, r.ns_median,
+                   r.ns_p10, r.ns_p90, r.ns_min, r.cycles, r.ops_per_sec);
+        }
+        else {
+            printf("%-22s %12.1f %12.1f %12.1f %12.1f %14.0f\n", _benches[i].name,
+                   r.ns_median, r.ns_p10, r.ns_p90, r.cycles, r.ops_per_sec);
+        }
+        fflush(stdout);
+        first = false;
+    }
+
+    if (json) {
+        printf("\n  ]\n}\n");
+    }
+
+    return 0;
+}
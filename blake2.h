@@ -186,6 +186,15 @@ extern "C" {
   int blake2xs( void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen );
   int blake2xb( void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen );
 
+  /* blake2b with an explicit BLAKE2B_SIMD_* backend from blake2b_simd.h,
+     which must be supported, for differential testing */
+  int blake2b_with( unsigned backend, void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen );
+
+  /* Unkeyed hashes of n independent messages, in[i] of inlen[i] bytes, to
+     out + i * outlen.  With AVX2 four messages are hashed at a time. */
+  int blake2b_many( void *out, size_t outlen, const void *const *in, const size_t *inlen, size_t n );
+  int blake2b_many_with( unsigned backend, void *out, size_t outlen, const void *const *in, const size_t *inlen, size_t n );
+
   /* This is simply an alias for blake2b */
   int blake2( void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen );
 
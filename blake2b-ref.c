@@ -20,6 +20,8 @@
 
 #include "blake2.h"
 #include "blake2-impl.h"
+#include "blake2b_simd.h"
+#include "dispatch.h"
 
 static const uint64_t blake2b_IV[8] =
 {
@@ -118,7 +120,9 @@ int blake2b_init( blake2b_state *S, size_t outlen )
 }
 
 
-int blake2b_init_key( blake2b_state *S, size_t outlen, const void *key, size_t keylen )
+static int blake2b_update_with( unsigned backend, blake2b_state *S, const void *pin, size_t inlen );
+
+static int blake2b_init_key_with( unsigned backend, blake2b_state *S, size_t outlen, const void *key, size_t keylen )
 {
   blake2b_param P[1];
 
@@ -145,12 +149,17 @@ int blake2b_init_key( blake2b_state *S, size_t outlen, const void *key, size_t k
     uint8_t block[BLAKE2B_BLOCKBYTES];
     memset( block, 0, BLAKE2B_BLOCKBYTES );
     memcpy( block, key, keylen );
-    blake2b_update( S, block, BLAKE2B_BLOCKBYTES );
+    blake2b_update_with( backend, S, block, BLAKE2B_BLOCKBYTES );
     secure_zero_memory( block, BLAKE2B_BLOCKBYTES ); /* Burn the key from stack */
   }
   return 0;
 }
 
+int blake2b_init_key( blake2b_state *S, size_t outlen, const void *key, size_t keylen )
+{
+  return blake2b_init_key_with( dispatch.blake2b, S, outlen, key, keylen );
+}
+
 #define G(r,i,a,b,c,d)                      \
   do {                                      \
     a = a + b + m[blake2b_sigma[r][2*i+0]]; \
@@ -175,7 +184,7 @@ int blake2b_init_key( blake2b_state *S, size_t outlen, const void *key, size_t k
     G(r,7,v[ 3],v[ 4],v[ 9],v[14]); \
   } while(0)
 
-static void blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+static void blake2b_compress_ref( blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
 {
   uint64_t m[16];
   uint64_t v[16];
@@ -219,7 +228,15 @@ static void blake2b_compress( blake2b_state *S, const uint8_t block[BLAKE2B_BLOC
 #undef G
 #undef ROUND
 
-int blake2b_update( blake2b_state *S, const void *pin, size_t inlen )
+static void blake2b_compress( unsigned backend, blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES] )
+{
+  if( backend == BLAKE2B_SIMD_AVX2 )
+    blake2b_compress_avx2( S->h, block, S->t, S->f );
+  else
+    blake2b_compress_ref( S, block );
+}
+
+static int blake2b_update_with( unsigned backend, blake2b_state *S, const void *pin, size_t inlen )
 {
   const unsigned char * in = (const unsigned char *)pin;
   if( inlen > 0 )
@@ -231,11 +248,11 @@ int blake2b_update( blake2b_state *S, const void *pin, size_t inlen )
       S->buflen = 0;
       memcpy( S->buf + left, in, fill ); /* Fill buffer */
       blake2b_increment_counter( S, BLAKE2B_BLOCKBYTES );
-      blake2b_compress( S, S->buf ); /* Compress */
+      blake2b_compress( backend, S, S->buf ); /* Compress */
       in += fill; inlen -= fill;
       while(inlen > BLAKE2B_BLOCKBYTES) {
         blake2b_increment_counter(S, BLAKE2B_BLOCKBYTES);
-        blake2b_compress( S, in );
+        blake2b_compress( backend, S, in );
         in += BLAKE2B_BLOCKBYTES;
         inlen -= BLAKE2B_BLOCKBYTES;
       }
@@ -246,7 +263,12 @@ int blake2b_update( blake2b_state *S, const void *pin, size_t inlen )
   return 0;
 }
 
-int blake2b_final( blake2b_state *S, void *out, size_t outlen )
+int blake2b_update( blake2b_state *S, const void *pin, size_t inlen )
+{
+  return blake2b_update_with( dispatch.blake2b, S, pin, inlen );
+}
+
+static int blake2b_final_with( unsigned backend, blake2b_state *S, void *out, size_t outlen )
 {
   uint8_t buffer[BLAKE2B_OUTBYTES] = {0};
   size_t i;
@@ -260,7 +282,7 @@ int blake2b_final( blake2b_state *S, void *out, size_t outlen )
   blake2b_increment_counter( S, S->buflen );
   blake2b_set_lastblock( S );
   memset( S->buf + S->buflen, 0, BLAKE2B_BLOCKBYTES - S->buflen ); /* Padding */
-  blake2b_compress( S, S->buf );
+  blake2b_compress( backend, S, S->buf );
 
   for( i = 0; i < 8; ++i ) /* Output full hash to temp buffer */
     store64( buffer + sizeof( S->h[i] ) * i, S->h[i] );
@@ -270,8 +292,13 @@ int blake2b_final( blake2b_state *S, void *out, size_t outlen )
   return 0;
 }
 
+int blake2b_final( blake2b_state *S, void *out, size_t outlen )
+{
+  return blake2b_final_with( dispatch.blake2b, S, out, outlen );
+}
+
 /* inlen, at least, should be uint64_t. Others can be size_t. */
-int blake2b( void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen )
+int blake2b_with( unsigned backend, void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen )
 {
   blake2b_state S[1];
 
@@ -288,18 +315,131 @@ int blake2b( void *out, size_t outlen, const void *in, size_t inlen, const void
 
   if( keylen > 0 )
   {
-    if( blake2b_init_key( S, outlen, key, keylen ) < 0 ) return -1;
+    if( blake2b_init_key_with( backend, S, outlen, key, keylen ) < 0 ) return -1;
   }
   else
   {
     if( blake2b_init( S, outlen ) < 0 ) return -1;
   }
 
-  blake2b_update( S, ( const uint8_t * )in, inlen );
-  blake2b_final( S, out, outlen );
+  blake2b_update_with( backend, S, ( const uint8_t * )in, inlen );
+  blake2b_final_with( backend, S, out, outlen );
+  return 0;
+}
+
+int blake2b( void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen )
+{
+  return blake2b_with( dispatch.blake2b, out, outlen, in, inlen, key, keylen );
+}
+
+/* Unkeyed hashes of independent messages.  With AVX2 every lane of the
+   multi-message kernel works through its own message, one block per
+   compression, and takes the next message as soon as it has finished. */
+static void blake2b_many_lanes( uint8_t *out, size_t outlen, const void *const *in, const size_t *inlen, size_t n )
+{
+  uint64_t h[8][BLAKE2B_LANES], m[16][BLAKE2B_LANES];
+  uint64_t t[BLAKE2B_LANES], f[BLAKE2B_LANES];
+  size_t msg[BLAKE2B_LANES], pos[BLAKE2B_LANES];
+  uint8_t block[BLAKE2B_BLOCKBYTES], buffer[BLAKE2B_OUTBYTES];
+  size_t next = 0, active = 0, i, l;
+
+  for( l = 0; l < BLAKE2B_LANES; ++l )
+  {
+    msg[l] = n;
+    t[l] = f[l] = 0;
+  }
+
+  for( ;; )
+  {
+    /* Idle lanes start the next message */
+    for( l = 0; l < BLAKE2B_LANES; ++l )
+    {
+      if( msg[l] < n || next == n ) continue;
+      msg[l] = next++;
+      pos[l] = 0;
+      for( i = 0; i < 8; ++i ) h[i][l] = blake2b_IV[i];
+      h[0][l] ^= 0x01010000 ^ outlen;
+      active++;
+    }
+    if( active == 0 ) break;
+
+    for( l = 0; l < BLAKE2B_LANES; ++l )
+    {
+      const uint8_t *p;
+      size_t left;
+
+      if( msg[l] == n )
+      {
+        for( i = 0; i < 16; ++i ) m[i][l] = 0;
+        continue;
+      }
+
+      /* The last block, possibly empty, is padded with zeros and flagged */
+      p = ( const uint8_t * )in[msg[l]] + pos[l];
+      left = inlen[msg[l]] - pos[l];
+      if( left > BLAKE2B_BLOCKBYTES )
+      {
+        pos[l] += BLAKE2B_BLOCKBYTES;
+        f[l] = 0;
+      }
+      else
+      {
+        memset( block, 0, sizeof( block ) );
+        if( left > 0 ) memcpy( block, p, left );
+        p = block;
+        pos[l] += left;
+        f[l] = (uint64_t)-1;
+      }
+      t[l] = pos[l];
+      for( i = 0; i < 16; ++i ) m[i][l] = load64( p + sizeof( m[i][l] ) * i );
+    }
+
+    blake2b_compress_lanes_avx2( h, ( const uint64_t (*)[BLAKE2B_LANES] )m, t, f );
+
+    for( l = 0; l < BLAKE2B_LANES; ++l )
+    {
+      if( msg[l] == n || f[l] == 0 ) continue;
+      for( i = 0; i < 8; ++i ) store64( buffer + sizeof( h[i][l] ) * i, h[i][l] );
+      memcpy( out + msg[l] * outlen, buffer, outlen );
+      msg[l] = n;
+      active--;
+    }
+  }
+
+  /* Inputs such as message_derive's hold secrets */
+  secure_zero_memory( m, sizeof( m ) );
+  secure_zero_memory( h, sizeof( h ) );
+  secure_zero_memory( block, sizeof( block ) );
+  secure_zero_memory( buffer, sizeof( buffer ) );
+}
+
+int blake2b_many_with( unsigned backend, void *out, size_t outlen, const void *const *in, const size_t *inlen, size_t n )
+{
+  size_t i;
+
+  if ( NULL == out ) return -1;
+
+  if( !outlen || outlen > BLAKE2B_OUTBYTES ) return -1;
+
+  for( i = 0; i < n; ++i )
+    if ( NULL == in[i] && inlen[i] > 0 ) return -1;
+
+  if( backend == BLAKE2B_SIMD_AVX2 )
+  {
+    blake2b_many_lanes( ( uint8_t * )out, outlen, in, inlen, n );
+    return 0;
+  }
+
+  for( i = 0; i < n; ++i )
+    if( blake2b_with( backend, ( uint8_t * )out + i * outlen, outlen, in[i], inlen[i], NULL, 0 ) < 0 ) return -1;
   return 0;
 }
 
+int blake2b_many( void *out, size_t outlen, const void *const *in, const size_t *inlen, size_t n )
+{
+  return blake2b_many_with( dispatch.blake2b, out, outlen, in, inlen, n );
+}
+
 int blake2( void *out, size_t outlen, const void *in, size_t inlen, const void *key, size_t keylen ) {
   return blake2b(out, outlen, in, inlen, key, keylen);
 }
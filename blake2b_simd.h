@@ -0,0 +1,32 @@
+// Accelerated BLAKE2b compression
+//
+//     BLAKE2B_SIMD_AVX2 compresses one message with the four rows of the
+//     working state in 256-bit registers, and BLAKE2B_LANES messages at once
+//     with lane l of every register belonging to message l.  Callers must
+//     check blake2b_simd_supported() first; blake2b-ref.c does the dispatch.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "blake2.h"
+
+#define BLAKE2B_SIMD_GENERIC 0 // reference C
+#define BLAKE2B_SIMD_AVX2    1 // one row per register, or 4 messages at a time
+
+#define BLAKE2B_LANES 4
+
+bool blake2b_simd_supported(const unsigned backend);
+unsigned blake2b_simd_backend(void);
+
+// h is the chaining value, t the byte counter and f the finalization flags
+void blake2b_compress_avx2(uint64_t h[8], const uint8_t block[BLAKE2B_BLOCKBYTES],
+                           const uint64_t t[2], const uint64_t f[2]);
+
+// h[i][l] is word i of the chaining value of lane l and m[i][l] word i of
+// its block.  t and f are the low counter word and the last block flag of
+// each lane, the high counter word and the last node flag are zero.
+void blake2b_compress_lanes_avx2(uint64_t h[8][BLAKE2B_LANES], const uint64_t m[16][BLAKE2B_LANES],
+                                 const uint64_t t[BLAKE2B_LANES], const uint64_t f[BLAKE2B_LANES]);
@@ -0,0 +1,320 @@
+// Bulk verification of archived transactions
+//
+//     ./bulk_verify [-n mainnet|testnet] [-t threads] FILE
+//     ./bulk_verify [-n mainnet|testnet] -w COUNT FILE
+//
+//     FILE holds BULK_RECORD_BYTES records back to back, each a transaction
+//     record, the signer's compressed public key and the signature, in the
+//     layouts of minasigner.h.  The file is memory mapped with a sequential
+//     access hint and cut into page aligned chunks of records, which
+//     the threads (one per online CPU by default) take in order and check
+//     with verify_record.  A finished chunk is dropped from the mapping, so
+//     memory use does not grow with the file.
+//
+//     Only failures are printed, one line per record with its index and the
+//     reason, in the order the threads find them.  A summary with the
+//     records per second goes to stderr.  The exit status is 0 if every
+//     record verified, 1 if some did not and 2 on an error.
+//
+//     -w writes COUNT freshly signed records to FILE instead, for testing.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "crypto.h"
+#include "keygen.h"
+#include "signer_context.h"
+#include "utils.h"
+
+#define BULK_RECORD_BYTES  (TRANSACTION_BYTES + COMPRESSED_BYTES + SIGNATURE_BYTES)
+#define BULK_PUBKEY        TRANSACTION_BYTES
+#define BULK_SIGNATURE     (TRANSACTION_BYTES + COMPRESSED_BYTES)
+
+#define BULK_MAX_THREADS   256
+#define BULK_WRITE_KEYS    64
+
+typedef struct bulk_job_t {
+    const uint8_t *data;
+    size_t records;
+    size_t page;
+    size_t chunk_records;
+    size_t chunks;
+    uint8_t network_id;
+    atomic_size_t next_chunk;
+    atomic_size_t failures;
+    pthread_mutex_t out_lock;
+} BulkJob;
+
+// Why a record failed, only worked out for failures
+static const char *failure_reason(const uint8_t *record)
+{
+    Transaction txn;
+    Compressed pub;
+    Signature sig;
+    Affine pt;
+    if (!transaction_from_bytes(&txn, record)) {
+        return "bad_transaction";
+    }
+    if (!compressed_from_bytes(&pub, &record[BULK_PUBKEY])) {
+        return "bad_pubkey";
+    }
+    if (!decompress(&pt, &pub)) {
+        return "pubkey_not_on_curve";
+    }
+    if (!signature_from_bytes(&sig, &record[BULK_SIGNATURE])) {
+        return "bad_signature_encoding";
+    }
+    return "bad_signature";
+}
+
+static void *verify_chunks(void *arg)
+{
+    BulkJob *job = arg;
+    SignerContext ctx;
+    signer_context_init(&ctx, job->network_id);
+
+    for (;;) {
+        const size_t chunk = atomic_fetch_add(&job->next_chunk, 1);
+        if (chunk >= job->chunks) {
+            break;
+        }
+        const size_t start = chunk*job->chunk_records;
+        const size_t end = start + job->chunk_records < job->records ? start + job->chunk_records : job->records;
+
+        for (size_t i = start; i < end; i++) {
+            const uint8_t *record = &job->data[i*BULK_RECORD_BYTES];
+            if (!verify_record(&ctx, &record[BULK_SIGNATURE], &record[BULK_PUBKEY], record)) {
+                atomic_fetch_add(&job->failures, 1);
+                pthread_mutex_lock(&job->out_lock);
+                printf("%zu\t%s\n", i, failure_reason(record));
+                pthread_mutex_unlock(&job->out_lock);
+            }
+        }
+
+        // Done with these pages, all but a partial one at the end of the file
+        const size_t from = start*BULK_RECORD_BYTES;
+        const size_t to = end*BULK_RECORD_BYTES/job->page*job->page;
+        if (to > from) {
+            madvise((void *)&job->data[from], to - from, MADV_DONTNEED);
+        }
+    }
+    return NULL;
+}
+
+// Records per chunk: the fewest that fill whole pages (page records of 273
+// bytes for a power of two page size, 1.1MB with 4KB pages), so every
+// chunk starts on a page boundary and can be released with madvise
+static size_t chunk_records(const size_t page)
+{
+    size_t a = page, b = BULK_RECORD_BYTES;
+    while (b != 0) {
+        const size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return page / a;
+}
+
+static double seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec)/1e9;
+}
+
+static int write_records(const char *path, const size_t count, const uint8_t network_id)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "bulk_verify: %s: %s\n", path, strerror(errno));
+        return 2;
+    }
+
+    static Keypair keys[BULK_WRITE_KEYS];
+    if (!generate_keypairs_batch(keys, BULK_WRITE_KEYS)) {
+        fprintf(stderr, "bulk_verify: no entropy\n");
+        fclose(f);
+        return 2;
+    }
+
+    SignerContext ctx;
+    signer_context_init(&ctx, network_id);
+    Transaction txn;
+    memset(&txn, 0, sizeof(txn));
+    txn.fee_token = 1;
+    txn.token_id = 1;
+    prepare_memo(txn.memo, "bulk_verify");
+    for (size_t i = 0; i < count; i++) {
+        const Keypair *kp = &keys[i % BULK_WRITE_KEYS];
+        uint8_t record[BULK_RECORD_BYTES];
+        Compressed pub;
+        compress(&pub, &kp->pub);
+        txn.fee_payer_pk = pub;
+        txn.source_pk = pub;
+        txn.receiver_pk = pub;
+        txn.fee = 1000000 + i;
+        txn.nonce = (Nonce)(i / BULK_WRITE_KEYS);
+        txn.amount = i;
+
+        transaction_to_bytes(record, &txn);
+        compressed_to_bytes(&record[BULK_PUBKEY], &pub);
+        sign_record(&ctx, &record[BULK_SIGNATURE], kp, record);
+        if (fwrite(record, sizeof(record), 1, f) != 1) {
+            fprintf(stderr, "bulk_verify: %s: %s\n", path, strerror(errno));
+            fclose(f);
+            return 2;
+        }
+    }
+    signer_context_clear(&ctx);
+    secure_bzero(keys, sizeof(keys));
+
+    if (fclose(f) != 0) {
+        fprintf(stderr, "bulk_verify: %s: %s\n", path, strerror(errno));
+        return 2;
+    }
+    return 0;
+}
+
+static int usage(void)
+{
+    fprintf(stderr, "usage: bulk_verify [-n mainnet|testnet] [-t threads] FILE\n"
+                    "       bulk_verify [-n mainnet|testnet] -w COUNT FILE\n");
+    return 2;
+}
+
+// Parses a decimal count of at most max: digits only, so signs, spaces,
+// trailing junk and out of range values are rejected
+static bool parse_count(unsigned long long *out, const char *str, const unsigned long long max)
+{
+    if (*str < '0' || *str > '9') {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    const unsigned long long value = strtoull(str, &end, 10);
+    if (errno != 0 || *end != '\0' || value > max) {
+        return false;
+    }
+    *out = value;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    uint8_t network_id = MAINNET_ID;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = threads < 1 ? 1 : (threads > BULK_MAX_THREADS ? BULK_MAX_THREADS : threads);
+    bool write = false;
+    unsigned long long value, write_count = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:w:")) != -1) {
+        switch (opt) {
+            case 'n':
+                if (strcmp(optarg, "mainnet") == 0) {
+                    network_id = MAINNET_ID;
+                }
+                else if (strcmp(optarg, "testnet") == 0) {
+                    network_id = TESTNET_ID;
+                }
+                else {
+                    return usage();
+                }
+                break;
+            case 't':
+                if (!parse_count(&value, optarg, BULK_MAX_THREADS) || value < 1) {
+                    return usage();
+                }
+                threads = (long)value;
+                break;
+            case 'w':
+                if (!parse_count(&write_count, optarg, SIZE_MAX)) {
+                    return usage();
+                }
+                write = true;
+                break;
+            default:
+                return usage();
+        }
+    }
+    if (optind != argc - 1) {
+        return usage();
+    }
+    const char *path = argv[optind];
+
+    if (write) {
+        return write_records(path, (size_t)write_count, network_id);
+    }
+
+    const int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "bulk_verify: %s: %s\n", path, strerror(errno));
+        return 2;
+    }
+    if (st.st_size % BULK_RECORD_BYTES != 0) {
+        fprintf(stderr, "bulk_verify: %s: size is not a multiple of %d byte records\n", path, BULK_RECORD_BYTES);
+        close(fd);
+        return 2;
+    }
+
+    static BulkJob job;
+    const long page = sysconf(_SC_PAGESIZE);
+    job.records = (size_t)st.st_size / BULK_RECORD_BYTES;
+    job.page = page > 0 ? (size_t)page : 4096;
+    job.chunk_records = chunk_records(job.page);
+    job.chunks = (job.records + job.chunk_records - 1) / job.chunk_records;
+    job.network_id = network_id;
+    atomic_init(&job.next_chunk, 0);
+    atomic_init(&job.failures, 0);
+    pthread_mutex_init(&job.out_lock, NULL);
+
+    void *map = NULL;
+    if (job.records > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "bulk_verify: %s: %s\n", path, strerror(errno));
+            close(fd);
+            return 2;
+        }
+        madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+        job.data = map;
+    }
+    close(fd);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Worker 0 is this thread, as are any that could not be spawned
+    pthread_t tids[BULK_MAX_THREADS];
+    bool spawned[BULK_MAX_THREADS] = { false };
+    for (long t = 1; t < threads; t++) {
+        spawned[t] = pthread_create(&tids[t], NULL, verify_chunks, &job) == 0;
+    }
+    verify_chunks(&job);
+    for (long t = 1; t < threads; t++) {
+        if (spawned[t]) {
+            pthread_join(tids[t], NULL);
+        }
+    }
+
+    const double elapsed = seconds_since(&start);
+    fflush(stdout);
+    if (map) {
+        munmap(map, (size_t)st.st_size);
+    }
+
+    const size_t failures = atomic_load(&job.failures);
+    fprintf(stderr, "bulk_verify: %zu records, %zu failed, %.2f s, %.0f records/s, %ld threads\n",
+            job.records, failures, elapsed, elapsed > 0 ? job.records / elapsed : 0.0, threads);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+// Runtime CPU feature detection
+//
+//     Features are probed once with cpuid and cached.  AVX and AVX-512 are
+//     only reported when the OS also saves the corresponding register state
+//     (checked with xgetbv), otherwise using them would fault.
+
+#include "cpu.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+
+#define XCR0_AVX_STATE    0x06 // XMM | YMM
+#define XCR0_AVX512_STATE 0xe0 // opmask | ZMM_Hi256 | Hi16_ZMM
+
+static uint64_t xgetbv0(void)
+{
+    uint32_t eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+}
+
+static uint32_t cpu_probe(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t features = 0;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    const bool osxsave = ecx & bit_OSXSAVE;
+    const bool ssse3   = ecx & bit_SSSE3;
+    const bool sse41   = ecx & bit_SSE4_1;
+
+    uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+    const bool avx_state    = (xcr0 & XCR0_AVX_STATE) == XCR0_AVX_STATE;
+    const bool avx512_state = avx_state && (xcr0 & XCR0_AVX512_STATE) == XCR0_AVX512_STATE;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+
+    if ((ebx & bit_AVX2) && avx_state) {
+        features |= CPU_FEATURE_AVX2;
+    }
+    if (ebx & bit_BMI2) {
+        features |= CPU_FEATURE_BMI2;
+    }
+    if (ebx & bit_ADX) {
+        features |= CPU_FEATURE_ADX;
+    }
+    if ((ebx & bit_AVX512F) && avx512_state) {
+        features |= CPU_FEATURE_AVX512F;
+        if (ebx & bit_AVX512IFMA) {
+            features |= CPU_FEATURE_AVX512IFMA;
+        }
+    }
+    if ((ebx & bit_SHA) && ssse3 && sse41) {
+        features |= CPU_FEATURE_SHA;
+    }
+
+    return features;
+}
+#else
+static uint32_t cpu_probe(void)
+{
+    return 0;
+}
+#endif
+
+static uint32_t _cpu_features;
+static bool _cpu_probed;
+
+uint32_t cpu_features(void)
+{
+    if (!_cpu_probed) {
+        _cpu_features = cpu_probe();
+        _cpu_probed = true;
+    }
+
+    return _cpu_features;
+}
+
+bool cpu_has(const uint32_t features)
+{
+    return (cpu_features() & features) == features;
+}
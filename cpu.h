@@ -0,0 +1,20 @@
+// Runtime CPU feature detection
+//
+//     The build stays generic (no -march), so accelerated kernels are
+//     compiled with per-function target attributes and only called after
+//     checking the features of the machine we are actually running on.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CPU_FEATURE_AVX2       (1u << 0)
+#define CPU_FEATURE_BMI2       (1u << 1)
+#define CPU_FEATURE_ADX        (1u << 2)
+#define CPU_FEATURE_AVX512F    (1u << 3)
+#define CPU_FEATURE_AVX512IFMA (1u << 4)
+#define CPU_FEATURE_SHA        (1u << 5)
+
+uint32_t cpu_features(void);
+bool cpu_has(const uint32_t features);
@@ -8,7 +8,8 @@
 //     * Curve arithmatic
 //         - field_add, field_sub, field_mul, field_sq, field_inv, field_negate, field_pow, field_eq
 //         - scalar_add, scalar_sub, scalar_mul, scalar_sq, scalar_pow, scalar_eq
-//         - group_add, group_dbl, group_scalar_mul (group elements use projective coordinates)
+//         - group_add, group_madd, group_dbl, group_scalar_mul, group_scalar_mul_coz
+//           (group elements use jacobian coordinates)
 //         - affine_scalar_mul
 //         - affine_from_group
 //         - generate_pubkey, generate_keypair
@@ -26,7 +27,6 @@
 
 #include <assert.h>
 #include <inttypes.h>
-#include <math.h>
 
 #include "crypto.h"
 #include "utils.h"
@@ -35,7 +35,13 @@
 #include "pasta_fq.h"
 #include "blake2.h"
 #include "libbase58.h"
+#include "base58_address.h"
 #include "sha256.h"
+#include "op_counters.h"
+#include "pasta_simd.h"
+#include "pasta_sparse.h"
+#include "dispatch.h"
+#include "signer_context.h"
 
 // a = 0, b = 5
 static const Field GROUP_COEFF_B = {
@@ -45,15 +51,6 @@ static const Field GROUP_COEFF_B = {
 static const Field FIELD_ONE = {
   0x34786d38fffffffd, 0x992c350be41914ad, 0xffffffffffffffff, 0x3fffffffffffffff
 };
-static const Field FIELD_THREE = {
-  0x6b0ee5d0fffffff5, 0x86f76d2b99b14bd0, 0xfffffffffffffffe, 0x3fffffffffffffff
-};
-static const Field FIELD_FOUR = {
-  0x65a221cfffffff1, 0xfddd093b747d6762, 0xfffffffffffffffd, 0x3fffffffffffffff
-};
-static const Field FIELD_EIGHT = {
-  0x7387134cffffffe1, 0xd973797adfadd5a8, 0xfffffffffffffffb, 0x3fffffffffffffff
-};
 static const Field FIELD_ZERO = { 0, 0, 0, 0 };
 static const Scalar SCALAR_ZERO = { 0, 0, 0, 0 };
 
@@ -74,20 +71,281 @@ static const Affine AFFINE_ONE = {
     }
 };
 
+// Fp and Fq moduli, little endian words
+static const uint64_t FIELD_MODULUS_WORDS[4] = {
+    0x992d30ed00000001, 0x224698fc094cf91b, 0x0000000000000000, 0x4000000000000000
+};
+static const uint64_t SCALAR_MODULUS_WORDS[4] = {
+    0x8c46eb2100000001, 0x224698fc0994a8dd, 0x0000000000000000, 0x4000000000000000
+};
+
+// a < b, comparing from the most significant word
+static bool words_less(const uint64_t a[4], const uint64_t b[4])
+{
+    for (size_t w = 4; w-- > 0; ) {
+        if (a[w] != b[w]) {
+            return a[w] < b[w];
+        }
+    }
+    return false;
+}
+
+static void words_from_bytes(uint64_t words[4], const uint8_t bytes[32])
+{
+    for (size_t i = 0; i < 4; i++) {
+        words[i] = 0;
+        for (size_t j = 0; j < 8; j++) {
+            words[i] |= (uint64_t)bytes[8*i + j] << 8*j;
+        }
+    }
+}
+
+static void words_to_bytes(uint8_t bytes[32], const uint64_t words[4])
+{
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 8; j++) {
+            bytes[8*i + j] = (uint8_t)(words[i] >> 8*j);
+        }
+    }
+}
+
+// Canonical little endian encodings
+
+void field_to_bytes(uint8_t out[FIELD_BYTES], const Field a)
+{
+    uint64_t words[4];
+    pasta_fp_from_montgomery_sparse(words, a);
+    words_to_bytes(out, words);
+}
+
+bool field_from_bytes(Field a, const uint8_t in[FIELD_BYTES])
+{
+    uint64_t words[4];
+    words_from_bytes(words, in);
+    if (!words_less(words, FIELD_MODULUS_WORDS)) {
+        return false;
+    }
+    pasta_fp_to_montgomery_sparse(a, words);
+    return true;
+}
+
+void scalar_to_bytes(uint8_t out[SCALAR_BYTES], const Scalar a)
+{
+    uint64_t words[4];
+    pasta_fq_from_montgomery_sparse(words, a);
+    words_to_bytes(out, words);
+}
+
+bool scalar_from_bytes(Scalar a, const uint8_t in[SCALAR_BYTES])
+{
+    uint64_t words[4];
+    words_from_bytes(words, in);
+    if (!words_less(words, SCALAR_MODULUS_WORDS)) {
+        return false;
+    }
+    pasta_fq_to_montgomery_sparse(a, words);
+    return true;
+}
+
+void signature_to_bytes(uint8_t out[SIGNATURE_BYTES], const Signature *sig)
+{
+    field_to_bytes(out, sig->rx);
+    scalar_to_bytes(&out[FIELD_BYTES], sig->s);
+}
+
+bool signature_from_bytes(Signature *sig, const uint8_t in[SIGNATURE_BYTES])
+{
+    return field_from_bytes(sig->rx, in) && scalar_from_bytes(sig->s, &in[FIELD_BYTES]);
+}
+
+void compressed_to_bytes(uint8_t out[COMPRESSED_BYTES], const Compressed *pk)
+{
+    field_to_bytes(out, pk->x);
+    out[FIELD_BYTES] = pk->is_odd;
+}
+
+bool compressed_from_bytes(Compressed *pk, const uint8_t in[COMPRESSED_BYTES])
+{
+    pk->is_odd = in[FIELD_BYTES] & 1;
+    return in[FIELD_BYTES] <= 1 && field_from_bytes(pk->x, in);
+}
+
+static void put_le(uint8_t *out, const uint64_t x, const size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        out[i] = (uint8_t)(x >> 8*i);
+    }
+}
+
+static uint64_t get_le(const uint8_t *in, const size_t len)
+{
+    uint64_t x = 0;
+    for (size_t i = 0; i < len; i++) {
+        x |= (uint64_t)in[i] << 8*i;
+    }
+    return x;
+}
+
+// Offsets in the transaction record
+#define TXN_FEE          0
+#define TXN_FEE_TOKEN    8
+#define TXN_NONCE        16
+#define TXN_VALID_UNTIL  20
+#define TXN_TOKEN_ID     24
+#define TXN_AMOUNT       32
+#define TXN_FEE_PAYER    40
+#define TXN_SOURCE       73
+#define TXN_RECEIVER     106
+#define TXN_TAG          139
+#define TXN_TOKEN_LOCKED 140
+#define TXN_MEMO         141
+#define TXN_PADDING      175
+
+_Static_assert(TXN_PADDING + 1 == TRANSACTION_BYTES, "transaction record layout");
+
+void transaction_to_bytes(uint8_t out[TRANSACTION_BYTES], const Transaction *t)
+{
+    put_le(&out[TXN_FEE], t->fee, 8);
+    put_le(&out[TXN_FEE_TOKEN], t->fee_token, 8);
+    put_le(&out[TXN_NONCE], t->nonce, 4);
+    put_le(&out[TXN_VALID_UNTIL], t->valid_until, 4);
+    put_le(&out[TXN_TOKEN_ID], t->token_id, 8);
+    put_le(&out[TXN_AMOUNT], t->amount, 8);
+    compressed_to_bytes(&out[TXN_FEE_PAYER], &t->fee_payer_pk);
+    compressed_to_bytes(&out[TXN_SOURCE], &t->source_pk);
+    compressed_to_bytes(&out[TXN_RECEIVER], &t->receiver_pk);
+    out[TXN_TAG] = t->tag[0] | t->tag[1] << 1 | t->tag[2] << 2;
+    out[TXN_TOKEN_LOCKED] = t->token_locked;
+    memcpy(&out[TXN_MEMO], t->memo, MEMO_BYTES);
+    out[TXN_PADDING] = 0;
+}
+
+// The bytes besides the keys' x coordinates that transaction_from_bytes
+// and roinput_add_transaction_record check
+static bool record_flags_valid(const uint8_t in[TRANSACTION_BYTES])
+{
+    return in[TXN_FEE_PAYER + FIELD_BYTES] <= 1 && in[TXN_SOURCE + FIELD_BYTES] <= 1
+        && in[TXN_RECEIVER + FIELD_BYTES] <= 1
+        && in[TXN_TAG] < 8 && in[TXN_TOKEN_LOCKED] <= 1 && in[TXN_PADDING] == 0;
+}
+
+bool transaction_from_bytes(Transaction *t, const uint8_t in[TRANSACTION_BYTES])
+{
+    t->fee = get_le(&in[TXN_FEE], 8);
+    t->fee_token = get_le(&in[TXN_FEE_TOKEN], 8);
+    t->nonce = (Nonce)get_le(&in[TXN_NONCE], 4);
+    t->valid_until = (GlobalSlot)get_le(&in[TXN_VALID_UNTIL], 4);
+    t->token_id = get_le(&in[TXN_TOKEN_ID], 8);
+    t->amount = get_le(&in[TXN_AMOUNT], 8);
+    for (size_t i = 0; i < 3; i++) {
+        t->tag[i] = (in[TXN_TAG] >> i) & 1;
+    }
+    t->token_locked = in[TXN_TOKEN_LOCKED] & 1;
+    memcpy(t->memo, &in[TXN_MEMO], MEMO_BYTES);
+
+    return compressed_from_bytes(&t->fee_payer_pk, &in[TXN_FEE_PAYER])
+        && compressed_from_bytes(&t->source_pk, &in[TXN_SOURCE])
+        && compressed_from_bytes(&t->receiver_pk, &in[TXN_RECEIVER])
+        && record_flags_valid(in);
+}
+
+bool roinput_add_transaction_record(ROInput *input, const uint8_t in[TRANSACTION_BYTES])
+{
+    if (!record_flags_valid(in)) {
+        return false;
+    }
+
+    const size_t keys[3] = { TXN_FEE_PAYER, TXN_SOURCE, TXN_RECEIVER };
+    for (size_t i = 0; i < 3; i++) {
+        Field x;
+        if (!field_from_bytes(x, &in[keys[i]])) {
+            return false;
+        }
+        roinput_add_field(input, x);
+    }
+
+    // The integers are little endian in the record as in the input
+    roinput_add_bytes(input, &in[TXN_FEE], 8);
+    roinput_add_bytes(input, &in[TXN_FEE_TOKEN], 8);
+    roinput_add_bit(input, in[TXN_FEE_PAYER + FIELD_BYTES]);
+    roinput_add_bytes(input, &in[TXN_NONCE], 4);
+    roinput_add_bytes(input, &in[TXN_VALID_UNTIL], 4);
+    roinput_add_bytes(input, &in[TXN_MEMO], MEMO_BYTES);
+    for (size_t i = 0; i < 3; i++) {
+        roinput_add_bit(input, (in[TXN_TAG] >> i) & 1);
+    }
+    roinput_add_bit(input, in[TXN_SOURCE + FIELD_BYTES]);
+    roinput_add_bit(input, in[TXN_RECEIVER + FIELD_BYTES]);
+    roinput_add_bytes(input, &in[TXN_TOKEN_ID], 8);
+    roinput_add_bytes(input, &in[TXN_AMOUNT], 8);
+    roinput_add_bit(input, in[TXN_TOKEN_LOCKED]);
+    return true;
+}
+
+// Hex of the little endian bytes
+
+char *field_to_hex(char *hex, const size_t len, const Field x)
+{
+    assert(len >= 2*FIELD_BYTES + 1);
+    uint8_t bytes[FIELD_BYTES];
+    field_to_bytes(bytes, x);
+    hex_encode(hex, bytes, sizeof(bytes));
+    return hex;
+}
+
+char *scalar_to_hex(char *hex, const size_t len, const Scalar x)
+{
+    assert(len >= 2*SCALAR_BYTES + 1);
+    uint8_t bytes[SCALAR_BYTES];
+    scalar_to_bytes(bytes, x);
+    hex_encode(hex, bytes, sizeof(bytes));
+    return hex;
+}
+
+// Mina's signature hex, rx then s, each as a big endian number
+
+void signature_to_hex(char hex[2*SIGNATURE_BYTES + 1], const Signature *sig)
+{
+    uint8_t bytes[SIGNATURE_BYTES];
+    uint8_t be[SIGNATURE_BYTES];
+    signature_to_bytes(bytes, sig);
+    for (size_t i = 0; i < FIELD_BYTES; i++) {
+        be[i] = bytes[FIELD_BYTES - 1 - i];
+        be[FIELD_BYTES + i] = bytes[SIGNATURE_BYTES - 1 - i];
+    }
+    hex_encode(hex, be, sizeof(be));
+}
+
+bool signature_from_hex(Signature *sig, const char *hex)
+{
+    uint8_t bytes[SIGNATURE_BYTES];
+    uint8_t be[SIGNATURE_BYTES];
+    if (!hex_decode(be, hex, sizeof(be)) || hex[2*SIGNATURE_BYTES] != '\0') {
+        return false;
+    }
+    for (size_t i = 0; i < FIELD_BYTES; i++) {
+        bytes[FIELD_BYTES - 1 - i] = be[i];
+        bytes[SIGNATURE_BYTES - 1 - i] = be[FIELD_BYTES + i];
+    }
+    return signature_from_bytes(sig, bytes);
+}
+
 bool field_from_hex(Field b, const char *hex) {
   if (strnlen(hex, 64) != 64) {
     return false;
   }
   uint8_t bytes[32];
-  for (size_t i = 0; i < sizeof(bytes); i++) {
-    sscanf(&hex[2*i], "%02hhx", &bytes[i]);
+  if (!hex_decode(bytes, hex, sizeof(bytes))) {
+    return false;
   }
 
   if (bytes[31] & 0xc0) {
       return false;
   }
 
-  fiat_pasta_fp_to_montgomery(b, (uint64_t *)bytes);
+  uint64_t words[4];
+  words_from_bytes(words, bytes);
+  pasta_fp_to_montgomery_sparse(b, words);
   return true;
 }
 
@@ -99,7 +357,7 @@ void field_copy(Field c, const Field a)
 bool field_is_odd(const Field y)
 {
     uint64_t tmp[4];
-    fiat_pasta_fp_from_montgomery(tmp, y);
+    pasta_fp_from_montgomery_sparse(tmp, y);
     return tmp[0] & 1;
 }
 
@@ -113,38 +371,82 @@ void field_sub(Field c, const Field a, const Field b)
     fiat_pasta_fp_sub(c, a, b);
 }
 
+// Single element multiplication goes through the dispatch table: the
+// sparse-modulus C code, or MULX/ADCX/ADOX on CPUs with BMI2 and ADX.
+
 void field_mul(Field c, const Field a, const Field b)
 {
-    fiat_pasta_fp_mul(c, a, b);
+    OP_COUNT(field_mul, 1);
+    dispatch.fp_mul(c, a, b);
 }
 
 void field_sq(Field c, const Field a)
 {
-    fiat_pasta_fp_square(c, a);
+    OP_COUNT(field_sq, 1);
+    dispatch.fp_square(c, a);
 }
 
-void field_pow(Field c, const Field a, const uint8_t b)
+// c = a[0]*b[0] + ... + a[n-1]*b[n-1], accumulating the products unreduced
+// and reducing once per PASTA_SUM_OF_PRODUCTS_MAX of them
+void field_sum_of_products(Field c, const Field *a, const Field *b, const size_t n)
+{
+    OP_COUNT(field_mul, n);
+    size_t chunk = n < PASTA_SUM_OF_PRODUCTS_MAX ? n : PASTA_SUM_OF_PRODUCTS_MAX;
+    dispatch.fp_sum_of_products(c, a, b, chunk);
+
+    for (size_t i = chunk; i < n; i += chunk) {
+        Field tmp, sum;
+        chunk = n - i < PASTA_SUM_OF_PRODUCTS_MAX ? n - i : PASTA_SUM_OF_PRODUCTS_MAX;
+        dispatch.fp_sum_of_products(tmp, &a[i], &b[i], chunk);
+        field_add(sum, c, tmp);
+        field_copy(c, sum);
+    }
+}
+
+// Batched variants operate on n independent elements at once using the
+// vector kernels in pasta_simd.c (c may alias a or b)
+void field_mul_batch(Field *c, const Field *a, const Field *b, const size_t n)
 {
-    field_copy(c, FIELD_ONE);
+    OP_COUNT(field_mul, n);
+    pasta_fp_mul_batch(c, a, b, n);
+}
+
+void field_sq_batch(Field *c, const Field *a, const size_t n)
+{
+    OP_COUNT(field_sq, n);
+    pasta_fp_square_batch(c, a, n);
+}
 
+// Square and multiply from the top bit down, starting from a rather than 1.
+// The field operations allow c == a, only a itself has to be kept.
+void field_pow(Field c, const Field a, const uint8_t b)
+{
     if (b == 0) {
-      return;
+        field_copy(c, FIELD_ONE);
+        return;
     }
 
-    Field tmp;
-    for (size_t i = log2(b) + 1; i > 0; i--) {
-        field_copy(tmp, c);
-        field_sq(c, tmp);
+    Field base;
+    const uint64_t *x = a;
+    if (c == a) {
+        field_copy(base, a);
+        x = base;
+    }
+    else {
+        field_copy(c, a);
+    }
 
-        if (b & (1 << (i - 1))) {
-            field_copy(tmp, c);
-            field_mul(c, tmp, a);
+    for (int i = 30 - __builtin_clz(b); i >= 0; i--) {
+        field_sq(c, c);
+        if (b & (1 << i)) {
+            field_mul(c, c, x);
         }
     }
 }
 
 void field_inv(Field c, const Field a)
 {
+    OP_COUNT(field_inv, 1);
     fiat_pasta_fp_inv(c, a);
 }
 
@@ -167,15 +469,17 @@ bool scalar_from_hex(Field b, const char *hex) {
     return false;
   }
   uint8_t bytes[32];
-  for (size_t i = 0; i < sizeof(bytes); i++) {
-    sscanf(&hex[2*i], "%02hhx", &bytes[i]);
+  if (!hex_decode(bytes, hex, sizeof(bytes))) {
+    return false;
   }
 
   if (bytes[31] & 0xc0) {
       return false;
   }
 
-  fiat_pasta_fq_to_montgomery(b, (uint64_t *)bytes);
+  uint64_t words[4];
+  words_from_bytes(words, bytes);
+  pasta_fq_to_montgomery_sparse(b, words);
   return true;
 }
 
@@ -184,7 +488,7 @@ void scalar_from_words(Scalar b, const uint64_t words[4])
     uint64_t tmp[4];
     memcpy(tmp, words, sizeof(tmp));
     tmp[3] &= (((uint64_t)1 << 62) - 1); // drop top two bits
-    fiat_pasta_fq_to_montgomery(b, tmp);
+    pasta_fq_to_montgomery_sparse(b, tmp);
 }
 
 void scalar_copy(Scalar b, const Scalar a)
@@ -204,12 +508,13 @@ void scalar_sub(Scalar c, const Scalar a, const Scalar b)
 
 void scalar_mul(Scalar c, const Scalar a, const Scalar b)
 {
-    fiat_pasta_fq_mul(c, a, b);
+    OP_COUNT(scalar_mul, 1);
+    dispatch.fq_mul(c, a, b);
 }
 
 void scalar_sq(Scalar c, const Scalar a)
 {
-    fiat_pasta_fq_square(c, a);
+    dispatch.fq_square(c, a);
 }
 
 void scalar_negate(Scalar c, const Scalar a)
@@ -296,15 +601,86 @@ void affine_from_group(Affine *r, const Group *p)
     field_mul(r->y, p->Y, zi3); // Y/Z^3
 }
 
+// c[i] = 1/a[i] with a single inversion (Montgomery's trick), c must not
+// alias a.  Zero inputs are not allowed.
+void field_inv_batch(Field *c, const Field *a, const size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+
+    // c[i] = a[0] * ... * a[i]
+    field_copy(c[0], a[0]);
+    for (size_t i = 1; i < n; i++) {
+        field_mul(c[i], c[i - 1], a[i]);
+    }
+
+    Field inv, tmp;
+    field_inv(inv, c[n - 1]);
+    for (size_t i = n - 1; i > 0; i--) {
+        field_mul(c[i], inv, c[i - 1]); // 1/a[i]
+        field_mul(tmp, inv, a[i]);      // 1/(a[0] * ... * a[i - 1])
+        field_copy(inv, tmp);
+    }
+    field_copy(c[0], inv);
+}
+
+// affine_from_group for n points with a single inversion, r[i].x holds
+// the running products of the Z coordinates
+void affine_from_group_batch(Affine *r, const Group *p, const size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+
+    // Points at infinity contribute 1 to the product
+    Field acc;
+    field_copy(acc, FIELD_ONE);
+    for (size_t i = 0; i < n; i++) {
+        if (!is_zero(&p[i])) {
+            field_mul(r[i].x, acc, p[i].Z);
+            field_copy(acc, r[i].x);
+        }
+        else {
+            field_copy(r[i].x, acc);
+        }
+    }
+
+    Field inv, tmp;
+    field_inv(inv, acc);
+    for (size_t i = n; i-- > 0; ) {
+        if (is_zero(&p[i])) {
+            memcpy(r[i].x, FIELD_ZERO, FIELD_BYTES);
+            memcpy(r[i].y, FIELD_ZERO, FIELD_BYTES);
+            continue;
+        }
+
+        Field zi, zi2, zi3;
+        if (i > 0) {
+            field_mul(zi, inv, r[i - 1].x); // 1/Z
+            field_mul(tmp, inv, p[i].Z);
+            field_copy(inv, tmp);
+        }
+        else {
+            field_copy(zi, inv);
+        }
+        field_sq(zi2, zi);                  // 1/Z^2
+        field_mul(zi3, zi2, zi);            // 1/Z^3
+        field_mul(r[i].x, p[i].X, zi2);     // X/Z^2
+        field_mul(r[i].y, p[i].Y, zi3);     // Y/Z^3
+    }
+}
+
 void group_one(Group *a)
 {
     affine_to_group(a, &AFFINE_ONE);
 }
 
 // https://www.hyperelliptic.org/EFD/g1p/auto-code/shortw/jacobian-0/doubling/dbl-2009-l.op3
-// cost 2M + 5S + 6add + 3*2 + 1*3 + 1*8
+// cost 2M + 5S + 14add (a = 0, multiplications by 3 and 8 are additions)
 void group_dbl(Group *r, const Group *p)
 {
+    OP_COUNT(group_dbl, 1);
     if (is_zero(p)) {
         *r = *p;
         return;
@@ -321,14 +697,17 @@ void group_dbl(Group *r, const Group *p)
     field_sub(r->Z, r->Y, a);     // t2 = t1 - a
     field_sub(r->X, r->Z, c);     // t3 = t2 - c
     field_add(d, r->X, r->X);     // d = 2 * t3
-    field_mul(e, FIELD_THREE, a); // e = 3 * a
+    field_add(f, a, a);           // 2 * a
+    field_add(e, f, a);           // e = 3 * a
     field_sq(f, e);               // f = e^2
 
     field_add(r->Y, d, d);        // t4 = 2 * d
     field_sub(r->X, f, r->Y);     // X = f - t4
 
     field_sub(r->Y, d, r->X);     // t5 = d - X
-    field_mul(f, FIELD_EIGHT, c); // t6 = 8 * c
+    field_add(f, c, c);           // 2 * c
+    field_add(r->Z, f, f);        // 4 * c
+    field_add(f, r->Z, r->Z);     // t6 = 8 * c
     field_mul(r->Z, e, r->Y);     // t7 = e * t5
     field_sub(r->Y, r->Z, f);     // Y = t7 - t6
 
@@ -337,9 +716,10 @@ void group_dbl(Group *r, const Group *p)
 }
 
 // https://www.hyperelliptic.org/EFD/g1p/auto-code/shortw/jacobian-0/addition/add-2007-bl.op3
-// cost 11M + 5S + 9add + 4*2
+// cost 11M + 5S + 12add + 1neg (two of the products share one reduction)
 void group_add(Group *r, const Group *p, const Group *q)
 {
+    OP_COUNT(group_add, 1);
     if (is_zero(p)) {
         *r = *q;
         return;
@@ -350,10 +730,6 @@ void group_add(Group *r, const Group *p, const Group *q)
         return;
     }
 
-    if (field_eq(p->X, q->X) && field_eq(p->Y, q->Y) && field_eq(p->Z, q->Z)) {
-        return group_dbl(r, p);
-    }
-
     Field z1z1, z2z2;
     field_sq(z1z1, p->Z);         // Z1Z1 = Z1^2
     field_sq(z2z2, q->Z);         // Z2Z2 = Z2^2
@@ -368,6 +744,18 @@ void group_add(Group *r, const Group *p, const Group *q)
 
     Field h, i, j, w, v;
     field_sub(h, u2, u1);         // h = u2 - u1
+
+    // Equal x: p = q needs the doubling formula, p = -q sums to zero
+    if (field_eq(h, FIELD_ZERO)) {
+        if (field_eq(s1, s2)) {
+            group_dbl(r, p);
+        }
+        else {
+            *r = GROUP_ZERO;
+        }
+        return;
+    }
+
     field_add(r->Z, h, h);        // t2 = 2 * h
     field_sq(i, r->Z);            // i = t2^2
     field_mul(j, h, i);           // j = h * i
@@ -381,12 +769,14 @@ void group_add(Group *r, const Group *p, const Group *q)
     field_sub(r->Z, r->X, j);     // t6 = t4 - j
     field_sub(r->X, r->Z, r->Y);  // t6 - t5
 
-    // Y3 = w * (v - X3) - 2*s1*j
-    field_sub(r->Y, v, r->X);     // t7 = v - X3
-    field_mul(r->Z, s1, j);       // t8 = s1 * j
-    field_add(s1, r->Z, r->Z);    // t9 = 2 * t8
-    field_mul(r->Z, w, r->Y);     // t10 = w * t7
-    field_sub(r->Y, r->Z, s1);    // w * (v - X3) - 2*s1*j
+    // Y3 = w * (v - X3) - 2*s1*j = -(w * (X3 - v) + s1 * 2*j)
+    Field lhs[2], rhs[2];
+    field_copy(lhs[0], w);
+    field_copy(lhs[1], s1);
+    field_sub(rhs[0], r->X, v);   // t7 = X3 - v
+    field_add(rhs[1], j, j);      // t8 = 2 * j
+    field_sum_of_products(r->Z, lhs, rhs, 2); // t9 = w * t7 + s1 * t8
+    field_negate(r->Y, r->Z);     // -t9
 
     // Z3 = ((Z1 + Z2)^2 - Z1Z1 - Z2Z2) * h
     field_add(r->Z, p->Z, q->Z);  // t11 = z1 + z2
@@ -398,9 +788,11 @@ void group_add(Group *r, const Group *p, const Group *q)
 
 // https://www.hyperelliptic.org/EFD/g1p/auto-code/shortw/jacobian-0/addition/madd-2007-bl.op3
 // for p = (X1, Y1, Z1), q = (X2, Y2, Z2); assumes Z2 = 1
-// cost 7M + 4S + 9add + 3*2 + 1*4 ?
+// cost 7M + 4S + 13add + 1neg (4*hh by additions, two of the products
+// share one reduction)
 void group_madd(Group *r, const Group *p, const Group *q)
 {
+    OP_COUNT(group_madd, 1);
     if (is_zero(p)) {
         *r = *q;
         return;
@@ -420,10 +812,23 @@ void group_madd(Group *r, const Group *p, const Group *q)
 
     Field h, hh;
     field_sub(h, u2, p->X);          // h = u2 - X1
+
+    // Equal x: p = q needs the doubling formula, p = -q sums to zero
+    if (field_eq(h, FIELD_ZERO)) {
+        if (field_eq(s2, p->Y)) {
+            group_dbl(r, p);
+        }
+        else {
+            *r = GROUP_ZERO;
+        }
+        return;
+    }
+
     field_sq(hh, h);                 // hh = h^2
 
     Field j, w, v;
-    field_mul(r->X, FIELD_FOUR, hh); // i = 4 * hh
+    field_add(v, hh, hh);            // 2 * hh
+    field_add(r->X, v, v);           // i = 4 * hh
     field_mul(j, h, r->X);           // j = h * i
     field_sub(r->Y, s2, p->Y);       // t1 = s2 - Y1
     field_add(w, r->Y, r->Y);        // w = 2 * t1
@@ -435,12 +840,14 @@ void group_madd(Group *r, const Group *p, const Group *q)
     field_sub(r->Z, r->X, j);        // t4 = t2 - j
     field_sub(r->X, r->Z, r->Y);     // X3 = w^2 - j - 2*v = t4 - t3
 
-    // Y3 = w * (V - X3) - 2*Y1*J
-    field_sub(r->Y, v, r->X);        // t5 = v - X3
-    field_mul(v, p->Y, j);           // t6 = Y1 * j
-    field_add(r->Z, v, v);           // t7 = 2 * t6
-    field_mul(s2, w, r->Y);          // t8 = w * t5
-    field_sub(r->Y, s2, r->Z);       // w * (v - X3) - 2*Y1*j = t8 - t7
+    // Y3 = w * (V - X3) - 2*Y1*J = -(w * (X3 - V) + Y1 * 2*J)
+    Field lhs[2], rhs[2];
+    field_copy(lhs[0], w);
+    field_copy(lhs[1], p->Y);
+    field_sub(rhs[0], r->X, v);      // t5 = X3 - v
+    field_add(rhs[1], j, j);         // t6 = 2 * j
+    field_sum_of_products(s2, lhs, rhs, 2); // t7 = w * t5 + Y1 * t6
+    field_negate(r->Y, s2);          // -t7
 
     // Z3 = (Z1 + H)^2 - Z1Z1 - HH
     field_add(w, p->Z, h);           // t9 = Z1 + h
@@ -459,11 +866,14 @@ void group_scalar_mul(Group *r, const Scalar k, const Group *p)
         return;
     }
 
+    // Mixed addition is cheaper when p is normalized
+    void (*add)(Group *, const Group *, const Group *) = field_eq(p->Z, FIELD_ONE) ? group_madd : group_add;
+
     // Group r1 = *p;
     Group tmp;
 
     uint64_t k_bits[4];
-    fiat_pasta_fq_from_montgomery(k_bits, k);
+    pasta_fq_from_montgomery_sparse(k_bits, k);
 
     // Not constant time
     for (size_t i = 0; i < FIELD_SIZE_IN_BITS; ++i) {
@@ -475,7 +885,7 @@ void group_scalar_mul(Group *r, const Scalar k, const Group *p)
         group_dbl(&tmp, r);
 
         if (di) {
-          group_add(r, &tmp, p);
+          add(r, &tmp, p);
         } else {
           field_copy(r->X, tmp.X);
           field_copy(r->Y, tmp.Y);
@@ -484,6 +894,232 @@ void group_scalar_mul(Group *r, const Scalar k, const Group *p)
     }
 }
 
+// Co-Z arithmetic: points that share the same Z coordinate, which is not
+// stored.  See Goundar, Joye, Miyaji, Rivain and Venelli, "Scalar
+// multiplication on Weierstrass elliptic curves from Co-Z arithmetic".
+typedef struct coz_point_t {
+    Field X;
+    Field Y;
+} CoZPoint;
+
+// (P, Q) -> (P', P + Q) where P' is P rescaled to the new common Z,
+// Z' = Z * lambda
+// cost 4M + 2S + 6add
+static void coz_addu(CoZPoint *p, CoZPoint *q, Field lambda)
+{
+    OP_COUNT(group_coz_add, 1);
+    Field c, w1, w2, d, a1;
+    field_sub(lambda, p->X, q->X);  // lambda = X1 - X2
+    field_sq(c, lambda);            // C = lambda^2
+    field_mul(w1, p->X, c);         // W1 = X1 * C
+    field_mul(w2, q->X, c);         // W2 = X2 * C
+    field_sub(c, p->Y, q->Y);       // Y1 - Y2
+    field_sq(d, c);                 // D = (Y1 - Y2)^2
+    field_sub(q->X, w1, w2);        // W1 - W2
+    field_mul(a1, p->Y, q->X);      // A1 = Y1 * (W1 - W2)
+
+    field_sub(q->Y, d, w1);
+    field_sub(q->X, q->Y, w2);      // X3 = D - W1 - W2
+    field_sub(d, w1, q->X);         // W1 - X3
+    field_mul(q->Y, c, d);
+    field_sub(q->Y, q->Y, a1);      // Y3 = (Y1 - Y2) * (W1 - X3) - A1
+
+    field_copy(p->X, w1);
+    field_copy(p->Y, a1);
+}
+
+// (P, Q) -> (P - Q, P + Q), both with Z' = Z * (X1 - X2)
+// cost 5M + 3S + 11add
+static void coz_addc(CoZPoint *p, CoZPoint *q)
+{
+    OP_COUNT(group_coz_add, 1);
+    Field lambda, c, w1, w2, a1, t, u;
+    field_sub(lambda, p->X, q->X);  // X1 - X2
+    field_sq(c, lambda);            // C = (X1 - X2)^2
+    field_mul(w1, p->X, c);         // W1 = X1 * C
+    field_mul(w2, q->X, c);         // W2 = X2 * C
+    field_sub(t, w1, w2);           // W1 - W2
+    field_mul(a1, p->Y, t);         // A1 = Y1 * (W1 - W2)
+    field_add(c, w1, w2);           // W1 + W2
+
+    Field diff, sum;
+    field_sub(diff, p->Y, q->Y);    // Y1 - Y2
+    field_add(sum, p->Y, q->Y);     // Y1 + Y2
+
+    // P + Q
+    field_sq(t, diff);              // D = (Y1 - Y2)^2
+    field_sub(q->X, t, c);          // X3 = D - W1 - W2
+    field_sub(t, w1, q->X);         // W1 - X3
+    field_mul(u, diff, t);
+    field_sub(q->Y, u, a1);         // Y3 = (Y1 - Y2) * (W1 - X3) - A1
+
+    // P - Q
+    field_sq(t, sum);               // D' = (Y1 + Y2)^2
+    field_sub(p->X, t, c);          // X3' = D' - W1 - W2
+    field_sub(t, w1, p->X);         // W1 - X3'
+    field_mul(u, sum, t);
+    field_sub(p->Y, u, a1);         // Y3' = (Y1 + Y2) * (W1 - X3') - A1
+}
+
+// Swaps a and b when swap is set, without branching on it
+static void field_cswap(Field a, Field b, const bool swap)
+{
+    const uint64_t mask = -(uint64_t)swap;
+    for (size_t i = 0; i < LIMBS_PER_FIELD; i++) {
+        const uint64_t t = mask & (a[i] ^ b[i]);
+        a[i] ^= t;
+        b[i] ^= t;
+    }
+}
+
+static void coz_cswap(CoZPoint *a, CoZPoint *b, const bool swap)
+{
+    field_cswap(a->X, b->X, swap);
+    field_cswap(a->Y, b->Y, swap);
+}
+
+// r = mask ? a : r, for mask all zeros or all ones
+static void field_cmov(Field r, const Field a, const uint64_t mask)
+{
+    for (size_t i = 0; i < LIMBS_PER_FIELD; i++) {
+        r[i] ^= mask & (r[i] ^ a[i]);
+    }
+}
+
+// All ones if a = b, else zero
+static uint64_t words_eq_mask(const uint64_t a[4], const uint64_t b[4])
+{
+    uint64_t d = 0;
+    for (size_t i = 0; i < 4; i++) {
+        d |= a[i] ^ b[i];
+    }
+    return ((d | -d) >> 63) - 1;
+}
+
+// r = a + b for 256-bit words, dropping the carry out
+static void words_add(uint64_t r[4], const uint64_t a[4], const uint64_t b[4])
+{
+    unsigned __int128 carry = 0;
+    for (size_t i = 0; i < 4; i++) {
+        carry += (unsigned __int128)a[i] + b[i];
+        r[i] = (uint64_t)carry;
+        carry >>= 64;
+    }
+}
+
+// r = k*p with a co-Z Montgomery ladder (X and Y only).  The ladder runs
+// over k + n or k + 2n (n the group order), whichever has bit 255 set, so
+// every k takes the same 255 ZADDC + ZADDU steps (9M + 5S each) with no
+// branch on its bits.  k = 0, 1, n - 2 and n - 1 would meet the point at
+// infinity or equal points in the ladder, so those run it for k = 2 and
+// the result is replaced with masks.  Z is recovered from p at the end.
+void group_scalar_mul_coz(Group *r, const Scalar k, const Affine *p)
+{
+    static const uint64_t ORDER[4] = {
+        0x8c46eb2100000001, 0x224698fc0994a8dd, 0x0000000000000000, 0x4000000000000000
+    };
+    static const uint64_t ORDER_MINUS_ONE[4] = {
+        0x8c46eb2100000000, 0x224698fc0994a8dd, 0x0000000000000000, 0x4000000000000000
+    };
+    static const uint64_t ORDER_MINUS_TWO[4] = {
+        0x8c46eb20ffffffff, 0x224698fc0994a8dd, 0x0000000000000000, 0x4000000000000000
+    };
+    static const uint64_t ZERO[4] = { 0, 0, 0, 0 };
+    static const uint64_t ONE[4] = { 1, 0, 0, 0 };
+    static const uint64_t TWO[4] = { 2, 0, 0, 0 };
+
+    *r = GROUP_ZERO;
+    if (affine_is_zero(p)) {
+        return;
+    }
+
+    uint64_t k_bits[4];
+    pasta_fq_from_montgomery_sparse(k_bits, k);
+
+    const uint64_t is_zero = words_eq_mask(k_bits, ZERO);
+    const uint64_t is_one = words_eq_mask(k_bits, ONE);
+    const uint64_t is_minus_one = words_eq_mask(k_bits, ORDER_MINUS_ONE);
+    const uint64_t is_minus_two = words_eq_mask(k_bits, ORDER_MINUS_TWO);
+    const uint64_t special = is_zero | is_one | is_minus_one | is_minus_two;
+    for (size_t i = 0; i < 4; i++) {
+        k_bits[i] ^= special & (k_bits[i] ^ TWO[i]);
+    }
+
+    // k + n < 2^256 always, and k + 2n when k + n < 2^255
+    uint64_t k1[4], k2[4];
+    words_add(k1, k_bits, ORDER);
+    words_add(k2, k1, ORDER);
+    const uint64_t use_k1 = -(k1[3] >> 63);
+    for (size_t i = 0; i < 4; i++) {
+        k_bits[i] = k2[i] ^ (use_k1 & (k1[i] ^ k2[i]));
+    }
+
+    // R[1] = 2P and R[0] = P with the common Z = 2y (dbl-2009-l with Z1 = 1)
+    // cost 1M + 5S
+    CoZPoint R[2];
+    Field a, b, c, d, e;
+    field_sq(a, p->x);              // a = x^2
+    field_sq(b, p->y);              // b = y^2
+    field_sq(c, b);                 // c = b^2
+    field_add(d, p->x, b);
+    field_sq(e, d);
+    field_sub(d, e, a);
+    field_sub(e, d, c);
+    field_add(R[0].X, e, e);        // S = 2 * ((x + b)^2 - a - c) = x * (2y)^2
+    field_add(d, c, c);
+    field_add(e, d, d);
+    field_add(R[0].Y, e, e);        // 8c = y * (2y)^3
+    field_add(d, a, a);
+    field_add(e, d, a);             // M = 3a
+    field_sq(d, e);
+    field_sub(a, d, R[0].X);
+    field_sub(R[1].X, a, R[0].X);   // X = M^2 - 2S
+    field_sub(a, R[0].X, R[1].X);
+    field_mul(d, e, a);
+    field_sub(R[1].Y, d, R[0].Y);   // Y = M * (S - X) - 8c
+
+    // Invariant R[1] - R[0] = P
+    Field num, den, lambda;
+    for (size_t j = 255; j-- > 0; ) {
+        const bool bit = (k_bits[j / 64] >> (j % 64)) & 1;
+
+        coz_cswap(&R[0], &R[1], bit);
+        coz_addc(&R[0], &R[1]);     // R[0] = R_bit - R_!bit = (bit ? P : -P)
+
+        if (j == 0) {
+            // R[0] is +-(x Z^2, y Z^3), so Z = num/den
+            Field neg;
+            field_mul(num, R[0].Y, p->x);
+            field_mul(den, R[0].X, p->y);
+            field_negate(neg, num);
+            field_cswap(num, neg, !bit);
+        }
+
+        coz_addu(&R[1], &R[0], lambda);
+        coz_cswap(&R[0], &R[1], bit);
+    }
+
+    // Scale (X : Y : num*lambda/den) by den
+    field_mul(r->Z, num, lambda);
+    field_sq(a, den);
+    field_mul(r->X, R[0].X, a);
+    field_mul(b, a, den);
+    field_mul(r->Y, R[0].Y, b);
+
+    // 2P becomes -2P, P, -P or the point at infinity for the special k
+    Field neg;
+    field_negate(neg, r->Y);
+    field_cmov(r->Y, neg, is_minus_two);
+    field_negate(neg, p->y);
+    field_cmov(neg, p->y, is_one);
+    field_cmov(r->X, p->x, is_one | is_minus_one);
+    field_cmov(r->Y, neg, is_one | is_minus_one);
+    field_cmov(r->Z, FIELD_ONE, is_one | is_minus_one);
+    field_cmov(r->X, GROUP_ZERO.X, is_zero);
+    field_cmov(r->Y, GROUP_ZERO.Y, is_zero);
+    field_cmov(r->Z, GROUP_ZERO.Z, is_zero);
+}
+
 void group_negate(Group *q, const Group *p)
 {
     field_copy(q->X, p->X);
@@ -491,11 +1127,12 @@ void group_negate(Group *q, const Group *p)
     field_copy(q->Z, p->Z);
 }
 
+// Used with secret scalars (keys, nonces), so this takes the regular
+// co-Z ladder
 void affine_scalar_mul(Affine *r, const Scalar k, const Affine *p)
 {
-    Group pp, pr;
-    affine_to_group(&pp, p);
-    group_scalar_mul(&pr, k, &pp);
+    Group pr;
+    group_scalar_mul_coz(&pr, k, p);
     affine_from_group(r, &pr);
 }
 
@@ -513,12 +1150,11 @@ void affine_add(Affine *r, const Affine *p, const Affine *q)
     affine_from_group(r, &gr);
 }
 
+// -(x, y) = (x, -y), and the point at infinity (0, 0) is its own negation
 void affine_negate(Affine *q, const Affine *p)
 {
-    Group gq, gp;
-    affine_to_group(&gp, p);
-    group_negate(&gq, &gp);
-    affine_from_group(q, &gq);
+    field_copy(q->x, p->x);
+    field_negate(q->y, p->y);
 }
 
 bool affine_is_on_curve(const Affine *p)
@@ -574,7 +1210,7 @@ void roinput_add_scalar(ROInput *input, const Scalar a) {
   const size_t len = FIELD_SIZE_IN_BITS;
 
   uint64_t scalar_bigint[4];
-  fiat_pasta_fq_from_montgomery(scalar_bigint, a);
+  pasta_fq_from_montgomery_sparse(scalar_bigint, a);
 
   if (remaining < len) {
     printf("add_scalar: bits at capacity\n");
@@ -599,14 +1235,17 @@ void roinput_add_bytes(ROInput *input, const uint8_t *bytes, size_t len) {
     exit(1);
   }
 
-  // LSB bits
-  size_t k = input->bits_len;
-  for (size_t i = 0; i < len; ++i) {
-    const uint8_t b = bytes[i];
-
-    for (size_t j = 0; j < 8; ++j) {
-      packed_bit_array_set(input->bits, k, (b >> j) & 1);
-      ++k;
+  // LSB bits, a byte at a time: the low bits of each byte complete the
+  // partial byte at bits_len, the high bits start the next one
+  uint8_t *out = input->bits + input->bits_len / 8;
+  const size_t shift = input->bits_len % 8;
+  if (shift == 0) {
+    memcpy(out, bytes, len);
+  }
+  else {
+    for (size_t i = 0; i < len; ++i) {
+      out[i] = (out[i] & ((1 << shift) - 1)) | (uint8_t)(bytes[i] << shift);
+      out[i + 1] = bytes[i] >> (8 - shift);
     }
   }
 
@@ -642,7 +1281,7 @@ void roinput_to_bytes(uint8_t *out, const ROInput *input) {
 
   // first the field elements, then the bitstrings
   for (size_t i = 0; i < input->fields_len; ++i) {
-    fiat_pasta_fp_from_montgomery(tmp, input->fields + (i * LIMBS_PER_FIELD));
+    pasta_fp_from_montgomery_sparse(tmp, input->fields + (i * LIMBS_PER_FIELD));
 
     for (size_t j = 0; j < FIELD_SIZE_IN_BITS; ++j) {
       size_t limb_idx = j / 64;
@@ -691,7 +1330,7 @@ size_t roinput_to_fields(uint64_t *out, const ROInput *input) {
 
       chunk_non_montgomery[limb_idx] =  chunk_non_montgomery[limb_idx] | (((uint64_t) b) << in_limb_idx);
     }
-    fiat_pasta_fp_to_montgomery(next_chunk, chunk_non_montgomery);
+    pasta_fp_to_montgomery_sparse(next_chunk, chunk_non_montgomery);
 
     output_len += 1;
     bits_consumed += chunk_size_in_bits;
@@ -735,7 +1374,7 @@ void generate_keypair(Keypair *keypair, uint32_t account)
     // insignificant amount of entropy.
 
     priv_non_montgomery[3] &= (((uint64_t)1 << 62) - 1); // drop top two bits
-    fiat_pasta_fq_to_montgomery(keypair->priv, priv_non_montgomery);
+    pasta_fq_to_montgomery_sparse(keypair->priv, priv_non_montgomery);
 
     affine_scalar_mul(&keypair->pub, keypair->priv, &AFFINE_ONE);
 
@@ -767,7 +1406,7 @@ bool generate_address(char *address, const size_t len, const Affine *pub_key)
     raw.payload[1] = 0x01; // compressed_poly version
 
     // x-coordinate
-    fiat_pasta_fp_from_montgomery((uint64_t *)&raw.payload[2], pub_key->x);
+    pasta_fp_from_montgomery_sparse((uint64_t *)&raw.payload[2], pub_key->x);
 
     // y-coordinate parity
     raw.payload[34] = field_is_odd(pub_key->y);
@@ -781,50 +1420,114 @@ bool generate_address(char *address, const size_t len, const Affine *pub_key)
     memcpy(raw.checksum, hash2, 4);
 
     // Encode as address
-    size_t out_len = len;
-    bool result = b58enc(address, &out_len, &raw, sizeof(raw));
-    address[MINA_ADDRESS_LEN - 1] = '\0';
-    assert(out_len == len);
-    if (out_len != len) {
-        return false;
+    return b58enc_address(address, (const uint8_t *)&raw);
+}
+
+// Nonce derivation
+//
+//     The nonce is blake2b of the bits of the message fields, pub.x, pub.y,
+//     the message bits, priv and the network id, packed least significant
+//     bit first.  The key dependent parts are packed once by derive_init,
+//     and derive_nonce streams the rest straight into blake2b, without
+//     copying the message into a bigger ROInput and serializing all of it.
+
+typedef struct derive_writer_t {
+    blake2b_state state;
+    uint8_t buf[BLAKE2B_BLOCKBYTES];
+    size_t len;      // bytes in buf
+    uint64_t acc;    // bits not yet in buf, the low acc_bits of them
+    size_t acc_bits; // always < 64
+} DeriveWriter;
+
+static void derive_put_word(DeriveWriter *w, const uint64_t word)
+{
+    for (size_t i = 0; i < 8; i++) {
+        w->buf[w->len++] = (uint8_t)(word >> 8*i);
+    }
+    if (w->len == sizeof(w->buf)) {
+        blake2b_update(&w->state, w->buf, w->len);
+        w->len = 0;
     }
-    return result;
 }
 
-void message_derive(Scalar out, const Keypair *kp, const ROInput *msg, uint8_t network_id)
+// Appends the low nbits bits of words, least significant first
+static void derive_put_bits(DeriveWriter *w, const uint64_t *words, const size_t nbits)
 {
-    ROInput input;
-    uint64_t input_fields[LIMBS_PER_FIELD * (msg->fields_capacity + 2)];
-    uint8_t input_bits[msg->bits_capacity/8 + SCALAR_BYTES + 1];
-    size_t bits_capacity = 8 * sizeof(input_bits);
-    uint8_t input_bytes[sizeof(input_fields) + sizeof(input_bits)];
-    bzero(input_bytes, sizeof(input_bytes));
+    for (size_t i = 0; i < nbits; i += 64) {
+        const size_t n = nbits - i < 64 ? nbits - i : 64;
+        const uint64_t v = n == 64 ? words[i/64] : words[i/64] & ((1ull << n) - 1);
+        w->acc |= v << w->acc_bits;
+        if (w->acc_bits + n >= 64) {
+            derive_put_word(w, w->acc);
+            w->acc = w->acc_bits == 0 ? 0 : v >> (64 - w->acc_bits);
+            w->acc_bits = w->acc_bits + n - 64;
+        }
+        else {
+            w->acc_bits += n;
+        }
+    }
+}
 
-    input.fields = input_fields;
-    input.bits = input_bits;
+void derive_init(DeriveCtx *ctx, const Keypair *kp, const uint8_t network_id)
+{
+    uint64_t x[4], y[4], priv[4];
+    pasta_fp_from_montgomery_sparse(x, kp->pub.x);
+    pasta_fp_from_montgomery_sparse(y, kp->pub.y);
+    pasta_fq_from_montgomery_sparse(priv, kp->priv);
+
+    // x + 2^255 y, both are below 2^255
+    bzero(ctx, sizeof(*ctx));
+    for (size_t i = 0; i < 4; i++) {
+        ctx->pub_bits[i] |= x[i];
+        ctx->pub_bits[i + 3] |= y[i] << 63;
+        ctx->pub_bits[i + 4] |= y[i] >> 1;
+    }
 
-    for (size_t i = 0; i < msg->fields_len * LIMBS_PER_FIELD; ++i) {
-      input.fields[i] = msg->fields[i];
+    // priv + 2^255 network_id
+    for (size_t i = 0; i < 4; i++) {
+        ctx->priv_bits[i] = priv[i];
     }
-    memcpy(input.bits, msg->bits, sizeof(uint8_t) * ((msg->bits_len + 7) / 8));
+    ctx->priv_bits[3] |= (uint64_t)network_id << 63;
+    ctx->priv_bits[4] = network_id >> 1;
 
-    input.fields_len = msg->fields_len;
-    input.bits_len = msg->bits_len;
-    input.fields_capacity = 5;
-    input.bits_capacity = bits_capacity;
+    secure_bzero(priv, sizeof(priv));
+}
 
-    roinput_add_field(&input, kp->pub.x);
-    roinput_add_field(&input, kp->pub.y);
-    roinput_add_scalar(&input, kp->priv);
-    roinput_add_bytes(&input, &network_id, 1);
+void derive_nonce(Scalar out, const DeriveCtx *ctx, const ROInput *msg)
+{
+    DeriveWriter w;
+    blake2b_init(&w.state, 32);
+    w.len = 0;
+    w.acc = 0;
+    w.acc_bits = 0;
+
+    for (size_t i = 0; i < msg->fields_len; i++) {
+        uint64_t x[4];
+        pasta_fp_from_montgomery_sparse(x, msg->fields + LIMBS_PER_FIELD * i);
+        derive_put_bits(&w, x, FIELD_SIZE_IN_BITS);
+    }
+    derive_put_bits(&w, ctx->pub_bits, 2*FIELD_SIZE_IN_BITS);
+
+    // Whole words of the packed message bits, without reading past the end
+    for (size_t i = 0; i < msg->bits_len; i += 64) {
+        const size_t n = msg->bits_len - i < 64 ? msg->bits_len - i : 64;
+        uint64_t word = 0;
+        for (size_t j = 0; j < (n + 7)/8; j++) {
+            word |= (uint64_t)msg->bits[i/8 + j] << 8*j;
+        }
+        derive_put_bits(&w, &word, n);
+    }
+    derive_put_bits(&w, ctx->priv_bits, FIELD_SIZE_IN_BITS + 8);
 
-    size_t input_size_in_bits = input.bits_len + FIELD_SIZE_IN_BITS * input.fields_len;
-    size_t input_size_in_bytes = (input_size_in_bits + 7) / 8;
-    assert(input_size_in_bytes <= sizeof(input_bytes));
-    roinput_to_bytes(input_bytes, &input);
+    // Partial last word, len is at most sizeof(buf) - 8 here
+    for (size_t i = 0; 8*i < w.acc_bits; i++) {
+        w.buf[w.len++] = (uint8_t)(w.acc >> 8*i);
+    }
+    blake2b_update(&w.state, w.buf, w.len);
 
     uint8_t hash_out[32];
-    blake2b(hash_out, 32, input_bytes, input_size_in_bytes, NULL, 0);
+    blake2b_final(&w.state, hash_out, sizeof(hash_out));
+    secure_bzero(&w, sizeof(w));
 
     // take 254 bits / drop the top 2 bits
     packed_bit_array_set(hash_out, 255, 0);
@@ -837,52 +1540,19 @@ void message_derive(Scalar out, const Keypair *kp, const ROInput *msg, uint8_t n
         tmp[i] |= ((uint64_t) hash_out[8*i + j]) << (8 * j);
       }
     }
-    fiat_pasta_fq_to_montgomery(out, tmp);
+    pasta_fq_to_montgomery_sparse(out, tmp);
 }
 
-void message_hash(Scalar out, const Affine *pub, const Field rx, const ROInput *msg, const uint8_t hash_type, const uint8_t network_id)
+void derive_clear(DeriveCtx *ctx)
 {
-    ROInput input;
-
-    uint64_t input_fields[LIMBS_PER_FIELD * (msg->fields_capacity + 3)];
-    uint8_t input_bits[msg->bits_capacity/8];
-
-    input.fields_capacity = msg->fields_capacity + 3;
-    input.bits_capacity = 8 * sizeof(input_bits);
-    assert(msg->bits_len <= input.bits_capacity);
-
-    input.fields = input_fields;
-    input.bits = input_bits;
-    input.fields_len = msg->fields_len;
-    input.bits_len = msg->bits_len;
-
-    memcpy(input.fields, msg->fields, sizeof(uint64_t) * LIMBS_PER_FIELD * msg->fields_len);
-    memcpy(input.bits, msg->bits, sizeof(uint8_t) * ((msg->bits_len + 7) / 8));
-
-    roinput_add_field(&input, pub->x);
-    roinput_add_field(&input, pub->y);
-    roinput_add_field(&input, rx);
-
-    // Initial sponge state
-    PoseidonCtx ctx;
-    poseidon_init(&ctx, hash_type, network_id);
-
-    Field packed_elements[input.fields_len + (size_t)ceil((float)input.bits_len/(FIELD_SIZE_IN_BITS - 1))];
-    size_t packed_elements_len = roinput_to_fields((uint64_t *)packed_elements, &input);
-    assert(packed_elements_len == sizeof(packed_elements)/FIELD_BYTES);
-
-    poseidon_update(&ctx, (Field *)packed_elements, packed_elements_len);
-    poseidon_digest(out, &ctx);
+    secure_bzero(ctx, sizeof(*ctx));
 }
 
-#define FULL_BITS_LEN (FEE_BITS + TOKEN_ID_BITS + 1 + NONCE_BITS + GLOBAL_SLOT_BITS + MEMO_BITS + TAG_BITS + 1 + 1 + TOKEN_ID_BITS + AMOUNT_BITS + 1)
-#define FULL_BITS_BYTES ((FULL_BITS_LEN + 7) / 8)
-
 void compress(Compressed *compressed, const Affine *pt) {
   fiat_pasta_fp_copy(compressed->x, pt->x);
 
   Field y_bigint;
-  fiat_pasta_fp_from_montgomery(y_bigint, pt->y);
+  pasta_fp_from_montgomery_sparse(y_bigint, pt->y);
 
   compressed->is_odd = y_bigint[0] & 1;
 }
@@ -891,9 +1561,9 @@ bool decompress(Affine *pt, const Compressed *compressed) {
   fiat_pasta_fp_copy(pt->x, compressed->x);
 
   Field x2;
-  fiat_pasta_fp_square(x2, pt->x);
+  field_sq(x2, pt->x);
   Field x3;
-  fiat_pasta_fp_mul(x3, x2, pt->x); // x^3
+  field_mul(x3, x2, pt->x); // x^3
   Field y2;
   fiat_pasta_fp_add(y2, x3, GROUP_COEFF_B);
 
@@ -902,7 +1572,7 @@ bool decompress(Affine *pt, const Compressed *compressed) {
     return false;
   }
   Field y_pre_bigint;
-  fiat_pasta_fp_from_montgomery(y_pre_bigint, y_pre);
+  pasta_fp_from_montgomery_sparse(y_pre_bigint, y_pre);
 
   const bool y_pre_odd = (y_pre_bigint[0] & 1);
   if (y_pre_odd == compressed->is_odd) {
@@ -916,8 +1586,10 @@ bool decompress(Affine *pt, const Compressed *compressed) {
 
 void read_public_key_compressed(Compressed *out, const char *pubkeyBase58) {
   size_t pubkeyBytesLen = 40;
-  unsigned char pubkeyBytes[40];
-  b58tobin(pubkeyBytes, &pubkeyBytesLen, pubkeyBase58, 0);
+  unsigned char pubkeyBytes[40] = { 0 };
+  if (!b58tobin_address(pubkeyBytes, pubkeyBase58)) {
+    b58tobin(pubkeyBytes, &pubkeyBytesLen, pubkeyBase58, 0);
+  }
 
   uint64_t x_coord_non_montgomery[4] = { 0, 0, 0, 0 };
 
@@ -931,10 +1603,73 @@ void read_public_key_compressed(Compressed *out, const char *pubkeyBase58) {
     }
   }
 
-  fiat_pasta_fp_to_montgomery(out->x, x_coord_non_montgomery);
+  pasta_fp_to_montgomery_sparse(out->x, x_coord_non_montgomery);
   out->is_odd = (bool) pubkeyBytes[offset + 32];
 }
 
+#define ADDRESS_BATCH 64
+
+// Decodes and validates n addresses.  status[i] says why addresses[i] was
+// rejected, out[i] is only written for ADDRESS_OK.  The checksums of each
+// batch of decoded addresses are computed together with sha256_hash_many.
+// Returns the number of valid addresses.
+size_t parse_addresses_batch(Compressed *out, AddressStatus *status, const char *const *addresses, const size_t n)
+{
+    uint8_t raw[ADDRESS_BATCH][B58_ADDRESS_BYTES];
+    uint8_t hash[ADDRESS_BATCH][SHA256_BLOCK_SIZE];
+    size_t index[ADDRESS_BATCH];
+    size_t valid = 0;
+
+    for (size_t start = 0; start < n; start += ADDRESS_BATCH) {
+        const size_t count = n - start < ADDRESS_BATCH ? n - start : ADDRESS_BATCH;
+
+        // Decode, keeping the candidates for the checksum contiguous
+        size_t decoded = 0;
+        for (size_t i = start; i < start + count; i++) {
+            if (strnlen(addresses[i], MINA_ADDRESS_LEN) != MINA_ADDRESS_LEN - 1) {
+                status[i] = ADDRESS_BAD_LENGTH;
+            }
+            else if (!b58tobin_address(raw[decoded], addresses[i])) {
+                status[i] = ADDRESS_BAD_ENCODING;
+            }
+            else if (raw[decoded][0] != 0xcb || raw[decoded][1] != 0x01 || raw[decoded][2] != 0x01) {
+                status[i] = ADDRESS_BAD_VERSION;
+            }
+            else {
+                index[decoded++] = i;
+            }
+        }
+
+        // Checksum is the first 4 bytes of sha256(sha256(first 36 bytes))
+        sha256_hash_many(raw, B58_ADDRESS_BYTES, B58_ADDRESS_BYTES - 4, hash, decoded);
+        sha256_hash_many(hash, SHA256_BLOCK_SIZE, SHA256_BLOCK_SIZE, hash, decoded);
+
+        for (size_t j = 0; j < decoded; j++) {
+            const size_t i = index[j];
+            if (memcmp(hash[j], &raw[j][B58_ADDRESS_BYTES - 4], 4) != 0) {
+                status[i] = ADDRESS_BAD_CHECKSUM;
+                continue;
+            }
+
+            uint64_t x[4];
+            memcpy(x, &raw[j][3], sizeof(x));
+            const uint8_t parity = raw[j][35];
+
+            if (!words_less(x, FIELD_MODULUS_WORDS) || parity > 1) {
+                status[i] = ADDRESS_BAD_KEY;
+                continue;
+            }
+
+            pasta_fp_to_montgomery_sparse(out[i].x, x);
+            out[i].is_odd = parity;
+            status[i] = ADDRESS_OK;
+            valid++;
+        }
+    }
+
+    return valid;
+}
+
 void prepare_memo(uint8_t *out, const char *s) {
   size_t len = strlen(s);
   out[0] = 1;
@@ -947,135 +1682,45 @@ void prepare_memo(uint8_t *out, const char *s) {
   }
 }
 
-bool verify(Signature *sig, const Compressed *pub_compressed, const Transaction *transaction, uint8_t network_id)
+void roinput_add_transaction(ROInput *input, const Transaction *transaction)
 {
-    // Convert transaction to ROInput
-    uint64_t input_fields[4 * 3];
-    uint8_t input_bits[FULL_BITS_BYTES];
-    ROInput input;
-    input.fields_capacity = 3;
-    input.bits_capacity = 8 * FULL_BITS_BYTES;
-    input.fields = input_fields;
-    input.bits = input_bits;
-    input.fields_len = 0;
-    input.bits_len = 0;
-
-    roinput_add_field(&input, transaction->fee_payer_pk.x);
-    roinput_add_field(&input, transaction->source_pk.x);
-    roinput_add_field(&input, transaction->receiver_pk.x);
-
-    roinput_add_uint64(&input, transaction->fee);
-    roinput_add_uint64(&input, transaction->fee_token);
-    roinput_add_bit(&input, transaction->fee_payer_pk.is_odd);
-    roinput_add_uint32(&input, transaction->nonce);
-    roinput_add_uint32(&input, transaction->valid_until);
-    roinput_add_bytes(&input, transaction->memo, MEMO_BYTES);
+    roinput_add_field(input, transaction->fee_payer_pk.x);
+    roinput_add_field(input, transaction->source_pk.x);
+    roinput_add_field(input, transaction->receiver_pk.x);
+
+    roinput_add_uint64(input, transaction->fee);
+    roinput_add_uint64(input, transaction->fee_token);
+    roinput_add_bit(input, transaction->fee_payer_pk.is_odd);
+    roinput_add_uint32(input, transaction->nonce);
+    roinput_add_uint32(input, transaction->valid_until);
+    roinput_add_bytes(input, transaction->memo, MEMO_BYTES);
     for (size_t i = 0; i < 3; ++i) {
-      roinput_add_bit(&input, transaction->tag[i]);
+      roinput_add_bit(input, transaction->tag[i]);
     }
-    roinput_add_bit(&input, transaction->source_pk.is_odd);
-    roinput_add_bit(&input, transaction->receiver_pk.is_odd);
-    roinput_add_uint64(&input, transaction->token_id);
-    roinput_add_uint64(&input, transaction->amount);
-    roinput_add_bit(&input, transaction->token_locked);
+    roinput_add_bit(input, transaction->source_pk.is_odd);
+    roinput_add_bit(input, transaction->receiver_pk.is_odd);
+    roinput_add_uint64(input, transaction->token_id);
+    roinput_add_uint64(input, transaction->amount);
+    roinput_add_bit(input, transaction->token_locked);
+}
 
-    Affine pub;
-    if (!decompress(&pub, pub_compressed)) {
-      return false;
+// One-shot sign and verify set up a SignerContext for the single message,
+// see signer_context.h for reusing one
+bool verify(Signature *sig, const Compressed *pub_compressed, const Transaction *transaction, uint8_t network_id)
+{
+    SignerContext ctx;
+    if (!signer_context_init(&ctx, network_id)) {
+        return false;
     }
-
-    Scalar e;
-    message_hash(e, &pub, sig->rx, &input, POSEIDON_LEGACY, network_id);
-
-    Group g;
-    affine_to_group(&g, &AFFINE_ONE);
-
-    Group sg;
-    group_scalar_mul(&sg, sig->s, &g);
-
-    Group pub_proj;
-    affine_to_group(&pub_proj, &pub);
-    Group epub;
-    group_scalar_mul(&epub, e, &pub_proj);
-
-    Group neg_epub;
-    fiat_pasta_fp_copy(neg_epub.X, epub.X);
-    fiat_pasta_fp_opp(neg_epub.Y, epub.Y);
-    fiat_pasta_fp_copy(neg_epub.Z, epub.Z);
-
-    Group r;
-    group_add(&r, &sg, &neg_epub);
-
-    Affine raff;
-    affine_from_group(&raff, &r);
-
-    Field ry_bigint;
-    fiat_pasta_fp_from_montgomery(ry_bigint, raff.y);
-
-    const bool ry_even = (ry_bigint[0] & 1) == 0;
-
-    return (ry_even && fiat_pasta_fp_equals(raff.x, sig->rx));
+    return verify_with_context(&ctx, sig, pub_compressed, transaction);
 }
 
 void sign(Signature *sig, const Keypair *kp, const Transaction *transaction, uint8_t network_id)
 {
-    // Convert transaction to ROInput
-    uint64_t input_fields[4 * 3];
-    uint8_t input_bits[FULL_BITS_BYTES];
-    ROInput input;
-    input.fields_capacity = 3;
-    input.bits_capacity = 8 * FULL_BITS_BYTES;
-    input.fields = input_fields;
-    input.bits = input_bits;
-    input.fields_len = 0;
-    input.bits_len = 0;
-
-    roinput_add_field(&input, transaction->fee_payer_pk.x);
-    roinput_add_field(&input, transaction->source_pk.x);
-    roinput_add_field(&input, transaction->receiver_pk.x);
-
-    roinput_add_uint64(&input, transaction->fee);
-    roinput_add_uint64(&input, transaction->fee_token);
-    roinput_add_bit(&input, transaction->fee_payer_pk.is_odd);
-    roinput_add_uint32(&input, transaction->nonce);
-    roinput_add_uint32(&input, transaction->valid_until);
-    roinput_add_bytes(&input, transaction->memo, MEMO_BYTES);
-    for (size_t i = 0; i < 3; ++i) {
-      roinput_add_bit(&input, transaction->tag[i]);
-    }
-    roinput_add_bit(&input, transaction->source_pk.is_odd);
-    roinput_add_bit(&input, transaction->receiver_pk.is_odd);
-    roinput_add_uint64(&input, transaction->token_id);
-    roinput_add_uint64(&input, transaction->amount);
-    roinput_add_bit(&input, transaction->token_locked);
-
-    Scalar k;
-    message_derive(k, kp, &input, network_id);
-
-    uint64_t k_nonzero;
-    fiat_pasta_fq_nonzero(&k_nonzero, k);
-    if (! k_nonzero) {
-      exit(1);
-    }
-
-    // r = k*g
-    Affine r;
-    affine_scalar_mul(&r, k, &AFFINE_ONE);
-
-    field_copy(sig->rx, r.x);
-
-    if (field_is_odd(r.y)) {
-        // negate (k = -k)
-        Scalar tmp;
-        fiat_pasta_fq_copy(tmp, k);
-        scalar_negate(k, tmp);
+    SignerContext ctx;
+    if (!signer_context_init(&ctx, network_id)) {
+        THROW(INVALID_PARAMETER);
     }
-
-    Scalar e;
-    message_hash(e, &kp->pub, r.x, &input, POSEIDON_LEGACY, network_id);
-
-    // s = k + e*sk
-    Scalar e_priv;
-    scalar_mul(e_priv, e, kp->priv);
-    scalar_add(sig->s, k, e_priv);
+    sign_with_context(&ctx, sig, kp, transaction);
+    signer_context_clear(&ctx);
 }
@@ -15,6 +15,9 @@
 
 #define FIELD_BYTES  32
 #define SCALAR_BYTES 32
+#define SIGNATURE_BYTES (FIELD_BYTES + SCALAR_BYTES)
+#define COMPRESSED_BYTES (FIELD_BYTES + 1)
+#define TRANSACTION_BYTES 176
 
 #define LIMBS_PER_FIELD 4
 #define LIMBS_PER_SCALAR 4
@@ -43,6 +46,11 @@ typedef uint8_t Memo[MEMO_BYTES];
 typedef bool Tag[3];
 #define TAG_BITS 3
 
+// A transaction's random oracle input is its three keys' x coordinates,
+// then this many bits
+#define TRANSACTION_ROINPUT_FIELDS 3
+#define TRANSACTION_ROINPUT_BITS (FEE_BITS + TOKEN_ID_BITS + 1 + NONCE_BITS + GLOBAL_SLOT_BITS + MEMO_BITS + TAG_BITS + 1 + 1 + TOKEN_ID_BITS + AMOUNT_BITS + 1)
+
 #define TESTNET_ID 0x00
 #define MAINNET_ID 0x01
 #define NULLNET_ID 0xff
@@ -65,6 +73,16 @@ typedef struct compressed_t {
     bool is_odd;
 } Compressed;
 
+// Result of parsing a base58check address
+typedef enum address_status_t {
+    ADDRESS_OK = 0,
+    ADDRESS_BAD_LENGTH,   // not 55 characters
+    ADDRESS_BAD_ENCODING, // invalid base58 digit, or too large for 40 bytes
+    ADDRESS_BAD_VERSION,  // not a compressed public key address
+    ADDRESS_BAD_CHECKSUM,
+    ADDRESS_BAD_KEY,      // x not a canonical field element, or parity not 0/1
+} AddressStatus;
+
 typedef struct transaction_t {
   // common
   Currency fee;
@@ -101,12 +119,24 @@ typedef struct roinput_t {
   size_t bits_capacity;
 } ROInput;
 
+// Key dependent tail of the nonce derivation input, packed once per key
+typedef struct derive_context_t {
+    uint64_t pub_bits[8];  // pub.x || pub.y, 510 bits
+    uint64_t priv_bits[5]; // priv || network_id, 263 bits
+} DeriveCtx;
+
 void roinput_add_field(ROInput *input, const Field a);
 void roinput_add_scalar(ROInput *input, const Scalar a);
 void roinput_add_bit(ROInput *input, bool b);
 void roinput_add_bytes(ROInput *input, const uint8_t *bytes, size_t len);
 void roinput_add_uint32(ROInput *input, const uint32_t x);
 void roinput_add_uint64(ROInput *input, const uint64_t x);
+void roinput_to_bytes(uint8_t *out, const ROInput *input);
+size_t roinput_to_fields(uint64_t *out, const ROInput *input);
+void roinput_add_transaction(ROInput *input, const Transaction *transaction);
+// The same straight from a transaction record, false if transaction_from_bytes
+// would reject it
+bool roinput_add_transaction_record(ROInput *input, const uint8_t in[TRANSACTION_BYTES]);
 
 bool scalar_from_hex(Scalar b, const char *hex);
 void scalar_from_words(Scalar b, const uint64_t words[4]);
@@ -117,12 +147,53 @@ void scalar_mul(Scalar c, const Scalar a, const Scalar b);
 void scalar_negate(Scalar b, const Scalar a);
 
 bool field_from_hex(Field b, const char *hex);
+char *field_to_hex(char *hex, const size_t len, const Field x);
+char *scalar_to_hex(char *hex, const size_t len, const Scalar x);
+
+// Canonical 32 byte little endian encodings, from_bytes rejects values
+// not below the modulus.  Signatures are rx then s.
+void field_to_bytes(uint8_t out[FIELD_BYTES], const Field a);
+bool field_from_bytes(Field a, const uint8_t in[FIELD_BYTES]);
+void scalar_to_bytes(uint8_t out[SCALAR_BYTES], const Scalar a);
+bool scalar_from_bytes(Scalar a, const uint8_t in[SCALAR_BYTES]);
+void signature_to_bytes(uint8_t out[SIGNATURE_BYTES], const Signature *sig);
+bool signature_from_bytes(Signature *sig, const uint8_t in[SIGNATURE_BYTES]);
+
+// Compressed keys are x then a parity byte, transactions the fixed little
+// endian record documented in minasigner.h.  from_bytes rejects anything
+// out of range, including nonzero padding.
+void compressed_to_bytes(uint8_t out[COMPRESSED_BYTES], const Compressed *pk);
+bool compressed_from_bytes(Compressed *pk, const uint8_t in[COMPRESSED_BYTES]);
+void transaction_to_bytes(uint8_t out[TRANSACTION_BYTES], const Transaction *t);
+bool transaction_from_bytes(Transaction *t, const uint8_t in[TRANSACTION_BYTES]);
+
+// 128 hex digits, rx then s, each a big endian number
+void signature_to_hex(char hex[2*SIGNATURE_BYTES + 1], const Signature *sig);
+bool signature_from_hex(Signature *sig, const char *hex);
 void field_copy(Field c, const Field a);
 bool field_is_odd(const Field y);
 void field_add(Field c, const Field a, const Field b);
+void field_sub(Field c, const Field a, const Field b);
 void field_mul(Field c, const Field a, const Field b);
 void field_sq(Field c, const Field a);
 void field_pow(Field c, const Field a, const uint8_t b);
+void field_inv(Field c, const Field a);
+void field_inv_batch(Field *c, const Field *a, const size_t n);
+void field_negate(Field c, const Field a);
+unsigned int field_eq(const Field a, const Field b);
+void field_sum_of_products(Field c, const Field *a, const Field *b, const size_t n);
+void field_mul_batch(Field *c, const Field *a, const Field *b, const size_t n);
+void field_sq_batch(Field *c, const Field *a, const size_t n);
+
+void group_dbl(Group *r, const Group *p);
+void group_add(Group *r, const Group *p, const Group *q);
+void group_madd(Group *r, const Group *p, const Group *q);
+void group_scalar_mul(Group *r, const Scalar k, const Group *p);
+void group_scalar_mul_coz(Group *r, const Scalar k, const Affine *p);
+void affine_to_group(Group *r, const Affine *p);
+void affine_from_group(Affine *r, const Group *p);
+void affine_from_group_batch(Affine *r, const Group *p, const size_t n);
+unsigned int affine_is_zero(const Affine *p);
 
 bool affine_eq(const Affine *p, const Affine *q);
 void affine_add(Affine *r, const Affine *p, const Affine *q);
@@ -134,6 +205,10 @@ void generate_keypair(Keypair *keypair, uint32_t account);
 void generate_pubkey(Affine *pub_key, const Scalar priv_key);
 bool generate_address(char *address, size_t len, const Affine *pub_key);
 
+void derive_init(DeriveCtx *ctx, const Keypair *kp, const uint8_t network_id);
+void derive_nonce(Scalar out, const DeriveCtx *ctx, const ROInput *msg);
+void derive_clear(DeriveCtx *ctx);
+
 void sign(Signature *sig, const Keypair *kp, const Transaction *transaction, const uint8_t network_id);
 bool verify(Signature *sig, const Compressed *pub, const Transaction *transaction, const uint8_t network_id);
 
@@ -141,4 +216,5 @@ void compress(Compressed *compressed, const Affine *pt);
 bool decompress(Affine *pt, const Compressed *compressed);
 
 void read_public_key_compressed(Compressed *out, const char *pubkeyBase58);
+size_t parse_addresses_batch(Compressed *out, AddressStatus *status, const char *const *addresses, const size_t n);
 void prepare_memo(uint8_t *out, const char *s);
\ No newline at end of file
@@ -0,0 +1,194 @@
+// Runtime backend dispatch
+//
+//     Every kernel is described by its backend names, a support check and
+//     the detected default.  Backend ids are indices into the name lists,
+//     which the static asserts below tie to the module constants.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dispatch.h"
+#include "pasta_sparse.h"
+#include "pasta_adx.h"
+#include "pasta_simd.h"
+#include "sha256_simd.h"
+#include "blake2b_simd.h"
+
+_Static_assert(PASTA_SIMD_GENERIC == 0 && PASTA_SIMD_AVX2 == 1 && PASTA_SIMD_IFMA == 2, "field_batch names");
+_Static_assert(SHA256_SIMD_GENERIC == 0 && SHA256_SIMD_SHANI == 1 && SHA256_SIMD_AVX2 == 2, "sha256 names");
+_Static_assert(BLAKE2B_SIMD_GENERIC == 0 && BLAKE2B_SIMD_AVX2 == 1, "blake2b names");
+
+// Portable until dispatch_init has run
+Dispatch dispatch = {
+    .field              = DISPATCH_FIELD_SPARSE,
+    .fp_mul             = pasta_fp_mul_sparse,
+    .fp_square          = pasta_fp_square_sparse,
+    .fp_sum_of_products = pasta_fp_sum_of_products_sparse,
+    .fq_mul             = pasta_fq_mul_sparse,
+    .fq_square          = pasta_fq_square_sparse,
+    .field_batch        = PASTA_SIMD_GENERIC,
+    .sha256             = SHA256_SIMD_GENERIC,
+    .blake2b            = BLAKE2B_SIMD_GENERIC,
+};
+
+static bool field_supported(const unsigned backend)
+{
+    return backend == DISPATCH_FIELD_SPARSE || (backend == DISPATCH_FIELD_ADX && pasta_adx_supported());
+}
+
+static unsigned field_detect(void)
+{
+    return pasta_adx_supported() ? DISPATCH_FIELD_ADX : DISPATCH_FIELD_SPARSE;
+}
+
+// SHA-NI is fastest for single messages and, two at a time, for many
+static unsigned sha256_detect(void)
+{
+    if (sha256_simd_supported(SHA256_SIMD_SHANI)) {
+        return SHA256_SIMD_SHANI;
+    }
+    if (sha256_simd_supported(SHA256_SIMD_AVX2)) {
+        return SHA256_SIMD_AVX2;
+    }
+    return SHA256_SIMD_GENERIC;
+}
+
+typedef struct dispatch_kernel_t {
+    const char *name;
+    const char *const *backends;
+    size_t count;
+    bool (*supported)(const unsigned backend);
+    unsigned (*detect)(void);
+    size_t offset; // of the backend id in Dispatch
+} DispatchKernel;
+
+static const char *const FIELD_NAMES[]       = { "sparse", "adx" };
+static const char *const FIELD_BATCH_NAMES[] = { "generic", "avx2", "ifma" };
+static const char *const SHA256_NAMES[]      = { "generic", "shani", "avx2" };
+static const char *const BLAKE2B_NAMES[]     = { "generic", "avx2" };
+
+#define KERNEL(name, names, supported, detect, field) \
+    { name, names, sizeof(names)/sizeof(names[0]), supported, detect, offsetof(Dispatch, field) }
+
+static const DispatchKernel KERNELS[] = {
+    KERNEL("field", FIELD_NAMES, field_supported, field_detect, field),
+    KERNEL("field_batch", FIELD_BATCH_NAMES, pasta_simd_supported, pasta_simd_backend, field_batch),
+    KERNEL("sha256", SHA256_NAMES, sha256_simd_supported, sha256_detect, sha256),
+    KERNEL("blake2b", BLAKE2B_NAMES, blake2b_simd_supported, blake2b_simd_backend, blake2b),
+};
+
+#define KERNEL_COUNT (sizeof(KERNELS)/sizeof(KERNELS[0]))
+
+static unsigned *backend_of(Dispatch *d, const DispatchKernel *k)
+{
+    return (unsigned *)((uint8_t *)d + k->offset);
+}
+
+// Whether s[0..len) is exactly name
+static bool token_is(const char *s, const size_t len, const char *name)
+{
+    return strlen(name) == len && memcmp(s, name, len) == 0;
+}
+
+static bool set_kernel(Dispatch *d, const char *key, const size_t key_len, const char *value, const size_t value_len)
+{
+    if (token_is(key, key_len, "all")) {
+        for (size_t i = 0; i < KERNEL_COUNT; i++) {
+            if (token_is(value, value_len, "generic")) {
+                *backend_of(d, &KERNELS[i]) = 0;
+            }
+            else if (token_is(value, value_len, "auto")) {
+                *backend_of(d, &KERNELS[i]) = KERNELS[i].detect();
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        const DispatchKernel *k = &KERNELS[i];
+        if (!token_is(key, key_len, k->name)) {
+            continue;
+        }
+        if (token_is(value, value_len, "auto")) {
+            *backend_of(d, k) = k->detect();
+            return true;
+        }
+        for (unsigned backend = 0; backend < k->count; backend++) {
+            if (token_is(value, value_len, k->backends[backend])) {
+                if (!k->supported(backend)) {
+                    return false;
+                }
+                *backend_of(d, k) = backend;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    return false;
+}
+
+bool dispatch_configure(const char *spec)
+{
+    Dispatch d;
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        *backend_of(&d, &KERNELS[i]) = KERNELS[i].detect();
+    }
+
+    for (const char *s = spec; s && *s; ) {
+        const char *end = strchr(s, ',');
+        const size_t len = end ? (size_t)(end - s) : strlen(s);
+        const char *eq = memchr(s, '=', len);
+        if (!eq || !set_kernel(&d, s, eq - s, eq + 1, len - (eq + 1 - s))) {
+            return false;
+        }
+        s = end ? end + 1 : s + len;
+    }
+
+    if (d.field == DISPATCH_FIELD_ADX) {
+        d.fp_mul             = pasta_fp_mul_adx;
+        d.fp_square          = pasta_fp_square_adx;
+        d.fp_sum_of_products = pasta_fp_sum_of_products_adx;
+        d.fq_mul             = pasta_fq_mul_adx;
+        d.fq_square          = pasta_fq_square_adx;
+    }
+    else {
+        d.fp_mul             = pasta_fp_mul_sparse;
+        d.fp_square          = pasta_fp_square_sparse;
+        d.fp_sum_of_products = pasta_fp_sum_of_products_sparse;
+        d.fq_mul             = pasta_fq_mul_sparse;
+        d.fq_square          = pasta_fq_square_sparse;
+    }
+
+    dispatch = d;
+    return true;
+}
+
+void dispatch_describe(char *out, const size_t len)
+{
+    size_t used = 0;
+    out[0] = '\0';
+    for (size_t i = 0; i < KERNEL_COUNT && used < len; i++) {
+        const DispatchKernel *k = &KERNELS[i];
+        const int n = snprintf(out + used, len - used, "%s%s=%s", i ? "," : "",
+                               k->name, k->backends[*backend_of(&dispatch, k)]);
+        if (n < 0) {
+            break;
+        }
+        used += n;
+    }
+}
+
+__attribute__((constructor))
+static void dispatch_init(void)
+{
+    const char *spec = getenv(DISPATCH_ENV);
+    if (!dispatch_configure(spec)) {
+        fprintf(stderr, "%s: ignoring invalid or unsupported \"%s\"\n", DISPATCH_ENV, spec);
+        dispatch_configure(NULL);
+    }
+}
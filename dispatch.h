@@ -0,0 +1,53 @@
+// Runtime backend dispatch
+//
+//     One table holds the kernels the library calls for field arithmetic
+//     and the backends it passes to the SHA-256, BLAKE2b and batched field
+//     _with functions.  It starts out portable and is filled in from the
+//     CPU features before main() runs.
+//
+//     The MINA_SIGNER_DISPATCH environment variable overrides the choice,
+//     for testing and benchmarking, as comma separated kernel=backend pairs:
+//
+//         field        sparse, adx      single field and scalar multiplication
+//         field_batch  generic, avx2, ifma
+//         sha256       generic, shani, avx2
+//         blake2b      generic, avx2
+//         all          generic          every kernel portable
+//
+//     e.g. MINA_SIGNER_DISPATCH=field=sparse,sha256=avx2.  Any kernel may
+//     also be set to auto.  Backends the CPU lacks are refused, leaving the
+//     detected choice in place.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define DISPATCH_ENV "MINA_SIGNER_DISPATCH"
+
+#define DISPATCH_FIELD_SPARSE 0 // portable C for the sparse moduli
+#define DISPATCH_FIELD_ADX    1 // MULX/ADCX/ADOX, needs BMI2 and ADX
+
+typedef struct dispatch_t {
+    unsigned field;       // DISPATCH_FIELD_*
+    void (*fp_mul)(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4]);
+    void (*fp_square)(uint64_t out1[4], const uint64_t arg1[4]);
+    void (*fp_sum_of_products)(uint64_t out1[4], const uint64_t arg1[][4], const uint64_t arg2[][4], const size_t n);
+    void (*fq_mul)(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4]);
+    void (*fq_square)(uint64_t out1[4], const uint64_t arg1[4]);
+    unsigned field_batch; // PASTA_SIMD_*
+    unsigned sha256;      // SHA256_SIMD_*, single messages only use SHANI
+    unsigned blake2b;     // BLAKE2B_SIMD_*
+} Dispatch;
+
+extern Dispatch dispatch;
+
+// Applies a MINA_SIGNER_DISPATCH style spec on top of the detected
+// backends.  NULL or "" is the detected choice.  Returns false, and leaves
+// the table unchanged, on a syntax error or an unsupported backend.  Not
+// thread safe: call it while no other thread is using the library.
+bool dispatch_configure(const char *spec);
+
+// Writes the current choice, e.g. "field=adx,field_batch=ifma,...", to out
+void dispatch_describe(char *out, const size_t len);
@@ -0,0 +1,781 @@
+// Differential fuzzing of the optimized primitives
+//
+//     Every optimized primitive is checked against a reference on inputs
+//     decoded from the fuzz data: field and scalar multiplication and
+//     squaring (sparse, ADX and every batch backend against fiat-crypto),
+//     inversion, square roots, group scalar multiplication and MSM (against
+//     double-and-add), Poseidon (against a fiat-crypto permutation), the
+//     SHA-256 and BLAKE2b backends, base58 addresses (against libbase58),
+//     base 10, hex and byte codecs (round trips), and sign/verify.  Field
+//     operands are picked from a table of edge cases (0, 1, p - 1, ...) by
+//     their first byte, or read as random values.  Any mismatch aborts.
+//
+//     Randomized loop, no extra tools needed:
+//
+//         make fuzz [FUZZ_ARGS="<iterations> <seed>"]
+//
+//     libFuzzer, with the library sources instead of the objects (one line):
+//
+//         clang -g -O1 -fsanitize=fuzzer,address -D FUZZ_LIBFUZZER -D OSX
+//             fuzz_diff.c base10.c base58_address.c base58.c blake2b-ref.c
+//             blake2b_simd.c sha256.c sha256_simd.c crypto.c pasta_fp.c
+//             pasta_fq.c poseidon.c utils.c curve_checks.c cpu.c dispatch.c
+//             pasta_simd.c pasta_adx.c pasta_sparse.c msm.c keygen.c vanity.c
+//             op_counters.c signer_context.c -lm -pthread -o fuzz_diff
+//             && ./fuzz_diff
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crypto.h"
+#include "pasta_fp.h"
+#include "pasta_fq.h"
+#include "pasta_sparse.h"
+#include "pasta_adx.h"
+#include "pasta_simd.h"
+#include "poseidon.h"
+#include "msm.h"
+#include "sha256.h"
+#include "sha256_simd.h"
+#include "blake2.h"
+#include "blake2b_simd.h"
+#include "libbase58.h"
+#include "base58_address.h"
+#include "base10.h"
+#include "utils.h"
+
+#define FUZZ_BATCH 9 // odd, so every batch backend has a partial last vector
+
+static const uint64_t FP_MODULUS[4] = {
+    0x992d30ed00000001, 0x224698fc094cf91b, 0x0000000000000000, 0x4000000000000000
+};
+static const uint64_t FQ_MODULUS[4] = {
+    0x8c46eb2100000001, 0x224698fc0994a8dd, 0x0000000000000000, 0x4000000000000000
+};
+
+typedef struct fuzz_input_t {
+    const uint8_t *data;
+    size_t size;
+} FuzzInput;
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: mismatch: %s\n", __FILE__, __LINE__, #cond); \
+            abort();                                                            \
+        }                                                                       \
+    } while (0)
+
+// Reads past the end of the data are zeros
+static uint8_t fuzz_u8(FuzzInput *in)
+{
+    if (in->size == 0) {
+        return 0;
+    }
+    in->size--;
+    return *in->data++;
+}
+
+static uint64_t fuzz_u64(FuzzInput *in)
+{
+    uint64_t x = 0;
+    for (size_t i = 0; i < 8; i++) {
+        x |= (uint64_t)fuzz_u8(in) << 8*i;
+    }
+    return x;
+}
+
+static void fuzz_bytes(FuzzInput *in, uint8_t *out, const size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        out[i] = fuzz_u8(in);
+    }
+}
+
+static bool words_less(const uint64_t a[4], const uint64_t b[4])
+{
+    for (size_t w = 4; w-- > 0; ) {
+        if (a[w] != b[w]) {
+            return a[w] < b[w];
+        }
+    }
+    return false;
+}
+
+static void words_sub(uint64_t c[4], const uint64_t a[4], const uint64_t b[4])
+{
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < 4; i++) {
+        const uint64_t d = a[i] - b[i] - borrow;
+        borrow = (a[i] < b[i]) || (a[i] - b[i] < borrow);
+        c[i] = d;
+    }
+}
+
+// A canonical integer below m: an edge case picked by the first byte, or
+// 32 more bytes reduced below 2^254 (< 2m) and then below m
+static void fuzz_integer(FuzzInput *in, uint64_t x[4], const uint64_t m[4])
+{
+    static const uint64_t ONE[4] = { 1, 0, 0, 0 };
+    static const uint64_t TWO[4] = { 2, 0, 0, 0 };
+
+    const uint8_t pick = fuzz_u8(in);
+    memset(x, 0, 4*sizeof(uint64_t));
+    switch (pick) {
+        case 0: break;
+        case 1: x[0] = 1; break;
+        case 2: x[0] = 2; break;
+        case 3: words_sub(x, m, ONE); break;
+        case 4: words_sub(x, m, TWO); break;
+        case 5: // (m - 1)/2 and (m + 1)/2
+        case 6:
+            words_sub(x, m, ONE);
+            for (size_t i = 0; i < 4; i++) {
+                x[i] = (x[i] >> 1) | (i < 3 ? x[i + 1] << 63 : 0);
+            }
+            x[0] += pick - 5;
+            break;
+        case 7: x[0] = UINT64_MAX; break;
+        case 8: x[0] = x[1] = UINT64_MAX; break;
+        case 9: x[0] = x[1] = x[2] = UINT64_MAX; break;
+        case 10: x[3] = (uint64_t)1 << 61; break;
+        case 11: x[1] = 1; words_sub(x, m, x); break; // m - 2^64
+        default:
+            for (size_t i = 0; i < 4; i++) {
+                x[i] = fuzz_u64(in);
+            }
+            x[3] &= ((uint64_t)1 << 62) - 1;
+            if (!words_less(x, m)) {
+                words_sub(x, x, m);
+            }
+    }
+}
+
+static void fuzz_field(FuzzInput *in, Field x)
+{
+    uint64_t t[4];
+    fuzz_integer(in, t, FP_MODULUS);
+    fiat_pasta_fp_to_montgomery(x, t);
+}
+
+static void fuzz_scalar(FuzzInput *in, Scalar x)
+{
+    uint64_t t[4];
+    fuzz_integer(in, t, FQ_MODULUS);
+    fiat_pasta_fq_to_montgomery(x, t);
+}
+
+static bool words_eq(const uint64_t a[4], const uint64_t b[4])
+{
+    return memcmp(a, b, 4*sizeof(uint64_t)) == 0;
+}
+
+// Field and scalar arithmetic
+
+typedef void (*MulFn)(uint64_t[4], const uint64_t[4], const uint64_t[4]);
+typedef void (*SqFn)(uint64_t[4], const uint64_t[4]);
+typedef void (*MulBatchWithFn)(const unsigned, uint64_t[][4], const uint64_t[][4], const uint64_t[][4], const size_t);
+typedef void (*SumOfProductsFn)(uint64_t[4], const uint64_t[][4], const uint64_t[][4], const size_t);
+
+typedef struct fuzz_field_ops_t {
+    const uint64_t *modulus;
+    SqFn to_montgomery;
+    MulFn ref_mul;
+    SqFn ref_sq;
+    void (*ref_add)(uint64_t[4], const uint64_t[4], const uint64_t[4]);
+    MulFn mul;           // crypto.c's dispatched multiplication
+    MulFn mul_sparse;
+    SqFn sq_sparse;
+    MulFn mul_adx;
+    SqFn sq_adx;
+    SumOfProductsFn sum_of_products_sparse;
+    SumOfProductsFn sum_of_products_adx;
+    MulBatchWithFn mul_batch_with;
+} FuzzFieldOps;
+
+static const FuzzFieldOps FP_OPS = {
+    FP_MODULUS, fiat_pasta_fp_to_montgomery, fiat_pasta_fp_mul, fiat_pasta_fp_square, fiat_pasta_fp_add,
+    field_mul, pasta_fp_mul_sparse, pasta_fp_square_sparse,
+    pasta_fp_mul_adx, pasta_fp_square_adx,
+    pasta_fp_sum_of_products_sparse, pasta_fp_sum_of_products_adx,
+    pasta_fp_mul_batch_with
+};
+
+static const FuzzFieldOps FQ_OPS = {
+    FQ_MODULUS, fiat_pasta_fq_to_montgomery, fiat_pasta_fq_mul, fiat_pasta_fq_square, fiat_pasta_fq_add,
+    scalar_mul, pasta_fq_mul_sparse, pasta_fq_square_sparse,
+    pasta_fq_mul_adx, pasta_fq_square_adx,
+    pasta_fq_sum_of_products_sparse, pasta_fq_sum_of_products_adx,
+    pasta_fq_mul_batch_with
+};
+
+static void fuzz_mul(FuzzInput *in, const FuzzFieldOps *ops)
+{
+    uint64_t a[FUZZ_BATCH][4], b[FUZZ_BATCH][4], expected[FUZZ_BATCH][4], out[FUZZ_BATCH][4];
+    for (size_t i = 0; i < FUZZ_BATCH; i++) {
+        uint64_t t[4];
+        fuzz_integer(in, t, ops->modulus);
+        ops->to_montgomery(a[i], t);
+        fuzz_integer(in, t, ops->modulus);
+        ops->to_montgomery(b[i], t);
+        ops->ref_mul(expected[i], a[i], b[i]);
+    }
+
+    const bool adx = pasta_adx_supported();
+    for (size_t i = 0; i < FUZZ_BATCH; i++) {
+        uint64_t c[4], sq[4];
+        ops->mul(c, a[i], b[i]);
+        CHECK(words_eq(c, expected[i]));
+        ops->mul_sparse(c, a[i], b[i]);
+        CHECK(words_eq(c, expected[i]));
+        ops->ref_sq(sq, a[i]);
+        ops->sq_sparse(c, a[i]);
+        CHECK(words_eq(c, sq));
+        if (adx) {
+            ops->mul_adx(c, a[i], b[i]);
+            CHECK(words_eq(c, expected[i]));
+            ops->sq_adx(c, a[i]);
+            CHECK(words_eq(c, sq));
+        }
+    }
+
+    for (unsigned backend = PASTA_SIMD_GENERIC; backend <= PASTA_SIMD_IFMA; backend++) {
+        if (pasta_simd_supported(backend)) {
+            ops->mul_batch_with(backend, out, a, b, FUZZ_BATCH);
+            CHECK(memcmp(out, expected, sizeof(out)) == 0);
+        }
+    }
+
+    // Inner products of up to PASTA_SUM_OF_PRODUCTS_MAX terms
+    for (size_t n = 1; n <= PASTA_SUM_OF_PRODUCTS_MAX; n++) {
+        uint64_t sum[4], c[4];
+        memcpy(sum, expected[0], sizeof(sum));
+        for (size_t i = 1; i < n; i++) {
+            ops->ref_add(sum, sum, expected[i]);
+        }
+        ops->sum_of_products_sparse(c, (const uint64_t (*)[4])a, (const uint64_t (*)[4])b, n);
+        CHECK(words_eq(c, sum));
+        if (adx) {
+            ops->sum_of_products_adx(c, (const uint64_t (*)[4])a, (const uint64_t (*)[4])b, n);
+            CHECK(words_eq(c, sum));
+        }
+    }
+}
+
+static void fuzz_field_batch_ops(FuzzInput *in)
+{
+    Field a[FUZZ_BATCH], b[FUZZ_BATCH], expected[FUZZ_BATCH], out[FUZZ_BATCH];
+    bool nonzero = true;
+    for (size_t i = 0; i < FUZZ_BATCH; i++) {
+        fuzz_field(in, a[i]);
+        fuzz_field(in, b[i]);
+        nonzero = nonzero && !words_eq(a[i], (const uint64_t[4]){ 0, 0, 0, 0 });
+    }
+
+    field_sq_batch(out, a, FUZZ_BATCH);
+    for (size_t i = 0; i < FUZZ_BATCH; i++) {
+        fiat_pasta_fp_square(expected[i], a[i]);
+        CHECK(words_eq(out[i], expected[i]));
+    }
+
+    Field sum, c;
+    fiat_pasta_fp_mul(sum, a[0], b[0]);
+    for (size_t i = 1; i < FUZZ_BATCH; i++) {
+        fiat_pasta_fp_mul(c, a[i], b[i]);
+        fiat_pasta_fp_add(sum, sum, c);
+    }
+    field_sum_of_products(c, a, b, FUZZ_BATCH);
+    CHECK(words_eq(c, sum));
+
+    // Montgomery's batch inversion against one at a time
+    if (nonzero) {
+        field_inv_batch(out, a, FUZZ_BATCH);
+        for (size_t i = 0; i < FUZZ_BATCH; i++) {
+            fiat_pasta_fp_inv(expected[i], a[i]);
+            CHECK(words_eq(out[i], expected[i]));
+            fiat_pasta_fp_mul(c, out[i], a[i]);
+            CHECK(fiat_pasta_fp_equals_one(c));
+        }
+    }
+}
+
+static void fuzz_sqrt(FuzzInput *in)
+{
+    Field x, y, y2;
+    fuzz_field(in, x);
+    if (fiat_pasta_fp_sqrt(y, x)) {
+        fiat_pasta_fp_square(y2, y);
+        CHECK(words_eq(y2, x));
+    }
+    else {
+        // 5 generates the multiplicative group, so 5x is a square
+        Field five, x5;
+        fiat_pasta_fp_to_montgomery(five, (const uint64_t[4]){ 5, 0, 0, 0 });
+        fiat_pasta_fp_mul(x5, x, five);
+        CHECK(fiat_pasta_fp_sqrt(y, x5));
+        fiat_pasta_fp_square(y2, y);
+        CHECK(words_eq(y2, x5));
+    }
+
+    // Squares always have roots
+    fiat_pasta_fp_square(y2, x);
+    CHECK(fiat_pasta_fp_sqrt(y, y2));
+    fiat_pasta_fp_square(x, y);
+    CHECK(words_eq(x, y2));
+}
+
+// Group operations
+
+// Most significant bit first double-and-add, the textbook reference
+static void group_scalar_mul_ref(Group *r, const Scalar k, const Group *p)
+{
+    uint64_t bits[4];
+    fiat_pasta_fq_from_montgomery(bits, k);
+
+    Group acc = { { 0 }, { 0 }, { 0 } }, tmp;
+    for (size_t i = 256; i-- > 0; ) {
+        group_dbl(&tmp, &acc);
+        acc = tmp;
+        if ((bits[i / 64] >> (i % 64)) & 1) {
+            group_add(&tmp, &acc, p);
+            acc = tmp;
+        }
+    }
+    *r = acc;
+}
+
+static void fuzz_point(FuzzInput *in, Affine *p)
+{
+    Scalar k;
+    fuzz_scalar(in, k);
+    generate_pubkey(p, k);
+}
+
+static void fuzz_group_scalar_mul(FuzzInput *in)
+{
+    Affine p, r_affine, expected_affine;
+    Scalar k;
+    fuzz_point(in, &p);
+    fuzz_scalar(in, k);
+
+    Group gp, r, expected;
+    affine_to_group(&gp, &p);
+    group_scalar_mul_ref(&expected, k, &gp);
+    affine_from_group(&expected_affine, &expected);
+
+    group_scalar_mul(&r, k, &gp);
+    affine_from_group(&r_affine, &r);
+    CHECK(affine_eq(&r_affine, &expected_affine));
+
+    group_scalar_mul_coz(&r, k, &p);
+    affine_from_group(&r_affine, &r);
+    CHECK(affine_eq(&r_affine, &expected_affine));
+
+    affine_scalar_mul(&r_affine, k, &p);
+    CHECK(affine_eq(&r_affine, &expected_affine));
+
+    // A non-normalized input point takes the general addition path
+    Group gp2;
+    group_dbl(&gp2, &gp);
+    group_scalar_mul(&r, k, &gp2);
+    group_scalar_mul_ref(&expected, k, &gp2);
+    affine_from_group(&r_affine, &r);
+    affine_from_group(&expected_affine, &expected);
+    CHECK(affine_eq(&r_affine, &expected_affine));
+}
+
+#define FUZZ_MSM_MAX 8
+
+static void fuzz_msm(FuzzInput *in)
+{
+    Affine p[FUZZ_MSM_MAX];
+    Scalar k[FUZZ_MSM_MAX];
+    const size_t n = 1 + fuzz_u8(in) % FUZZ_MSM_MAX;
+    for (size_t i = 0; i < n; i++) {
+        // Repeated points exercise the doubling cases of the buckets
+        if (i > 0 && fuzz_u8(in) % 4 == 0) {
+            p[i] = p[i - 1];
+        }
+        else {
+            fuzz_point(in, &p[i]);
+        }
+        fuzz_scalar(in, k[i]);
+    }
+
+    Group expected = { { 0 }, { 0 }, { 0 } }, term, tmp, r;
+    for (size_t i = 0; i < n; i++) {
+        Group gp;
+        affine_to_group(&gp, &p[i]);
+        group_scalar_mul_ref(&term, k[i], &gp);
+        group_add(&tmp, &expected, &term);
+        expected = tmp;
+    }
+    Affine expected_affine, r_affine;
+    affine_from_group(&expected_affine, &expected);
+
+    group_msm(&r, k, p, n);
+    affine_from_group(&r_affine, &r);
+    CHECK(affine_eq(&r_affine, &expected_affine));
+
+    group_msm_threads(&r, k, p, n, 2);
+    affine_from_group(&r_affine, &r);
+    CHECK(affine_eq(&r_affine, &expected_affine));
+}
+
+// Poseidon
+
+#define ROUND_KEY(ctx, round, idx) ((const uint64_t *)(ctx)->round_keys + ((round)*(ctx)->sponge_width + (idx))*LIMBS_PER_FIELD)
+#define MATRIX_ELT(ctx, row, col) ((const uint64_t *)(ctx)->mds_matrix + ((row)*(ctx)->sponge_width + (col))*LIMBS_PER_FIELD)
+
+static void ref_ark(PoseidonCtx *ctx, const size_t round)
+{
+    for (size_t i = 0; i < ctx->sponge_width; i++) {
+        fiat_pasta_fp_add(ctx->state[i], ctx->state[i], ROUND_KEY(ctx, round, i));
+    }
+}
+
+// x^alpha as alpha - 1 multiplications, and the MDS matrix row by row
+static void ref_sbox_mds(PoseidonCtx *ctx)
+{
+    for (size_t i = 0; i < ctx->sponge_width; i++) {
+        Field x;
+        fiat_pasta_fp_copy(x, ctx->state[i]);
+        for (size_t j = 1; j < ctx->sbox_alpha; j++) {
+            fiat_pasta_fp_mul(ctx->state[i], ctx->state[i], x);
+        }
+    }
+
+    State s;
+    for (size_t row = 0; row < ctx->sponge_width; row++) {
+        memset(s[row], 0, sizeof(Field));
+        for (size_t col = 0; col < ctx->sponge_width; col++) {
+            Field t;
+            fiat_pasta_fp_mul(t, MATRIX_ELT(ctx, row, col), ctx->state[col]);
+            fiat_pasta_fp_add(s[row], s[row], t);
+        }
+    }
+    memcpy(ctx->state, s, ctx->sponge_width*sizeof(Field));
+}
+
+static void ref_permutation(PoseidonCtx *ctx, const uint8_t type)
+{
+    for (size_t r = 0; r < ctx->full_rounds; r++) {
+        if (type == POSEIDON_LEGACY) {
+            ref_ark(ctx, r);
+        }
+        ref_sbox_mds(ctx);
+        if (type == POSEIDON_KIMCHI) {
+            ref_ark(ctx, r);
+        }
+    }
+    if (type == POSEIDON_LEGACY) {
+        ref_ark(ctx, ctx->full_rounds);
+    }
+}
+
+// poseidon_init only for the parameters and the IV, the sponge is redone here
+static void ref_poseidon(Scalar out, const uint8_t type, const uint8_t network_id, const Field *input, const size_t len)
+{
+    PoseidonCtx ctx;
+    CHECK(poseidon_init(&ctx, type, network_id));
+    size_t absorbed = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (absorbed == ctx.sponge_rate) {
+            ref_permutation(&ctx, type);
+            absorbed = 0;
+        }
+        fiat_pasta_fp_add(ctx.state[absorbed], ctx.state[absorbed], input[i]);
+        absorbed++;
+    }
+    ref_permutation(&ctx, type);
+
+    uint64_t t[4];
+    fiat_pasta_fp_from_montgomery(t, ctx.state[0]);
+    fiat_pasta_fq_to_montgomery(out, t);
+}
+
+#define FUZZ_POSEIDON_LEN 6
+#define FUZZ_POSEIDON_N   3
+
+static void fuzz_poseidon(FuzzInput *in)
+{
+    static const uint8_t networks[3] = { TESTNET_ID, MAINNET_ID, NULLNET_ID };
+    const uint8_t type = fuzz_u8(in) % 2;
+    const uint8_t network_id = networks[fuzz_u8(in) % 3];
+    const size_t len = fuzz_u8(in) % (FUZZ_POSEIDON_LEN + 1);
+
+    Field inputs[FUZZ_POSEIDON_N][FUZZ_POSEIDON_LEN];
+    for (size_t i = 0; i < FUZZ_POSEIDON_N; i++) {
+        for (size_t j = 0; j < len; j++) {
+            fuzz_field(in, inputs[i][j]);
+        }
+    }
+
+    Scalar expected[FUZZ_POSEIDON_N], out[FUZZ_POSEIDON_N];
+    for (size_t i = 0; i < FUZZ_POSEIDON_N; i++) {
+        ref_poseidon(expected[i], type, network_id, inputs[i], len);
+
+        PoseidonCtx ctx;
+        CHECK(poseidon_init(&ctx, type, network_id));
+        poseidon_update(&ctx, inputs[i], len);
+        poseidon_digest(out[i], &ctx);
+        CHECK(words_eq(out[i], expected[i]));
+    }
+
+    // The batch takes the inputs back to back
+    Field packed[FUZZ_POSEIDON_N*FUZZ_POSEIDON_LEN];
+    for (size_t i = 0; i < FUZZ_POSEIDON_N; i++) {
+        memcpy(packed[i*len], inputs[i], len*sizeof(Field));
+    }
+    CHECK(poseidon_hash_batch(out, type, network_id, packed, len, FUZZ_POSEIDON_N));
+    CHECK(memcmp(out, expected, sizeof(out)) == 0);
+}
+
+// Hashes and encodings
+
+static void fuzz_hashes(FuzzInput *in)
+{
+    static uint8_t msg[SHA256_LANES + 1][300];
+    const size_t len = (fuzz_u8(in) | (size_t)fuzz_u8(in) << 8) % sizeof(msg[0]);
+    for (size_t i = 0; i < SHA256_LANES + 1; i++) {
+        fuzz_bytes(in, msg[i], len);
+    }
+
+    uint8_t expected[SHA256_LANES + 1][SHA256_BLOCK_SIZE], out[SHA256_LANES + 1][SHA256_BLOCK_SIZE];
+    for (size_t i = 0; i < SHA256_LANES + 1; i++) {
+        sha256_hash_with(SHA256_SIMD_GENERIC, msg[i], len, expected[i]);
+    }
+    for (unsigned backend = SHA256_SIMD_GENERIC; backend <= SHA256_SIMD_AVX2; backend++) {
+        if (!sha256_simd_supported(backend)) {
+            continue;
+        }
+        sha256_hash_with(backend, msg[0], len, out[0]);
+        CHECK(memcmp(out[0], expected[0], SHA256_BLOCK_SIZE) == 0);
+        sha256_hash_many_with(backend, msg, sizeof(msg[0]), len, out, SHA256_LANES + 1);
+        CHECK(memcmp(out, expected, sizeof(out)) == 0);
+    }
+
+    // BLAKE2b, keyed by the first bytes of the last message
+    const size_t keylen = fuzz_u8(in) % (BLAKE2B_KEYBYTES + 1);
+    const size_t outlen = 1 + fuzz_u8(in) % BLAKE2B_OUTBYTES;
+    uint8_t b2_expected[BLAKE2B_LANES + 1][BLAKE2B_OUTBYTES], b2_out[BLAKE2B_LANES + 1][BLAKE2B_OUTBYTES];
+    const void *ins[BLAKE2B_LANES + 1];
+    size_t inlens[BLAKE2B_LANES + 1];
+    for (size_t i = 0; i < BLAKE2B_LANES + 1; i++) {
+        ins[i] = msg[i];
+        inlens[i] = (len + 37*i) % sizeof(msg[0]);
+        CHECK(blake2b_with(BLAKE2B_SIMD_GENERIC, b2_expected[i], outlen, msg[i], inlens[i], NULL, 0) == 0);
+    }
+    uint8_t keyed[BLAKE2B_OUTBYTES];
+    CHECK(blake2b_with(BLAKE2B_SIMD_GENERIC, keyed, outlen, msg[0], len, msg[SHA256_LANES], keylen) == 0);
+    for (unsigned backend = BLAKE2B_SIMD_GENERIC; backend <= BLAKE2B_SIMD_AVX2; backend++) {
+        if (!blake2b_simd_supported(backend)) {
+            continue;
+        }
+        CHECK(blake2b_with(backend, b2_out[0], outlen, msg[0], len, msg[SHA256_LANES], keylen) == 0);
+        CHECK(memcmp(b2_out[0], keyed, outlen) == 0);
+        CHECK(blake2b_many_with(backend, b2_out, outlen, ins, inlens, BLAKE2B_LANES + 1) == 0);
+        for (size_t i = 0; i < BLAKE2B_LANES + 1; i++) {
+            CHECK(memcmp((uint8_t *)b2_out + i*outlen, b2_expected[i], outlen) == 0);
+        }
+    }
+}
+
+static void fuzz_base58(FuzzInput *in)
+{
+    uint8_t bin[B58_ADDRESS_BYTES], decoded[B58_ADDRESS_BYTES];
+    char b58[B58_ADDRESS_DIGITS + 1], expected[B58_ADDRESS_DIGITS + 16];
+    fuzz_bytes(in, bin, sizeof(bin));
+
+    size_t len = sizeof(expected);
+    CHECK(b58enc(expected, &len, bin, sizeof(bin)));
+    const bool ok = b58enc_address(b58, bin);
+    CHECK(ok == (len == B58_ADDRESS_DIGITS + 1 && expected[0] != '1'));
+    if (ok) {
+        CHECK(strcmp(b58, expected) == 0);
+        CHECK(b58tobin_address(decoded, b58));
+        CHECK(memcmp(decoded, bin, sizeof(bin)) == 0);
+    }
+
+    // Arbitrary characters, mostly digits
+    static const char digits[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    for (size_t i = 0; i < B58_ADDRESS_DIGITS; i++) {
+        const uint8_t c = fuzz_u8(in);
+        b58[i] = c < 240 ? digits[c % 58] : (char)(c == 255 ? '0' : c);
+    }
+    b58[B58_ADDRESS_DIGITS] = '\0';
+    len = sizeof(decoded);
+    memset(decoded, 0, sizeof(decoded));
+    const bool expected_ok = strlen(b58) == B58_ADDRESS_DIGITS && b58tobin(decoded, &len, b58, B58_ADDRESS_DIGITS);
+    CHECK(b58tobin_address(bin, b58) == expected_ok);
+    if (expected_ok) {
+        CHECK(memcmp(bin, decoded, sizeof(bin)) == 0);
+    }
+}
+
+static void fuzz_codecs(FuzzInput *in)
+{
+    uint64_t x[4], y[4];
+    char dec[DIGITS + 1];
+    for (size_t i = 0; i < 4; i++) {
+        x[i] = fuzz_u64(in) >> (fuzz_u8(in) % 64);
+    }
+    const size_t len = bigint_to_string(dec, x);
+    CHECK(len == strlen(dec) && (len == 1 || dec[0] != '0'));
+    CHECK(bigint_from_string(y, dec));
+    CHECK(words_eq(x, y));
+
+    Field f, g;
+    Scalar s, t;
+    uint8_t bytes[FIELD_BYTES];
+    char hex[2*FIELD_BYTES + 1];
+    fuzz_field(in, f);
+    field_to_bytes(bytes, f);
+    CHECK(field_from_bytes(g, bytes));
+    CHECK(words_eq(f, g));
+    // The hex parsers only take values below 2^254, as they always have
+    field_to_hex(hex, sizeof(hex), f);
+    CHECK(field_from_hex(g, hex) == !(bytes[FIELD_BYTES - 1] & 0xc0));
+    if (!(bytes[FIELD_BYTES - 1] & 0xc0)) {
+        CHECK(words_eq(f, g));
+    }
+    fuzz_scalar(in, s);
+    scalar_to_bytes(bytes, s);
+    CHECK(scalar_from_bytes(t, bytes));
+    CHECK(words_eq(s, t));
+
+    // Arbitrary bytes are accepted exactly when below the modulus
+    fuzz_bytes(in, bytes, sizeof(bytes));
+    uint64_t w[4];
+    memset(w, 0, sizeof(w));
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        w[i / 8] |= (uint64_t)bytes[i] << 8*(i % 8);
+    }
+    CHECK(field_from_bytes(g, bytes) == words_less(w, FP_MODULUS));
+    CHECK(scalar_from_bytes(t, bytes) == words_less(w, FQ_MODULUS));
+}
+
+// Signer
+
+static void fuzz_sign(FuzzInput *in)
+{
+    Keypair kp;
+    fuzz_scalar(in, kp.priv);
+    if (words_eq(kp.priv, (const uint64_t[4]){ 0, 0, 0, 0 })) {
+        return;
+    }
+    generate_pubkey(&kp.pub, kp.priv);
+
+    Transaction txn;
+    memset(&txn, 0, sizeof(txn));
+    compress(&txn.fee_payer_pk, &kp.pub);
+    txn.source_pk = txn.fee_payer_pk;
+    Affine receiver;
+    fuzz_point(in, &receiver);
+    compress(&txn.receiver_pk, &receiver);
+    txn.fee = fuzz_u64(in);
+    txn.fee_token = 1;
+    txn.token_id = 1;
+    txn.nonce = (Nonce)fuzz_u64(in);
+    txn.valid_until = (GlobalSlot)fuzz_u64(in);
+    txn.amount = fuzz_u64(in);
+    txn.tag[2] = fuzz_u8(in) & 1;
+    fuzz_bytes(in, txn.memo, sizeof(txn.memo));
+    const uint8_t network_id = fuzz_u8(in) & 1 ? MAINNET_ID : TESTNET_ID;
+
+    Signature sig, decoded;
+    Compressed pub;
+    compress(&pub, &kp.pub);
+    sign(&sig, &kp, &txn, network_id);
+    CHECK(verify(&sig, &pub, &txn, network_id));
+
+    char hex[2*SIGNATURE_BYTES + 1];
+    signature_to_hex(hex, &sig);
+    CHECK(signature_from_hex(&decoded, hex));
+    CHECK(words_eq(decoded.rx, sig.rx) && words_eq(decoded.s, sig.s));
+
+    // Any change to the payload, network or signature fails
+    txn.amount ^= 1;
+    CHECK(!verify(&sig, &pub, &txn, network_id));
+    txn.amount ^= 1;
+    CHECK(!verify(&sig, &pub, &txn, network_id ^ 1));
+    fiat_pasta_fq_add(decoded.s, sig.s, sig.s);
+    CHECK(!verify(&decoded, &pub, &txn, network_id));
+}
+
+static void (*const _fuzz_targets[])(FuzzInput *) = {
+    NULL, // Fp multiplication, see below
+    NULL, // Fq multiplication
+    fuzz_field_batch_ops,
+    fuzz_sqrt,
+    fuzz_group_scalar_mul,
+    fuzz_msm,
+    fuzz_poseidon,
+    fuzz_hashes,
+    fuzz_base58,
+    fuzz_codecs,
+    fuzz_sign,
+};
+
+#define FUZZ_TARGETS (sizeof(_fuzz_targets)/sizeof(_fuzz_targets[0]))
+
+// The first byte picks the primitive, the rest are its inputs
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    FuzzInput in = { data, size };
+    const size_t target = fuzz_u8(&in) % FUZZ_TARGETS;
+    switch (target) {
+        case 0: fuzz_mul(&in, &FP_OPS); break;
+        case 1: fuzz_mul(&in, &FQ_OPS); break;
+        default: _fuzz_targets[target](&in);
+    }
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+static uint64_t _rand_state;
+
+static uint64_t rand_u64(void)
+{
+    _rand_state ^= _rand_state >> 12;
+    _rand_state ^= _rand_state << 25;
+    _rand_state ^= _rand_state >> 27;
+    return _rand_state * 0x2545f4914f6cdd1dULL;
+}
+
+#define FUZZ_INPUT_MAX 4096
+
+int main(int argc, char *argv[])
+{
+    const size_t iterations = argc > 1 ? strtoull(argv[1], NULL, 0) : 2000;
+    _rand_state = argc > 2 ? strtoull(argv[2], NULL, 0) : 0x2545f4914f6cdd1d;
+    if (_rand_state == 0) {
+        _rand_state = 1;
+    }
+
+    // Every target on every edge case operand first, then random inputs
+    static uint8_t data[FUZZ_INPUT_MAX];
+    for (size_t target = 0; target < FUZZ_TARGETS; target++) {
+        for (uint8_t pick = 0; pick < 12; pick++) {
+            data[0] = target;
+            memset(&data[1], pick, FUZZ_INPUT_MAX - 1);
+            LLVMFuzzerTestOneInput(data, FUZZ_INPUT_MAX);
+        }
+    }
+
+    for (size_t i = 0; i < iterations; i++) {
+        const size_t size = rand_u64() % FUZZ_INPUT_MAX;
+        for (size_t j = 0; j < size; j += 8) {
+            const uint64_t r = rand_u64();
+            memcpy(&data[j], &r, size - j < 8 ? size - j : 8);
+        }
+        LLVMFuzzerTestOneInput(data, size);
+    }
+
+    printf("fuzz_diff: %zu edge case and %zu random inputs passed\n", FUZZ_TARGETS*12, iterations);
+    return 0;
+}
+
+#endif // FUZZ_LIBFUZZER
@@ -0,0 +1,337 @@
+// Bulk key and address generation
+//
+//     Public keys are k*G for the fixed generator G, so the multiples
+//     d * 2^(8w) * G for every signed 8-bit digit d and window w are
+//     computed once (32 windows of 128 affine points, 256KB).  A public key
+//     is then the sum of 32 table entries, one mixed addition per window
+//     and no doublings.  Keys are processed in chunks that share a single
+//     inversion for the conversion back to affine coordinates.
+//
+//     Private keys take fixed_base_mul_secret, which reads every entry of a
+//     window and keeps the wanted one with a mask, negates with a mask and
+//     adds a dummy entry for zero digits, so the memory accesses and field
+//     operations do not depend on the key.
+//
+//     Address encoding (two SHA-256 and a base58 encoding per key) is
+//     independent per key and split across threads.
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#if defined(__linux__)
+  #include <sys/random.h>
+#else
+  #include <unistd.h>
+#endif
+
+#include "keygen.h"
+#include "pasta_sparse.h"
+#include "utils.h"
+
+#define KEYGEN_WINDOW_BITS   8
+#define KEYGEN_WINDOWS       32   // scalars are < 2^254, no carry out of the top window
+#define KEYGEN_TABLE_SIZE    (1 << (KEYGEN_WINDOW_BITS - 1))
+#define KEYGEN_CHUNK         1024
+#define KEYGEN_THREAD_STACK  (256*1024)
+
+static Affine _base_table[KEYGEN_WINDOWS][KEYGEN_TABLE_SIZE];
+static pthread_once_t _base_table_once = PTHREAD_ONCE_INIT;
+
+// _base_table[w][j] = (j + 1) * 2^(8w) * G
+static void init_base_table(void)
+{
+    static Group chain[KEYGEN_TABLE_SIZE];
+
+    Affine base;
+    Scalar one;
+    const uint64_t words[4] = { 1, 0, 0, 0 };
+    scalar_from_words(one, words);
+    generate_pubkey(&base, one);
+
+    for (size_t w = 0; w < KEYGEN_WINDOWS; w++) {
+        Group gbase, tmp;
+        affine_to_group(&gbase, &base);
+        chain[0] = gbase;
+        for (size_t j = 1; j < KEYGEN_TABLE_SIZE; j++) {
+            group_madd(&chain[j], &chain[j - 1], &gbase);
+        }
+        affine_from_group_batch(_base_table[w], chain, KEYGEN_TABLE_SIZE);
+
+        // Next base is 2^8 * base = 2 * (128 * base)
+        group_dbl(&tmp, &chain[KEYGEN_TABLE_SIZE - 1]);
+        affine_from_group(&base, &tmp);
+    }
+}
+
+// r = k*G for k given in normal (not Montgomery) form, k < 2^254
+static void fixed_base_mul(Group *r, const uint64_t k[4])
+{
+    const int32_t half = 1 << (KEYGEN_WINDOW_BITS - 1);
+    const int32_t full = 1 << KEYGEN_WINDOW_BITS;
+
+    Group acc, q, tmp;
+    memset(&acc, 0, sizeof(acc)); // Z = 0 is the point at infinity
+    int32_t carry = 0;
+    for (size_t w = 0; w < KEYGEN_WINDOWS; w++) {
+        const size_t bit = w*KEYGEN_WINDOW_BITS;
+        int32_t d = (int32_t)((k[bit/64] >> (bit % 64)) & (full - 1)) + carry;
+        carry = d >= half;
+        d -= carry*full;
+        if (d == 0) {
+            continue;
+        }
+
+        Affine p;
+        if (d > 0) {
+            p = _base_table[w][d - 1];
+        }
+        else {
+            affine_negate(&p, &_base_table[w][-d - 1]);
+        }
+        affine_to_group(&q, &p);
+        group_madd(&tmp, &acc, &q);
+        acc = tmp;
+    }
+    *r = acc;
+}
+
+// r = mask ? p : r, for mask all zeros or all ones
+static void limbs_cmov(uint64_t *r, const uint64_t *p, const size_t limbs, const uint64_t mask)
+{
+    for (size_t i = 0; i < limbs; i++) {
+        r[i] ^= mask & (r[i] ^ p[i]);
+    }
+}
+
+// fixed_base_mul without branches or table indices that depend on k.  The
+// accumulator starts at B = 2^255 * G, which is removed at the end, so it
+// is never the point at infinity; its multiple stays near 2^254 while the
+// points added are small multiples of 2^(8w) * G, so the additions only
+// reach their doubling or cancelling branch for a negligible set of keys
+// (and are still correct then).
+static void fixed_base_mul_secret(Group *r, const uint64_t k[4])
+{
+    const int32_t half = 1 << (KEYGEN_WINDOW_BITS - 1);
+    const int32_t full = 1 << KEYGEN_WINDOW_BITS;
+    const Affine *blind = &_base_table[KEYGEN_WINDOWS - 1][KEYGEN_TABLE_SIZE - 1];
+
+    Group acc, q, sum;
+    affine_to_group(&acc, blind);
+    q = acc; // Z = 1, X and Y are set per window
+    int32_t carry = 0;
+    for (size_t w = 0; w < KEYGEN_WINDOWS; w++) {
+        const size_t bit = w*KEYGEN_WINDOW_BITS;
+        int32_t d = (int32_t)((k[bit/64] >> (bit % 64)) & (full - 1)) + carry;
+        carry = (int32_t)((uint32_t)(half - 1 - d) >> 31);
+        d -= carry*full;
+
+        // |d| - 1, or entry 0 as a dummy for d = 0
+        const uint32_t neg = (uint32_t)d >> 31;
+        const uint32_t abs = ((uint32_t)d ^ -neg) + neg;
+        const uint32_t zero = (abs - 1) >> 31;
+        const uint32_t index = abs - 1 + zero;
+
+        Affine p;
+        memset(&p, 0, sizeof(p));
+        for (uint32_t j = 0; j < KEYGEN_TABLE_SIZE; j++) {
+            const uint64_t hit = -(((uint64_t)(j ^ index) - 1) >> 63);
+            limbs_cmov((uint64_t *)&p, (const uint64_t *)&_base_table[w][j], sizeof(p)/sizeof(uint64_t), hit);
+        }
+        field_copy(q.X, p.x);
+        field_negate(q.Y, p.y);
+        limbs_cmov(q.Y, p.y, LIMBS_PER_FIELD, -(uint64_t)(neg ^ 1));
+
+        group_madd(&sum, &acc, &q);
+        limbs_cmov((uint64_t *)&acc, (const uint64_t *)&sum, sizeof(acc)/sizeof(uint64_t), -(uint64_t)(zero ^ 1));
+    }
+
+    affine_to_group(&q, blind);
+    field_negate(q.Y, q.Y);
+    group_madd(r, &acc, &q);
+}
+
+void generator_mul_public(Group *r, const Scalar k)
+{
+    uint64_t words[4];
+    pthread_once(&_base_table_once, init_base_table);
+    pasta_fq_from_montgomery_sparse(words, k);
+    fixed_base_mul(r, words);
+}
+
+void generator_mul_secret(Group *r, const Scalar k)
+{
+    uint64_t words[4];
+    pthread_once(&_base_table_once, init_base_table);
+    pasta_fq_from_montgomery_sparse(words, k);
+    fixed_base_mul_secret(r, words);
+    secure_bzero(words, sizeof(words));
+}
+
+// Fills buf from the system CSPRNG
+static bool read_entropy(uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+#if defined(__linux__)
+        const ssize_t got = getrandom(buf, len, 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+#else
+        // getentropy is limited to 256 bytes per call
+        const size_t got = len < 256 ? len : 256;
+        if (getentropy(buf, got) != 0) {
+            return false;
+        }
+#endif
+        buf += got;
+        len -= got;
+    }
+    return true;
+}
+
+// pub_keys[i] = k[i]*G for secret k in normal form, one inversion for all n
+static void pubkeys_from_words(Affine *pub_keys, const uint64_t (*k)[4], Group *scratch, const size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        fixed_base_mul_secret(&scratch[i], k[i]);
+    }
+    affine_from_group_batch(pub_keys, scratch, n);
+}
+
+void generate_pubkeys_batch(Affine *pub_keys, const Scalar *priv_keys, const size_t n)
+{
+    pthread_once(&_base_table_once, init_base_table);
+
+    uint64_t (*words)[4] = malloc(KEYGEN_CHUNK*sizeof(*words));
+    Group *scratch = malloc(KEYGEN_CHUNK*sizeof(Group));
+    if (!words || !scratch) {
+        // Without scratch memory, one key at a time
+        for (size_t i = 0; i < n; i++) {
+            generate_pubkey(&pub_keys[i], priv_keys[i]);
+        }
+    }
+    else {
+        for (size_t start = 0; start < n; start += KEYGEN_CHUNK) {
+            const size_t count = n - start < KEYGEN_CHUNK ? n - start : KEYGEN_CHUNK;
+            for (size_t i = 0; i < count; i++) {
+                pasta_fq_from_montgomery_sparse(words[i], priv_keys[start + i]);
+            }
+            pubkeys_from_words(&pub_keys[start], (const uint64_t (*)[4])words, scratch, count);
+        }
+        secure_bzero(words, KEYGEN_CHUNK*sizeof(*words));
+    }
+    free(scratch);
+    free(words);
+}
+
+bool generate_keypairs_batch(Keypair *keypairs, const size_t n)
+{
+    pthread_once(&_base_table_once, init_base_table);
+
+    uint64_t (*words)[4] = malloc(KEYGEN_CHUNK*sizeof(*words));
+    Group *scratch = malloc(KEYGEN_CHUNK*sizeof(Group));
+    Affine *pub_keys = malloc(KEYGEN_CHUNK*sizeof(Affine));
+    bool ok = words && scratch && pub_keys;
+
+    for (size_t start = 0; ok && start < n; start += KEYGEN_CHUNK) {
+        const size_t count = n - start < KEYGEN_CHUNK ? n - start : KEYGEN_CHUNK;
+        ok = read_entropy((uint8_t *)words, count*sizeof(*words));
+        if (!ok) {
+            break;
+        }
+
+        // Same reduction as generate_keypair, drop the top two bits
+        for (size_t i = 0; i < count; i++) {
+            words[i][3] &= (((uint64_t)1 << 62) - 1);
+            pasta_fq_to_montgomery_sparse(keypairs[start + i].priv, words[i]);
+        }
+
+        pubkeys_from_words(pub_keys, (const uint64_t (*)[4])words, scratch, count);
+        for (size_t i = 0; i < count; i++) {
+            keypairs[start + i].pub = pub_keys[i];
+        }
+    }
+
+    if (words) {
+        secure_bzero(words, KEYGEN_CHUNK*sizeof(*words));
+    }
+    free(pub_keys);
+    free(scratch);
+    free(words);
+    return ok;
+}
+
+typedef struct address_worker_t {
+    char *addresses;
+    const Keypair *keypairs;
+    size_t start;
+    size_t end;
+    bool ok;
+} AddressWorker;
+
+static void *encode_addresses(void *arg)
+{
+    AddressWorker *w = arg;
+    w->ok = true;
+    for (size_t i = w->start; i < w->end; i++) {
+        w->ok &= generate_address(&w->addresses[i*MINA_ADDRESS_LEN], MINA_ADDRESS_LEN, &w->keypairs[i].pub);
+    }
+    return NULL;
+}
+
+bool generate_addresses_batch(char *addresses, const Keypair *keypairs, const size_t n, const size_t threads)
+{
+    const size_t nthreads = threads < 1 ? 1 : (threads > n ? (n > 0 ? n : 1) : threads);
+    AddressWorker *workers = calloc(nthreads, sizeof(AddressWorker));
+    pthread_t *tids = calloc(nthreads, sizeof(pthread_t));
+    bool *spawned = calloc(nthreads, sizeof(bool));
+
+    if (!workers || !tids || !spawned) {
+        free(spawned);
+        free(tids);
+        free(workers);
+        AddressWorker w = { addresses, keypairs, 0, n, true };
+        encode_addresses(&w);
+        return w.ok;
+    }
+
+    for (size_t t = 0; t < nthreads; t++) {
+        workers[t] = (AddressWorker){ addresses, keypairs, t*n/nthreads, (t + 1)*n/nthreads, true };
+    }
+
+    pthread_attr_t attr;
+    const bool attr_ok = nthreads > 1 && pthread_attr_init(&attr) == 0;
+    if (attr_ok) {
+        pthread_attr_setstacksize(&attr, KEYGEN_THREAD_STACK);
+    }
+    for (size_t t = 1; attr_ok && t < nthreads; t++) {
+        spawned[t] = pthread_create(&tids[t], &attr, encode_addresses, &workers[t]) == 0;
+    }
+
+    // Anything that could not be spawned runs on this thread
+    for (size_t t = 0; t < nthreads; t++) {
+        if (!spawned[t]) {
+            encode_addresses(&workers[t]);
+        }
+    }
+
+    bool ok = true;
+    for (size_t t = 0; t < nthreads; t++) {
+        if (spawned[t]) {
+            pthread_join(tids[t], NULL);
+        }
+        ok &= workers[t].ok;
+    }
+    if (attr_ok) {
+        pthread_attr_destroy(&attr);
+    }
+
+    free(spawned);
+    free(tids);
+    free(workers);
+    return ok;
+}
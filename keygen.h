@@ -0,0 +1,29 @@
+// Bulk key and address generation
+//
+//     generate_keypairs_batch produces n random keypairs, equivalent to n
+//     calls of generate_keypair(kp, 0) but with entropy read in large
+//     chunks, public keys computed in constant time from a precomputed
+//     table of multiples of the generator and normalized with one inversion
+//     per chunk.
+//
+//     generate_addresses_batch encodes the public keys of n keypairs into
+//     consecutive MINA_ADDRESS_LEN byte strings, using up to `threads`
+//     threads.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "crypto.h"
+
+// k*G from the table of multiples of the generator, built on first use.
+// Not constant time: only for public scalars, such as the s of a
+// signature being verified.
+void generator_mul_public(Group *r, const Scalar k);
+// k*G from the same table in constant time, for private keys and nonces
+void generator_mul_secret(Group *r, const Scalar k);
+
+void generate_pubkeys_batch(Affine *pub_keys, const Scalar *priv_keys, const size_t n);
+bool generate_keypairs_batch(Keypair *keypairs, const size_t n);
+bool generate_addresses_batch(char *addresses, const Keypair *keypairs, const size_t n, const size_t threads);
@@ -0,0 +1,227 @@
+// libminasigner: batch signing ABI
+//
+//     Thin wrappers decoding the flat records of minasigner.h into the
+//     internal types and looping over crypto.c.  Consecutive records with
+//     the same key bytes (always the case with a stride of 0) reuse the
+//     decoded key, and each call goes through one SignerContext, so a batch
+//     with one key derives, or decompresses, its public key once.
+
+#include <string.h>
+
+#include "minasigner.h"
+#include "crypto.h"
+#include "poseidon.h"
+#include "signer_context.h"
+#include "utils.h"
+
+_Static_assert(MINASIGNER_PRIVKEY_BYTES == SCALAR_BYTES, "private key record");
+_Static_assert(MINASIGNER_PUBKEY_BYTES == COMPRESSED_BYTES, "public key record");
+_Static_assert(MINASIGNER_SIGNATURE_BYTES == SIGNATURE_BYTES, "signature record");
+_Static_assert(MINASIGNER_FIELD_BYTES == FIELD_BYTES && MINASIGNER_HASH_BYTES == SCALAR_BYTES, "field records");
+_Static_assert(MINASIGNER_TRANSACTION_BYTES == TRANSACTION_BYTES, "transaction record");
+_Static_assert(MINASIGNER_TESTNET == TESTNET_ID && MINASIGNER_MAINNET == MAINNET_ID && MINASIGNER_NULLNET == NULLNET_ID,
+               "network ids");
+_Static_assert(MINASIGNER_POSEIDON_LEGACY == POSEIDON_LEGACY && MINASIGNER_POSEIDON_KIMCHI == POSEIDON_KIMCHI, "poseidon types");
+
+// Messages of up to this many fields in total are hashed together
+#define POSEIDON_BATCH_FIELDS 64
+
+static void set_status(uint8_t *status, const size_t i, const uint8_t code)
+{
+    if (status) {
+        status[i] = code;
+    }
+}
+
+static bool valid_network(const uint8_t network)
+{
+    return network == MINASIGNER_TESTNET || network == MINASIGNER_MAINNET;
+}
+
+static bool keypair_from_bytes(Keypair *kp, const uint8_t in[MINASIGNER_PRIVKEY_BYTES])
+{
+    if (!scalar_from_bytes(kp->priv, in)) {
+        return false;
+    }
+    const Scalar zero = { 0, 0, 0, 0 };
+    if (scalar_eq(kp->priv, zero)) {
+        return false;
+    }
+    generate_pubkey(&kp->pub, kp->priv);
+    return true;
+}
+
+MINASIGNER_API uint32_t minasigner_abi_version(void)
+{
+    return MINASIGNER_ABI_VERSION;
+}
+
+MINASIGNER_API size_t minasigner_pubkeys(uint8_t *pubkeys, uint8_t *status,
+                                         const uint8_t *privkeys, const size_t n)
+{
+    size_t valid = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t *out = &pubkeys[i*MINASIGNER_PUBKEY_BYTES];
+        Keypair kp;
+        if (!keypair_from_bytes(&kp, &privkeys[i*MINASIGNER_PRIVKEY_BYTES])) {
+            memset(out, 0, MINASIGNER_PUBKEY_BYTES);
+            set_status(status, i, MINASIGNER_BAD_PRIVKEY);
+            continue;
+        }
+        Compressed pub;
+        compress(&pub, &kp.pub);
+        compressed_to_bytes(out, &pub);
+        set_status(status, i, MINASIGNER_OK);
+        valid++;
+    }
+    return valid;
+}
+
+MINASIGNER_API size_t minasigner_sign_batch(uint8_t *signatures, uint8_t *status,
+                                            const uint8_t *privkeys, const size_t privkey_stride,
+                                            const uint8_t *transactions, const size_t n,
+                                            const uint8_t network)
+{
+    if (!valid_network(network)) {
+        memset(signatures, 0, n*MINASIGNER_SIGNATURE_BYTES);
+        for (size_t i = 0; i < n; i++) {
+            set_status(status, i, MINASIGNER_BAD_NETWORK);
+        }
+        return 0;
+    }
+
+    SignerContext ctx;
+    signer_context_init(&ctx, network);
+
+    Keypair kp;
+    const uint8_t *key = NULL;
+    bool key_valid = false;
+    size_t signed_count = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t *out = &signatures[i*MINASIGNER_SIGNATURE_BYTES];
+        const uint8_t *next_key = &privkeys[i*privkey_stride];
+        if (!key || (next_key != key && memcmp(next_key, key, MINASIGNER_PRIVKEY_BYTES) != 0)) {
+            key_valid = keypair_from_bytes(&kp, next_key);
+        }
+        key = next_key;
+
+        uint8_t code = MINASIGNER_OK;
+        if (!key_valid) {
+            code = MINASIGNER_BAD_PRIVKEY;
+        }
+        else if (!sign_record(&ctx, out, &kp, &transactions[i*MINASIGNER_TRANSACTION_BYTES])) {
+            code = MINASIGNER_BAD_TRANSACTION;
+        }
+
+        if (code == MINASIGNER_OK) {
+            signed_count++;
+        }
+        else {
+            memset(out, 0, MINASIGNER_SIGNATURE_BYTES);
+        }
+        set_status(status, i, code);
+    }
+
+    secure_bzero(&kp, sizeof(kp));
+    signer_context_clear(&ctx);
+    return signed_count;
+}
+
+MINASIGNER_API size_t minasigner_verify_batch(uint8_t *status, const uint8_t *signatures,
+                                              const uint8_t *pubkeys, const size_t pubkey_stride,
+                                              const uint8_t *transactions, const size_t n,
+                                              const uint8_t network)
+{
+    if (!valid_network(network)) {
+        for (size_t i = 0; i < n; i++) {
+            set_status(status, i, MINASIGNER_BAD_NETWORK);
+        }
+        return 0;
+    }
+
+    SignerContext ctx;
+    signer_context_init(&ctx, network);
+
+    Compressed pub;
+    const uint8_t *key = NULL;
+    bool key_valid = false;
+    size_t valid = 0;
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t *next_key = &pubkeys[i*pubkey_stride];
+        if (!key || (next_key != key && memcmp(next_key, key, MINASIGNER_PUBKEY_BYTES) != 0)) {
+            key_valid = compressed_from_bytes(&pub, next_key);
+        }
+        key = next_key;
+
+        Transaction txn;
+        Signature sig;
+        uint8_t code = MINASIGNER_OK;
+        if (!key_valid) {
+            code = MINASIGNER_BAD_PUBKEY;
+        }
+        else if (!transaction_from_bytes(&txn, &transactions[i*MINASIGNER_TRANSACTION_BYTES])) {
+            code = MINASIGNER_BAD_TRANSACTION;
+        }
+        else if (!signature_from_bytes(&sig, &signatures[i*MINASIGNER_SIGNATURE_BYTES])
+                 || !verify_with_context(&ctx, &sig, &pub, &txn)) {
+            code = MINASIGNER_BAD_SIGNATURE;
+        }
+
+        valid += code == MINASIGNER_OK;
+        set_status(status, i, code);
+    }
+    return valid;
+}
+
+MINASIGNER_API size_t minasigner_poseidon_batch(uint8_t *hashes, const uint8_t *fields, const size_t len,
+                                                const size_t n, const uint8_t type, const uint8_t network)
+{
+    if (type > MINASIGNER_POSEIDON_KIMCHI
+        || (network != MINASIGNER_TESTNET && network != MINASIGNER_MAINNET && network != MINASIGNER_NULLNET)) {
+        return 0;
+    }
+
+    // Short messages go through the multi-lane permutation a few at a time,
+    // long ones are streamed through a sponge each
+    Field inputs[POSEIDON_BATCH_FIELDS];
+    Scalar out[POSEIDON_BATCH_FIELDS];
+    const size_t per_batch = len == 0 ? POSEIDON_BATCH_FIELDS : POSEIDON_BATCH_FIELDS / len;
+
+    for (size_t start = 0; start < n; ) {
+        if (per_batch > 0) {
+            const size_t count = n - start < per_batch ? n - start : per_batch;
+            for (size_t j = 0; j < count*len; j++) {
+                if (!field_from_bytes(inputs[j], &fields[(start*len + j)*MINASIGNER_FIELD_BYTES])) {
+                    return 0;
+                }
+            }
+            if (!poseidon_hash_batch(out, type, network, inputs, len, count)) {
+                return 0;
+            }
+            for (size_t j = 0; j < count; j++) {
+                scalar_to_bytes(&hashes[(start + j)*MINASIGNER_HASH_BYTES], out[j]);
+            }
+            start += count;
+            continue;
+        }
+
+        PoseidonCtx ctx;
+        if (!poseidon_init(&ctx, type, network)) {
+            return 0;
+        }
+        for (size_t j = 0; j < len; j += POSEIDON_BATCH_FIELDS) {
+            const size_t count = len - j < POSEIDON_BATCH_FIELDS ? len - j : POSEIDON_BATCH_FIELDS;
+            for (size_t f = 0; f < count; f++) {
+                if (!field_from_bytes(inputs[f], &fields[(start*len + j + f)*MINASIGNER_FIELD_BYTES])) {
+                    return 0;
+                }
+            }
+            poseidon_update(&ctx, inputs, count);
+        }
+        poseidon_digest(out[0], &ctx);
+        scalar_to_bytes(&hashes[start*MINASIGNER_HASH_BYTES], out[0]);
+        start++;
+    }
+
+    return n;
+}
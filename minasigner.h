@@ -0,0 +1,105 @@
+// libminasigner: batch signing ABI
+//
+//     The stable interface of libminasigner.so and libminasigner.a, for
+//     callers going through an FFI.  Only the functions below are exported
+//     (the library is built with hidden visibility and a version script),
+//     and they take flat arrays of fixed size byte records, so one call
+//     signs, verifies or hashes a whole batch.  Nothing here depends on
+//     crypto.h, whose types may change between releases.
+//
+//     Every integer is little endian and every field element or scalar is
+//     canonical, i.e. below its modulus:
+//
+//         private key   32 bytes   scalar
+//         public key    33 bytes   x coordinate, then 0 or 1 for the parity of y
+//         signature     64 bytes   rx, then s
+//         field         32 bytes   Poseidon input
+//         hash          32 bytes   Poseidon output, a scalar
+//
+//         transaction  176 bytes
+//             0  fee            u64     73  source key     33
+//             8  fee token      u64    106  receiver key   33
+//            16  nonce          u32    139  tag            u8, bits 0 to 2
+//            20  valid until    u32    140  token locked   u8, 0 or 1
+//            24  token id       u64    141  memo           34
+//            32  amount         u64    175  zero
+//            40  fee payer key  33
+//
+//     Adding functions keeps MINASIGNER_ABI_VERSION; changing a record or a
+//     signature bumps it together with the soname.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MINASIGNER_ABI_VERSION 1
+
+#define MINASIGNER_PRIVKEY_BYTES     32
+#define MINASIGNER_PUBKEY_BYTES      33
+#define MINASIGNER_SIGNATURE_BYTES   64
+#define MINASIGNER_FIELD_BYTES       32
+#define MINASIGNER_HASH_BYTES        32
+#define MINASIGNER_TRANSACTION_BYTES 176
+
+#define MINASIGNER_TESTNET 0x00
+#define MINASIGNER_MAINNET 0x01
+#define MINASIGNER_NULLNET 0xff // Poseidon without a domain prefix
+
+#define MINASIGNER_POSEIDON_LEGACY 0x00
+#define MINASIGNER_POSEIDON_KIMCHI 0x01
+
+// Per record status
+#define MINASIGNER_OK              0
+#define MINASIGNER_BAD_PRIVKEY     1 // not a canonical nonzero scalar
+#define MINASIGNER_BAD_PUBKEY      2 // x not canonical, or parity not 0 or 1
+#define MINASIGNER_BAD_TRANSACTION 3 // a key, tag, flag or padding byte out of range
+#define MINASIGNER_BAD_SIGNATURE   4 // not canonical, or does not verify for the key
+#define MINASIGNER_BAD_NETWORK     5 // not MINASIGNER_TESTNET or _MAINNET
+
+#if defined(__GNUC__)
+#define MINASIGNER_API __attribute__((visibility("default")))
+#else
+#define MINASIGNER_API
+#endif
+
+// MINASIGNER_ABI_VERSION of the library actually loaded
+MINASIGNER_API uint32_t minasigner_abi_version(void);
+
+// The public keys of n private keys.  status may be NULL, otherwise it
+// receives one MINASIGNER_* code per key.  Returns the number of keys that
+// were valid; pubkeys of invalid ones are zeroed.
+MINASIGNER_API size_t minasigner_pubkeys(uint8_t *pubkeys, uint8_t *status,
+                                         const uint8_t *privkeys, const size_t n);
+
+// Signs n transactions for network (MINASIGNER_TESTNET or _MAINNET).
+// privkey_stride is the distance between consecutive private keys, 0 to
+// sign every transaction with the same key.  status may be NULL.  Returns
+// the number signed; signatures that were not made are zeroed.
+MINASIGNER_API size_t minasigner_sign_batch(uint8_t *signatures, uint8_t *status,
+                                            const uint8_t *privkeys, const size_t privkey_stride,
+                                            const uint8_t *transactions, const size_t n,
+                                            const uint8_t network);
+
+// Verifies n signatures of transactions, pubkey_stride as privkey_stride
+// above, and status may again be NULL.  A public key that is not on the
+// curve fails as a bad signature.  Returns the number of valid signatures.
+MINASIGNER_API size_t minasigner_verify_batch(uint8_t *status, const uint8_t *signatures,
+                                              const uint8_t *pubkeys, const size_t pubkey_stride,
+                                              const uint8_t *transactions, const size_t n,
+                                              const uint8_t network);
+
+// Poseidon hashes of n messages of len field elements each, stored back to
+// back.  type is MINASIGNER_POSEIDON_* and network MINASIGNER_TESTNET,
+// _MAINNET or _NULLNET.  Returns the number hashed: n, or 0 if a field is
+// not canonical or an argument is invalid.
+MINASIGNER_API size_t minasigner_poseidon_batch(uint8_t *hashes, const uint8_t *fields, const size_t len,
+                                                const size_t n, const uint8_t type, const uint8_t network);
+
+#ifdef __cplusplus
+}
+#endif
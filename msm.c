@@ -0,0 +1,479 @@
+// Multi-scalar multiplication over Pallas (Pippenger's bucket method)
+//
+//     Scalars are recoded into signed c-bit digits in [-2^(c-1), 2^(c-1)),
+//     so every window needs 2^(c-1) buckets and a negative digit adds -P,
+//     which is free in affine coordinates.  The window size c is the
+//     minimum of a simple cost model: per window, n bucket additions plus
+//     two jacobian additions per bucket for the running bucket sum.
+//
+//     Buckets are kept in affine coordinates and points are added to them
+//     in batches that share a single inversion (Montgomery's trick).  A
+//     batch holds at most one pending addition per bucket; points that hit
+//     a bucket with a pending addition wait at the back of the queue.  With
+//     too few points or buckets to fill a batch (or many points sharing a
+//     few buckets) the points go into jacobian buckets with mixed additions
+//     instead.
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "msm.h"
+#include "pasta_sparse.h"
+
+#define MSM_SCALAR_BITS  255
+#define MSM_MIN_WINDOW   2
+#define MSM_MAX_WINDOW   16          // digits fit in int16_t
+#define MSM_BATCH        1024        // pending additions per inversion
+#define MSM_MIN_BATCH    64          // smaller batches use jacobian additions
+#define MSM_NEGATE       0x80000000  // MsmEntry.point flag
+#define MSM_THREAD_STACK (256*1024)
+
+// Approximate costs in field multiplications: a batched affine addition
+// without its share of the inversion, a mixed jacobian addition, the two
+// jacobian additions per bucket in the bucket sum and a field inversion
+#define MSM_COST_AFFINE_ADD 14
+#define MSM_COST_MADD       18
+#define MSM_COST_BUCKET_SUM 40
+#define MSM_COST_INVERSION  1100
+
+typedef struct msm_entry_t {
+    uint32_t point;  // index into P, MSM_NEGATE for negative digits
+    uint32_t bucket;
+} MsmEntry;
+
+typedef struct msm_op_t {
+    Affine q;        // point added to the bucket, already negated
+    Field num;       // lambda = num/den
+    uint32_t bucket;
+} MsmOp;
+
+typedef struct msm_worker_t {
+    const Affine *P;
+    const int16_t *digits;
+    size_t n;
+    size_t c;
+    size_t first_window;
+    size_t last_window;
+    Group *window_sums;
+
+    Affine *buckets;
+    bool *bucket_set;
+    Group *overflow;
+    bool *overflow_set;
+    uint32_t *claimed;      // batch that has a pending addition, per bucket
+    uint32_t batch;
+    MsmEntry *list;
+    MsmOp *ops;
+    Field *dens;
+    Field *invs;
+    size_t op_count;
+} MsmWorker;
+
+// One extra bit so that the top signed digit never carries out
+static size_t window_count(const size_t c)
+{
+    return (MSM_SCALAR_BITS + 2 + c - 1) / c;
+}
+
+// Cost of adding n points into 2^(c-1) buckets, sets affine if batched
+// affine additions are cheaper than mixed jacobian additions.  Batches
+// are assumed to fill about half of the buckets before they are flushed.
+static uint64_t accumulate_cost(const size_t n, const size_t c, bool *affine)
+{
+    const uint64_t buckets = (uint64_t)1 << (c - 1);
+    const uint64_t batch = buckets/2 < MSM_BATCH ? buckets/2 : MSM_BATCH;
+    const uint64_t jacobian_cost = n*MSM_COST_MADD;
+    const uint64_t affine_cost = n*MSM_COST_AFFINE_ADD + (n/batch + 1)*MSM_COST_INVERSION;
+
+    *affine = n >= MSM_MIN_BATCH && batch >= MSM_MIN_BATCH && affine_cost < jacobian_cost;
+    return *affine ? affine_cost : jacobian_cost;
+}
+
+size_t msm_window_bits(const size_t n)
+{
+    size_t best = MSM_MIN_WINDOW;
+    uint64_t best_cost = UINT64_MAX;
+    for (size_t c = MSM_MIN_WINDOW; c <= MSM_MAX_WINDOW; c++) {
+        bool affine;
+        const uint64_t buckets = (uint64_t)1 << (c - 1);
+        const uint64_t cost = window_count(c)*(accumulate_cost(n, c, &affine) + buckets*MSM_COST_BUCKET_SUM);
+        if (cost < best_cost) {
+            best = c;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+// digits[w*n + i] is the signed digit of k[i] in window w, all zero for
+// points at infinity
+static void recode(int16_t *digits, const Scalar *k, const Affine *P, const size_t n, const size_t c, const size_t windows)
+{
+    const int32_t half = 1 << (c - 1);
+    const int32_t full = 1 << c;
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t bits[4] = { 0 };
+        if (!affine_is_zero(&P[i])) {
+            pasta_fq_from_montgomery_sparse(bits, k[i]);
+        }
+
+        int32_t carry = 0;
+        for (size_t w = 0; w < windows; w++) {
+            const size_t start = w*c;
+            uint64_t raw = 0;
+            if (start < 256) {
+                raw = bits[start/64] >> (start % 64);
+                if (start % 64 + c > 64 && start/64 + 1 < 4) {
+                    raw |= bits[start/64 + 1] << (64 - start % 64);
+                }
+                raw &= full - 1;
+            }
+
+            int32_t d = (int32_t)raw + carry;
+            carry = d >= half;
+            d -= carry*full;
+            digits[w*n + i] = (int16_t)d;
+        }
+    }
+}
+
+static void flush(MsmWorker *w)
+{
+    if (w->op_count == 0) {
+        return;
+    }
+
+    field_inv_batch(w->invs, w->dens, w->op_count);
+    for (size_t i = 0; i < w->op_count; i++) {
+        const MsmOp *op = &w->ops[i];
+        Affine *b = &w->buckets[op->bucket];
+
+        Field lambda, t, x3, y3;
+        field_mul(lambda, op->num, w->invs[i]);
+        field_sq(t, lambda);
+        field_sub(x3, t, b->x);
+        field_sub(x3, x3, op->q.x);    // x3 = lambda^2 - x1 - x2
+        field_sub(t, b->x, x3);
+        field_mul(y3, lambda, t);
+        field_sub(b->y, y3, b->y);     // y3 = lambda * (x1 - x3) - y1
+        field_copy(b->x, x3);
+    }
+
+    w->op_count = 0;
+    w->batch++;
+}
+
+static void load_point(Affine *q, const MsmWorker *w, const MsmEntry *e)
+{
+    const Affine *p = &w->P[e->point & ~MSM_NEGATE];
+    field_copy(q->x, p->x);
+    if (e->point & MSM_NEGATE) {
+        field_negate(q->y, p->y);
+    }
+    else {
+        field_copy(q->y, p->y);
+    }
+}
+
+// Adds the entry's point to its bucket, directly or by queueing it in the
+// current batch.  Returns false if the bucket already has a pending
+// addition in this batch.
+static bool accumulate(MsmWorker *w, const MsmEntry *e)
+{
+    const uint32_t b = e->bucket;
+    if (w->claimed[b] == w->batch) {
+        return false;
+    }
+
+    MsmOp *op = &w->ops[w->op_count];
+    load_point(&op->q, w, e);
+
+    if (!w->bucket_set[b]) {
+        w->buckets[b] = op->q;
+        w->bucket_set[b] = true;
+        return true;
+    }
+
+    const Affine *bucket = &w->buckets[b];
+    if (field_eq(op->q.x, bucket->x)) {
+        if (!field_eq(op->q.y, bucket->y)) {
+            // q = -bucket
+            w->bucket_set[b] = false;
+            return true;
+        }
+
+        // Doubling, lambda = 3x^2 / 2y
+        Field t;
+        field_sq(t, bucket->x);
+        field_add(op->num, t, t);
+        field_add(op->num, op->num, t);
+        field_add(w->dens[w->op_count], bucket->y, bucket->y);
+    }
+    else {
+        // lambda = (y2 - y1) / (x2 - x1)
+        field_sub(op->num, op->q.y, bucket->y);
+        field_sub(w->dens[w->op_count], op->q.x, bucket->x);
+    }
+
+    op->bucket = b;
+    w->claimed[b] = w->batch;
+    if (++w->op_count == MSM_BATCH) {
+        flush(w);
+    }
+
+    return true;
+}
+
+static void accumulate_overflow(MsmWorker *w, const MsmEntry *e)
+{
+    const uint32_t b = e->bucket;
+    Affine q;
+    Group gq, tmp;
+    load_point(&q, w, e);
+    affine_to_group(&gq, &q);
+
+    if (!w->overflow_set[b]) {
+        w->overflow[b] = gq;
+        w->overflow_set[b] = true;
+    }
+    else {
+        group_madd(&tmp, &w->overflow[b], &gq);
+        w->overflow[b] = tmp;
+    }
+}
+
+// sum = sum over the points of digit * P for one window
+static void process_window(MsmWorker *w, const size_t window, Group *sum)
+{
+    const size_t buckets = (size_t)1 << (w->c - 1);
+    const int16_t *digits = w->digits + window*w->n;
+
+    memset(w->bucket_set, 0, buckets*sizeof(bool));
+    memset(w->overflow_set, 0, buckets*sizeof(bool));
+
+    size_t len = 0;
+    for (size_t i = 0; i < w->n; i++) {
+        if (digits[i] > 0) {
+            w->list[len].point = i;
+            w->list[len++].bucket = digits[i] - 1;
+        }
+        else if (digits[i] < 0) {
+            w->list[len].point = i | MSM_NEGATE;
+            w->list[len++].bucket = -digits[i] - 1;
+        }
+    }
+
+    bool affine;
+    accumulate_cost(len, w->c, &affine);
+    if (!affine) {
+        for (size_t i = 0; i < len; i++) {
+            accumulate_overflow(w, &w->list[i]);
+        }
+        len = 0;
+    }
+
+    // The list is a queue, entries whose bucket already has a pending
+    // addition go to the back.  The batch is flushed before it is full once
+    // the run of waiting entries gets longer than the batch, or when every
+    // remaining entry waits on it.
+    size_t head = 0, waiting = 0;
+    while (len > 0) {
+        if (waiting > w->op_count && w->op_count >= MSM_MIN_BATCH) {
+            flush(w);
+            waiting = 0;
+        }
+        else if (waiting == len) {
+            const size_t pending = w->op_count;
+            flush(w);
+            waiting = 0;
+
+            // Mostly repeated buckets, one inversion per handful of points
+            if (pending < MSM_MIN_BATCH) {
+                for (size_t i = 0; i < len; i++) {
+                    accumulate_overflow(w, &w->list[(head + i) % w->n]);
+                }
+                break;
+            }
+        }
+
+        const MsmEntry e = w->list[head];
+        head = (head + 1) % w->n;
+        if (accumulate(w, &e)) {
+            len--;
+            waiting = 0;
+        }
+        else {
+            w->list[(head + len - 1) % w->n] = e;
+            waiting++;
+        }
+    }
+    flush(w);
+
+    // sum = sum (b + 1) * bucket[b], as a running sum from the top bucket
+    Group running, total, tmp;
+    memset(&running, 0, sizeof(running)); // Z = 0 is the point at infinity
+    memset(&total, 0, sizeof(total));
+    for (size_t b = buckets; b-- > 0; ) {
+        if (w->bucket_set[b]) {
+            Group gb;
+            affine_to_group(&gb, &w->buckets[b]);
+            group_madd(&tmp, &running, &gb);
+            running = tmp;
+        }
+        if (w->overflow_set[b]) {
+            group_add(&tmp, &running, &w->overflow[b]);
+            running = tmp;
+        }
+        group_add(&tmp, &total, &running);
+        total = tmp;
+    }
+    *sum = total;
+}
+
+static void *run_worker(void *arg)
+{
+    MsmWorker *w = arg;
+    for (size_t window = w->first_window; window < w->last_window; window++) {
+        process_window(w, window, &w->window_sums[window]);
+    }
+    return NULL;
+}
+
+static void free_worker(MsmWorker *w)
+{
+    free(w->buckets);
+    free(w->bucket_set);
+    free(w->overflow);
+    free(w->overflow_set);
+    free(w->claimed);
+    free(w->list);
+    free(w->ops);
+    free(w->dens);
+    free(w->invs);
+}
+
+static bool alloc_worker(MsmWorker *w)
+{
+    const size_t buckets = (size_t)1 << (w->c - 1);
+    w->buckets = malloc(buckets*sizeof(Affine));
+    w->bucket_set = malloc(buckets*sizeof(bool));
+    w->overflow = malloc(buckets*sizeof(Group));
+    w->overflow_set = malloc(buckets*sizeof(bool));
+    w->claimed = calloc(buckets, sizeof(uint32_t));
+    w->batch = 1;
+    w->list = malloc(w->n*sizeof(MsmEntry));
+    w->ops = malloc(MSM_BATCH*sizeof(MsmOp));
+    w->dens = malloc(MSM_BATCH*sizeof(Field));
+    w->invs = malloc(MSM_BATCH*sizeof(Field));
+    w->op_count = 0;
+
+    return w->buckets && w->bucket_set && w->overflow && w->overflow_set
+        && w->claimed && w->list && w->ops && w->dens && w->invs;
+}
+
+// Without scratch memory, one scalar multiplication per point
+static void msm_naive(Group *out, const Scalar *k, const Affine *P, const size_t n)
+{
+    Group acc, tmp, term, gp;
+    memset(&acc, 0, sizeof(acc));
+    for (size_t i = 0; i < n; i++) {
+        affine_to_group(&gp, &P[i]);
+        group_scalar_mul(&term, k[i], &gp);
+        group_add(&tmp, &acc, &term);
+        acc = tmp;
+    }
+    *out = acc;
+}
+
+void group_msm_threads(Group *out, const Scalar *k, const Affine *P, const size_t n, const size_t threads)
+{
+    memset(out, 0, sizeof(*out));
+    if (n == 0) {
+        return;
+    }
+    if (n >= MSM_NEGATE) {
+        msm_naive(out, k, P, n);
+        return;
+    }
+
+    const size_t c = msm_window_bits(n);
+    const size_t windows = window_count(c);
+    const size_t nthreads = threads < 1 ? 1 : (threads > windows ? windows : threads);
+
+    int16_t *digits = malloc(windows*n*sizeof(int16_t));
+    Group *window_sums = malloc(windows*sizeof(Group));
+    MsmWorker *workers = calloc(nthreads, sizeof(MsmWorker));
+    pthread_t *tids = calloc(nthreads, sizeof(pthread_t));
+    bool *spawned = calloc(nthreads, sizeof(bool));
+
+    bool ok = digits && window_sums && workers && tids && spawned;
+    for (size_t t = 0; ok && t < nthreads; t++) {
+        MsmWorker *w = &workers[t];
+        w->P = P;
+        w->digits = digits;
+        w->n = n;
+        w->c = c;
+        w->first_window = t*windows/nthreads;
+        w->last_window = (t + 1)*windows/nthreads;
+        w->window_sums = window_sums;
+        ok = alloc_worker(w);
+    }
+
+    if (ok) {
+        recode(digits, k, P, n, c, windows);
+
+        pthread_attr_t attr;
+        const bool attr_ok = nthreads > 1 && pthread_attr_init(&attr) == 0;
+        if (attr_ok) {
+            pthread_attr_setstacksize(&attr, MSM_THREAD_STACK);
+        }
+        for (size_t t = 1; attr_ok && t < nthreads; t++) {
+            spawned[t] = pthread_create(&tids[t], &attr, run_worker, &workers[t]) == 0;
+        }
+
+        // Anything that could not be spawned runs on this thread
+        for (size_t t = 0; t < nthreads; t++) {
+            if (!spawned[t]) {
+                run_worker(&workers[t]);
+            }
+        }
+        for (size_t t = 1; t < nthreads; t++) {
+            if (spawned[t]) {
+                pthread_join(tids[t], NULL);
+            }
+        }
+        if (attr_ok) {
+            pthread_attr_destroy(&attr);
+        }
+
+        // out = sum 2^(c*w) * window_sums[w]
+        Group tmp;
+        for (size_t w = windows; w-- > 0; ) {
+            for (size_t i = 0; i < c; i++) {
+                group_dbl(&tmp, out);
+                *out = tmp;
+            }
+            group_add(&tmp, out, &window_sums[w]);
+            *out = tmp;
+        }
+    }
+    else {
+        msm_naive(out, k, P, n);
+    }
+
+    for (size_t t = 0; workers && t < nthreads; t++) {
+        free_worker(&workers[t]);
+    }
+    free(spawned);
+    free(tids);
+    free(workers);
+    free(window_sums);
+    free(digits);
+}
+
+void group_msm(Group *out, const Scalar *k, const Affine *P, const size_t n)
+{
+    group_msm_threads(out, k, P, n, 1);
+}
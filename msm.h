@@ -0,0 +1,16 @@
+// Multi-scalar multiplication over Pallas
+//
+//     group_msm computes k[0]*P[0] + ... + k[n-1]*P[n-1] with Pippenger's
+//     bucket method.  group_msm_threads does the same with the windows
+//     split across up to `threads` threads.
+
+#pragma once
+
+#include <stddef.h>
+
+#include "crypto.h"
+
+size_t msm_window_bits(const size_t n);
+
+void group_msm(Group *out, const Scalar *k, const Affine *P, const size_t n);
+void group_msm_threads(Group *out, const Scalar *k, const Affine *P, const size_t n, const size_t threads);
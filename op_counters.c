@@ -0,0 +1,34 @@
+// Operation counters
+
+#include <string.h>
+
+#include "op_counters.h"
+
+#ifdef OP_COUNTERS
+_Thread_local OpCounts op_counts;
+#endif
+
+bool op_counters_enabled(void)
+{
+#ifdef OP_COUNTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void op_counts_snapshot(OpCounts *out)
+{
+#ifdef OP_COUNTERS
+    *out = op_counts;
+#else
+    memset(out, 0, sizeof(*out));
+#endif
+}
+
+void op_counts_reset(void)
+{
+#ifdef OP_COUNTERS
+    memset(&op_counts, 0, sizeof(op_counts));
+#endif
+}
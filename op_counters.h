@@ -0,0 +1,35 @@
+// Operation counters
+//
+//     Building with OP_COUNTERS defined (make OP_COUNTERS=1, after a make
+//     clean) counts the field and group operations each thread performs.
+//     Without it OP_COUNT() expands to nothing, the hot paths are exactly
+//     as before and snapshots are all zero.  Counts are per thread, so work
+//     done by msm or keygen worker threads is not in the caller's snapshot.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct op_counts_t {
+    uint64_t field_mul;     // including batch elements and sum of products terms
+    uint64_t field_sq;      // including batch elements
+    uint64_t field_inv;
+    uint64_t scalar_mul;    // including batch elements
+    uint64_t group_add;
+    uint64_t group_madd;
+    uint64_t group_dbl;
+    uint64_t group_coz_add; // co-Z additions of the group_scalar_mul_coz ladder
+} OpCounts;
+
+#ifdef OP_COUNTERS
+extern _Thread_local OpCounts op_counts;
+#define OP_COUNT(op, n) (op_counts.op += (n))
+#else
+#define OP_COUNT(op, n) ((void)0)
+#endif
+
+bool op_counters_enabled(void);
+// Counts of the calling thread since its last reset
+void op_counts_snapshot(OpCounts *out);
+void op_counts_reset(void);
@@ -0,0 +1,352 @@
+// x86-64 MULX/ADCX/ADOX Montgomery arithmetic for the Pasta fields
+//
+//     Multiplication is word-by-word (CIOS) Montgomery: each of the four
+//     rows adds a[i]*b into a 5-word accumulator and immediately folds in
+//     m*p, shifting one word out.  MULX leaves the flags alone, so the low
+//     and high halves of each row are accumulated on two independent carry
+//     chains (ADOX on OF, ADCX on CF) with no flag spills.
+//
+//     Both moduli have the sparse shape (p0, p1, 0, 2^62), which the
+//     reduction exploits (see REDUCE).  The top word is also far below
+//     2^63 - 1, so the accumulator never carries out of the fifth word and
+//     the reduction can reuse it directly ("no carry" Montgomery).
+//
+//     Squaring computes the six cross products once, doubles them, adds the
+//     four squares and then runs the same reduction on the low half before
+//     adding the high half back in.  Sums of products accumulate all the
+//     products the same way and share that single reduction.
+
+#include "pasta_adx.h"
+#include "pasta_fp.h"
+#include "pasta_fq.h"
+#include "pasta_sparse.h"
+#include "cpu.h"
+
+bool pasta_adx_supported(void)
+{
+#if defined(__x86_64__)
+    return cpu_has(CPU_FEATURE_BMI2 | CPU_FEATURE_ADX);
+#else
+    return false;
+#endif
+}
+
+#if defined(__x86_64__)
+
+// p = 0x40000000000000000000000000000000224698fc094cf91b992d30ed00000001
+static const uint64_t FP_MODULUS[4] = {
+    0x992d30ed00000001, 0x224698fc094cf91b, 0x0000000000000000, 0x4000000000000000
+};
+static const uint64_t FP_INV = 0x992d30ecffffffff; // -p^-1 mod 2^64
+
+// q = 0x40000000000000000000000000000000224698fc0994a8dd8c46eb2100000001
+static const uint64_t FQ_MODULUS[4] = {
+    0x8c46eb2100000001, 0x224698fc0994a8dd, 0x0000000000000000, 0x4000000000000000
+};
+static const uint64_t FQ_INV = 0x8c46eb20ffffffff; // -q^-1 mod 2^64
+
+// Accumulator t0..t3 = r8..r11, fifth word A = r12, scratch r13
+
+// (t0..t3, A) = a[0]*b
+#define MUL_ROW0                                \
+    "xorl   %%eax, %%eax\n\t"                   \
+    "movq   0(%[a]), %%rdx\n\t"                 \
+    "mulxq  0(%[b]), %%r8, %%r9\n\t"            \
+    "mulxq  8(%[b]), %%rax, %%r10\n\t"          \
+    "adoxq  %%rax, %%r9\n\t"                    \
+    "mulxq  16(%[b]), %%rax, %%r11\n\t"         \
+    "adoxq  %%rax, %%r10\n\t"                   \
+    "mulxq  24(%[b]), %%rax, %%r12\n\t"         \
+    "adoxq  %%rax, %%r11\n\t"                   \
+    "movl   $0, %%eax\n\t"                      \
+    "adoxq  %%rax, %%r12\n\t"
+
+// (t0..t3, A) = (t0..t3) + a[i]*b
+#define MUL_ROW(off)                            \
+    "movq   " #off "(%[a]), %%rdx\n\t"          \
+    "xorl   %%eax, %%eax\n\t"                   \
+    "mulxq  0(%[b]), %%rax, %%r12\n\t"          \
+    "adoxq  %%rax, %%r8\n\t"                    \
+    "adcxq  %%r12, %%r9\n\t"                    \
+    "mulxq  8(%[b]), %%rax, %%r12\n\t"          \
+    "adoxq  %%rax, %%r9\n\t"                    \
+    "adcxq  %%r12, %%r10\n\t"                   \
+    "mulxq  16(%[b]), %%rax, %%r12\n\t"         \
+    "adoxq  %%rax, %%r10\n\t"                   \
+    "adcxq  %%r12, %%r11\n\t"                   \
+    "mulxq  24(%[b]), %%rax, %%r12\n\t"         \
+    "adoxq  %%rax, %%r11\n\t"                   \
+    "movl   $0, %%eax\n\t"                      \
+    "adcxq  %%rax, %%r12\n\t"                   \
+    "adoxq  %%rax, %%r12\n\t"
+
+// (t0..t3) = ((t0..t3, top) + m*p) / 2^64 with m = t0 * -p^-1
+//
+// p2 = 0 and p3 = 2^62, so only m*p0 and m*p1 need a multiplication; the
+// 2^254 term is added as m << 62 and m >> 2 using SHLX/SHRX, which leave
+// both carry chains intact
+#define REDUCE(top)                             \
+    "movq   %[inv], %%rdx\n\t"                  \
+    "imulq  %%r8, %%rdx\n\t"                    \
+    "xorl   %%eax, %%eax\n\t"                   \
+    "mulxq  %[p0], %%rax, %%r13\n\t"            \
+    "adcxq  %%r8, %%rax\n\t"                    \
+    "movq   %%r13, %%r8\n\t"                    \
+    "adcxq  %%r9, %%r8\n\t"                     \
+    "mulxq  %[p1], %%rax, %%r9\n\t"             \
+    "adoxq  %%rax, %%r8\n\t"                    \
+    "adcxq  %%r10, %%r9\n\t"                    \
+    "movl   $62, %%eax\n\t"                     \
+    "shlxq  %%rax, %%rdx, %%r10\n\t"            \
+    "adcxq  %%r11, %%r10\n\t"                   \
+    "movl   $2, %%eax\n\t"                      \
+    "shrxq  %%rax, %%rdx, %%r11\n\t"            \
+    "movl   $0, %%eax\n\t"                      \
+    "adoxq  %%rax, %%r9\n\t"                    \
+    "adoxq  %%rax, %%r10\n\t"                   \
+    "adcxq  " top ", %%r11\n\t"                 \
+    "adoxq  %%rax, %%r11\n\t"
+
+// out = t0..t3 - p if that does not borrow, t0..t3 otherwise
+#define FINAL_SUB                               \
+    "movq   %%r8, %%rax\n\t"                    \
+    "subq   %[p0], %%rax\n\t"                   \
+    "movq   %%r9, %%rdx\n\t"                    \
+    "sbbq   %[p1], %%rdx\n\t"                   \
+    "movq   %%r10, %%r12\n\t"                   \
+    "sbbq   $0, %%r12\n\t"                      \
+    "movq   %%r11, %%r13\n\t"                   \
+    "sbbq   %[p3], %%r13\n\t"                   \
+    "cmovcq %%r8, %%rax\n\t"                    \
+    "cmovcq %%r9, %%rdx\n\t"                    \
+    "cmovcq %%r10, %%r12\n\t"                   \
+    "cmovcq %%r11, %%r13\n\t"                   \
+    "movq   %%rax, 0(%[out])\n\t"               \
+    "movq   %%rdx, 8(%[out])\n\t"               \
+    "movq   %%r12, 16(%[out])\n\t"              \
+    "movq   %%r13, 24(%[out])\n\t"
+
+#define MONT_MUL_ADX(OUT, A, B, P, INV)                                 \
+    __asm__ volatile (                                                  \
+        MUL_ROW0                                                        \
+        REDUCE("%%r12")                                                 \
+        MUL_ROW(8)                                                      \
+        REDUCE("%%r12")                                                 \
+        MUL_ROW(16)                                                     \
+        REDUCE("%%r12")                                                 \
+        MUL_ROW(24)                                                     \
+        REDUCE("%%r12")                                                 \
+        FINAL_SUB                                                       \
+        :                                                               \
+        : [out] "r"(OUT), [a] "r"(A), [b] "r"(B),                       \
+          [p0] "m"(P[0]), [p1] "m"(P[1]), [p3] "m"(P[3]),              \
+          [inv] "m"(INV)                                                \
+        : "rax", "rdx", "r8", "r9", "r10", "r11", "r12", "r13",         \
+          "cc", "memory")
+
+// t0..t7 = r8..r15 = a^2, scratch rcx
+//
+// REDUCE uses r13 as scratch, so t5 is parked in rcx while the low half
+// is reduced
+#define SQR_PRODUCT                             \
+    "xorl   %%eax, %%eax\n\t"                   \
+    "movq   0(%[a]), %%rdx\n\t"                 \
+    "mulxq  8(%[a]), %%r9, %%r10\n\t"           \
+    "mulxq  16(%[a]), %%rax, %%r11\n\t"         \
+    "adcxq  %%rax, %%r10\n\t"                   \
+    "mulxq  24(%[a]), %%rax, %%r12\n\t"         \
+    "adcxq  %%rax, %%r11\n\t"                   \
+    "movq   8(%[a]), %%rdx\n\t"                 \
+    "mulxq  16(%[a]), %%rax, %%rcx\n\t"         \
+    "adoxq  %%rax, %%r11\n\t"                   \
+    "adcxq  %%rcx, %%r12\n\t"                   \
+    "mulxq  24(%[a]), %%rax, %%r13\n\t"         \
+    "adoxq  %%rax, %%r12\n\t"                   \
+    "movl   $0, %%eax\n\t"                      \
+    "adcxq  %%rax, %%r13\n\t"                   \
+    "adoxq  %%rax, %%r13\n\t"                   \
+    "movq   16(%[a]), %%rdx\n\t"                \
+    "mulxq  24(%[a]), %%rax, %%r14\n\t"         \
+    "addq   %%rax, %%r13\n\t"                   \
+    "adcq   $0, %%r14\n\t"                      \
+    "xorl   %%r15d, %%r15d\n\t"                 \
+    "addq   %%r9, %%r9\n\t"                     \
+    "adcq   %%r10, %%r10\n\t"                   \
+    "adcq   %%r11, %%r11\n\t"                   \
+    "adcq   %%r12, %%r12\n\t"                   \
+    "adcq   %%r13, %%r13\n\t"                   \
+    "adcq   %%r14, %%r14\n\t"                   \
+    "adcq   %%r15, %%r15\n\t"                   \
+    "movq   0(%[a]), %%rdx\n\t"                 \
+    "mulxq  %%rdx, %%r8, %%rax\n\t"             \
+    "addq   %%rax, %%r9\n\t"                    \
+    "movq   8(%[a]), %%rdx\n\t"                 \
+    "mulxq  %%rdx, %%rax, %%rcx\n\t"            \
+    "adcq   %%rax, %%r10\n\t"                   \
+    "adcq   %%rcx, %%r11\n\t"                   \
+    "movq   16(%[a]), %%rdx\n\t"                \
+    "mulxq  %%rdx, %%rax, %%rcx\n\t"            \
+    "adcq   %%rax, %%r12\n\t"                   \
+    "adcq   %%rcx, %%r13\n\t"                   \
+    "movq   24(%[a]), %%rdx\n\t"                \
+    "mulxq  %%rdx, %%rax, %%rcx\n\t"            \
+    "adcq   %%rax, %%r14\n\t"                   \
+    "adcq   %%rcx, %%r15\n\t"
+
+// REDC(t) = REDC(t0..t3) + t4..t7, since m only depends on the low half
+#define SQR_ADD_HIGH                            \
+    "addq   %%r12, %%r8\n\t"                    \
+    "adcq   %%r13, %%r9\n\t"                    \
+    "adcq   %%r14, %%r10\n\t"                   \
+    "adcq   %%r15, %%r11\n\t"
+
+#define MONT_SQUARE_ADX(OUT, A, P, INV)                                 \
+    __asm__ volatile (                                                  \
+        SQR_PRODUCT                                                     \
+        "movq   %%r13, %%rcx\n\t"                                       \
+        REDUCE("%%rax")                                                 \
+        REDUCE("%%rax")                                                 \
+        REDUCE("%%rax")                                                 \
+        REDUCE("%%rax")                                                 \
+        "movq   %%rcx, %%r13\n\t"                                       \
+        SQR_ADD_HIGH                                                    \
+        FINAL_SUB                                                       \
+        :                                                               \
+        : [out] "r"(OUT), [a] "r"(A),                                   \
+          [p0] "m"(P[0]), [p1] "m"(P[1]), [p3] "m"(P[3]),              \
+          [inv] "m"(INV)                                                \
+        : "rax", "rcx", "rdx", "r8", "r9", "r10", "r11", "r12", "r13",  \
+          "r14", "r15", "cc", "memory")
+
+// (t0..t7) += a[i]*b with T0..T4 = t[i..i+4]; TAIL carries both chains
+// through the words above t[i+4]
+#define MAC_ROW(off, T0, T1, T2, T3, T4, TAIL)  \
+    "movq   " #off "(%[a]), %%rdx\n\t"          \
+    "xorl   %%eax, %%eax\n\t"                   \
+    "mulxq  0(%[b]), %%rax, %%rcx\n\t"          \
+    "adcxq  %%rax, " T0 "\n\t"                  \
+    "adoxq  %%rcx, " T1 "\n\t"                  \
+    "mulxq  8(%[b]), %%rax, %%rcx\n\t"          \
+    "adcxq  %%rax, " T1 "\n\t"                  \
+    "adoxq  %%rcx, " T2 "\n\t"                  \
+    "mulxq  16(%[b]), %%rax, %%rcx\n\t"         \
+    "adcxq  %%rax, " T2 "\n\t"                  \
+    "adoxq  %%rcx, " T3 "\n\t"                  \
+    "mulxq  24(%[b]), %%rax, %%rcx\n\t"         \
+    "adcxq  %%rax, " T3 "\n\t"                  \
+    "adoxq  %%rcx, " T4 "\n\t"                  \
+    "movl   $0, %%eax\n\t"                      \
+    "adcxq  %%rax, " T4 "\n\t"                  \
+    TAIL
+
+#define CARRY(T)                                \
+    "adcxq  %%rax, " T "\n\t"                   \
+    "adoxq  %%rax, " T "\n\t"
+
+// out = REDC(sum a[i]*b[i]) for n <= PASTA_SUM_OF_PRODUCTS_MAX, the
+// products are summed unreduced in t0..t7 and reduced like a square
+#define MONT_SUM_OF_PRODUCTS_ADX(OUT, A, B, N, P, INV)                  \
+    __asm__ volatile (                                                  \
+        "xorl   %%r8d, %%r8d\n\t"                                       \
+        "xorl   %%r9d, %%r9d\n\t"                                       \
+        "xorl   %%r10d, %%r10d\n\t"                                     \
+        "xorl   %%r11d, %%r11d\n\t"                                     \
+        "xorl   %%r12d, %%r12d\n\t"                                     \
+        "xorl   %%r13d, %%r13d\n\t"                                     \
+        "xorl   %%r14d, %%r14d\n\t"                                     \
+        "xorl   %%r15d, %%r15d\n\t"                                     \
+        "cmpq   $0, %[n]\n\t"                                            \
+        "je     2f\n\t"                                                  \
+        "1:\n\t"                                                         \
+        MAC_ROW(0,  "%%r8",  "%%r9",  "%%r10", "%%r11", "%%r12",        \
+                CARRY("%%r13") CARRY("%%r14") CARRY("%%r15"))           \
+        MAC_ROW(8,  "%%r9",  "%%r10", "%%r11", "%%r12", "%%r13",        \
+                CARRY("%%r14") CARRY("%%r15"))                          \
+        MAC_ROW(16, "%%r10", "%%r11", "%%r12", "%%r13", "%%r14",        \
+                CARRY("%%r15"))                                         \
+        MAC_ROW(24, "%%r11", "%%r12", "%%r13", "%%r14", "%%r15", "")    \
+        "addq   $32, %[a]\n\t"                                           \
+        "addq   $32, %[b]\n\t"                                           \
+        "decq   %[n]\n\t"                                                \
+        "jnz    1b\n\t"                                                  \
+        "2:\n\t"                                                         \
+        "movq   %%r13, %%rcx\n\t"                                       \
+        REDUCE("%%rax")                                                 \
+        REDUCE("%%rax")                                                 \
+        REDUCE("%%rax")                                                 \
+        REDUCE("%%rax")                                                 \
+        "movq   %%rcx, %%r13\n\t"                                       \
+        SQR_ADD_HIGH                                                    \
+        FINAL_SUB                                                       \
+        : [a] "+r"(A), [b] "+r"(B), [n] "+m"(N)                         \
+        : [out] "r"(OUT),                                               \
+          [p0] "m"(P[0]), [p1] "m"(P[1]), [p3] "m"(P[3]),              \
+          [inv] "m"(INV)                                                \
+        : "rax", "rcx", "rdx", "r8", "r9", "r10", "r11", "r12", "r13",  \
+          "r14", "r15", "cc", "memory")
+
+void pasta_fp_mul_adx(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4])
+{
+    MONT_MUL_ADX(out1, arg1, arg2, FP_MODULUS, FP_INV);
+}
+
+void pasta_fp_square_adx(uint64_t out1[4], const uint64_t arg1[4])
+{
+    MONT_SQUARE_ADX(out1, arg1, FP_MODULUS, FP_INV);
+}
+
+void pasta_fp_sum_of_products_adx(uint64_t out1[4], const uint64_t arg1[][4], const uint64_t arg2[][4], const size_t n)
+{
+    size_t rows = n;
+    MONT_SUM_OF_PRODUCTS_ADX(out1, arg1, arg2, rows, FP_MODULUS, FP_INV);
+}
+
+void pasta_fq_mul_adx(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4])
+{
+    MONT_MUL_ADX(out1, arg1, arg2, FQ_MODULUS, FQ_INV);
+}
+
+void pasta_fq_square_adx(uint64_t out1[4], const uint64_t arg1[4])
+{
+    MONT_SQUARE_ADX(out1, arg1, FQ_MODULUS, FQ_INV);
+}
+
+void pasta_fq_sum_of_products_adx(uint64_t out1[4], const uint64_t arg1[][4], const uint64_t arg2[][4], const size_t n)
+{
+    size_t rows = n;
+    MONT_SUM_OF_PRODUCTS_ADX(out1, arg1, arg2, rows, FQ_MODULUS, FQ_INV);
+}
+
+#else
+
+void pasta_fp_mul_adx(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4])
+{
+    fiat_pasta_fp_mul(out1, arg1, arg2);
+}
+
+void pasta_fp_square_adx(uint64_t out1[4], const uint64_t arg1[4])
+{
+    fiat_pasta_fp_square(out1, arg1);
+}
+
+void pasta_fp_sum_of_products_adx(uint64_t out1[4], const uint64_t arg1[][4], const uint64_t arg2[][4], const size_t n)
+{
+    pasta_fp_sum_of_products_sparse(out1, arg1, arg2, n);
+}
+
+void pasta_fq_mul_adx(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4])
+{
+    fiat_pasta_fq_mul(out1, arg1, arg2);
+}
+
+void pasta_fq_square_adx(uint64_t out1[4], const uint64_t arg1[4])
+{
+    fiat_pasta_fq_square(out1, arg1);
+}
+
+void pasta_fq_sum_of_products_adx(uint64_t out1[4], const uint64_t arg1[][4], const uint64_t arg2[][4], const size_t n)
+{
+    pasta_fq_sum_of_products_sparse(out1, arg1, arg2, n);
+}
+
+#endif
@@ -0,0 +1,21 @@
+// x86-64 MULX/ADCX/ADOX Montgomery arithmetic for the Pasta fields
+//
+//     Drop-in replacements for fiat_pasta_f{p,q}_{mul,square} on CPUs with
+//     BMI2 and ADX.  Same representation, same pre- and postconditions.
+//     Callers must check pasta_adx_supported() first.  The sum_of_products
+//     functions match pasta_f{p,q}_sum_of_products_sparse.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+bool pasta_adx_supported(void);
+
+void pasta_fp_mul_adx(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4]);
+void pasta_fp_square_adx(uint64_t out1[4], const uint64_t arg1[4]);
+void pasta_fp_sum_of_products_adx(uint64_t out1[4], const uint64_t arg1[][4], const uint64_t arg2[][4], const size_t n);
+void pasta_fq_mul_adx(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4]);
+void pasta_fq_square_adx(uint64_t out1[4], const uint64_t arg1[4]);
+void pasta_fq_sum_of_products_adx(uint64_t out1[4], const uint64_t arg1[][4], const uint64_t arg2[][4], const size_t n);
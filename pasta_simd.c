@@ -0,0 +1,385 @@
+// Batched Pasta field multiplication
+//
+//     Each vector lane holds one field element in unsaturated limbs:
+//
+//         AVX-512 IFMA : 8 lanes x 5 limbs of 52 bits (vpmadd52{lo,hi}uq)
+//         AVX2         : 4 lanes x 10 limbs of 26 bits (vpmuludq)
+//
+//     Both layouts are 260 bits wide, so the vector Montgomery reduction
+//     divides by R' = 2^260 while the fiat representation uses R = 2^256.
+//     We compensate by splitting the first operand as 2^4*a, so that
+//     (2^4*aR)(bR)/2^260 = abR.  With a, b < p < 2^255 the reduced result
+//     is below 1.5p and a single conditional subtraction makes it canonical.
+//
+//     Elements that do not fill a whole vector fall back to fiat-crypto.
+
+#include "pasta_simd.h"
+#include "pasta_fp.h"
+#include "pasta_fq.h"
+#include "cpu.h"
+#include "dispatch.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+typedef struct pasta_modulus_t {
+    uint64_t p52[5];
+    uint64_t ninv52; // -p^-1 mod 2^52
+    uint64_t p26[10];
+    uint64_t ninv26; // -p^-1 mod 2^26
+    void (*mul)(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4]);
+} PastaModulus;
+
+// p = 0x40000000000000000000000000000000224698fc094cf91b992d30ed00000001
+static const PastaModulus PASTA_FP = {
+    .p52    = { 0xd30ed00000001, 0xfc094cf91b992, 0x224698, 0x0, 0x400000000000 },
+    .ninv52 = 0xd30ecffffffff,
+    .p26    = { 0x1, 0x34c3b40, 0x391b992, 0x3f02533, 0x224698, 0x0, 0x0, 0x0, 0x0, 0x100000 },
+    .ninv26 = 0x3ffffff,
+    .mul    = fiat_pasta_fp_mul
+};
+
+// q = 0x40000000000000000000000000000000224698fc0994a8dd8c46eb2100000001
+static const PastaModulus PASTA_FQ = {
+    .p52    = { 0x6eb2100000001, 0xfc0994a8dd8c4, 0x224698, 0x0, 0x400000000000 },
+    .ninv52 = 0x6eb20ffffffff,
+    .p26    = { 0x1, 0x1bac840, 0x28dd8c4, 0x3f02652, 0x224698, 0x0, 0x0, 0x0, 0x0, 0x100000 },
+    .ninv26 = 0x3ffffff,
+    .mul    = fiat_pasta_fq_mul
+};
+
+#ifdef HAVE_X86_SIMD
+
+#define IFMA_TARGET __attribute__((target("avx512f,avx512ifma")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+#define IFMA_LANES 8
+#define IFMA_LIMBS 5
+#define IFMA_BITS  52
+
+#define AVX2_LANES 4
+#define AVX2_LIMBS 10
+#define AVX2_BITS  26
+
+// Split 4 saturated words per lane into limbs of the given width, scaling
+// the value by 2^shift on the way (shift < width).  Variable shifts by 64 or
+// more produce zero, which takes care of limbs that sit in a single word.
+IFMA_TARGET
+static void ifma_split(__m512i x[IFMA_LIMBS], const __m512i w[4], const int shift)
+{
+    const __m512i mask = _mm512_set1_epi64((1ULL << IFMA_BITS) - 1);
+    for (int k = 0; k < IFMA_LIMBS; k++) {
+        const int s = IFMA_BITS*k - shift;
+        __m512i v;
+        if (s < 0) {
+            v = _mm512_sllv_epi64(w[0], _mm512_set1_epi64(-s));
+        }
+        else {
+            const int i = s / 64, off = s % 64;
+            v = _mm512_srlv_epi64(w[i], _mm512_set1_epi64(off));
+            if (i + 1 < 4) {
+                v = _mm512_or_si512(v, _mm512_sllv_epi64(w[i + 1], _mm512_set1_epi64(64 - off)));
+            }
+        }
+        x[k] = _mm512_and_si512(v, mask);
+    }
+}
+
+IFMA_TARGET
+static void ifma_join(__m512i w[4], const __m512i x[IFMA_LIMBS])
+{
+    for (int i = 0; i < 4; i++) {
+        w[i] = _mm512_setzero_si512();
+    }
+    for (int k = 0; k < IFMA_LIMBS; k++) {
+        const int i = IFMA_BITS*k / 64, off = IFMA_BITS*k % 64;
+        w[i] = _mm512_or_si512(w[i], _mm512_sllv_epi64(x[k], _mm512_set1_epi64(off)));
+        if (i + 1 < 4) {
+            w[i + 1] = _mm512_or_si512(w[i + 1], _mm512_srlv_epi64(x[k], _mm512_set1_epi64(64 - off)));
+        }
+    }
+}
+
+// out[0..7] = a[0..7]*b[0..7]
+IFMA_TARGET
+static void ifma_mul8(uint64_t out[][4], const uint64_t a[][4], const uint64_t b[][4],
+                      const PastaModulus *m)
+{
+    const __m512i idx  = _mm512_set_epi64(28, 24, 20, 16, 12, 8, 4, 0);
+    const __m512i mask = _mm512_set1_epi64((1ULL << IFMA_BITS) - 1);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i ninv = _mm512_set1_epi64(m->ninv52);
+
+    __m512i aw[4], bw[4], p[IFMA_LIMBS];
+    for (int i = 0; i < 4; i++) {
+        aw[i] = _mm512_i64gather_epi64(idx, (const void *)&a[0][i], 8);
+        bw[i] = _mm512_i64gather_epi64(idx, (const void *)&b[0][i], 8);
+    }
+    for (int j = 0; j < IFMA_LIMBS; j++) {
+        p[j] = _mm512_set1_epi64(m->p52[j]);
+    }
+
+    __m512i x[IFMA_LIMBS], y[IFMA_LIMBS];
+    ifma_split(x, aw, 4);
+    ifma_split(y, bw, 0);
+
+    // Word-by-word Montgomery multiplication; limbs are allowed to grow
+    // past 52 bits (at most ~2^57) and are only normalised at the end.
+    __m512i t[IFMA_LIMBS + 1];
+    for (int j = 0; j <= IFMA_LIMBS; j++) {
+        t[j] = zero;
+    }
+    for (int i = 0; i < IFMA_LIMBS; i++) {
+        for (int j = 0; j < IFMA_LIMBS; j++) {
+            t[j]     = _mm512_madd52lo_epu64(t[j], x[i], y[j]);
+            t[j + 1] = _mm512_madd52hi_epu64(t[j + 1], x[i], y[j]);
+        }
+
+        const __m512i u = _mm512_and_si512(_mm512_madd52lo_epu64(zero, t[0], ninv), mask);
+        for (int j = 0; j < IFMA_LIMBS; j++) {
+            t[j]     = _mm512_madd52lo_epu64(t[j], u, p[j]);
+            t[j + 1] = _mm512_madd52hi_epu64(t[j + 1], u, p[j]);
+        }
+
+        t[1] = _mm512_add_epi64(t[1], _mm512_srli_epi64(t[0], IFMA_BITS));
+        for (int j = 0; j < IFMA_LIMBS; j++) {
+            t[j] = t[j + 1];
+        }
+        t[IFMA_LIMBS] = zero;
+    }
+
+    for (int j = 0; j < IFMA_LIMBS - 1; j++) {
+        t[j + 1] = _mm512_add_epi64(t[j + 1], _mm512_srli_epi64(t[j], IFMA_BITS));
+        t[j] = _mm512_and_si512(t[j], mask);
+    }
+
+    // t < 1.5p, subtract p once if that does not borrow
+    __m512i d[IFMA_LIMBS];
+    __m512i borrow = zero;
+    for (int j = 0; j < IFMA_LIMBS; j++) {
+        d[j] = _mm512_sub_epi64(_mm512_sub_epi64(t[j], p[j]), borrow);
+        borrow = _mm512_srli_epi64(d[j], 63);
+        d[j] = _mm512_and_si512(d[j], mask);
+    }
+    const __mmask8 keep = _mm512_cmpneq_epi64_mask(borrow, zero);
+    for (int j = 0; j < IFMA_LIMBS; j++) {
+        t[j] = _mm512_mask_blend_epi64(keep, d[j], t[j]);
+    }
+
+    __m512i w[4];
+    ifma_join(w, t);
+    for (int i = 0; i < 4; i++) {
+        _mm512_i64scatter_epi64((void *)&out[0][i], idx, w[i], 8);
+    }
+}
+
+AVX2_TARGET
+static void avx2_split(__m256i x[AVX2_LIMBS], const __m256i w[4], const int shift)
+{
+    const __m256i mask = _mm256_set1_epi64x((1ULL << AVX2_BITS) - 1);
+    for (int k = 0; k < AVX2_LIMBS; k++) {
+        const int s = AVX2_BITS*k - shift;
+        __m256i v;
+        if (s < 0) {
+            v = _mm256_sllv_epi64(w[0], _mm256_set1_epi64x(-s));
+        }
+        else {
+            const int i = s / 64, off = s % 64;
+            v = _mm256_srlv_epi64(w[i], _mm256_set1_epi64x(off));
+            if (i + 1 < 4) {
+                v = _mm256_or_si256(v, _mm256_sllv_epi64(w[i + 1], _mm256_set1_epi64x(64 - off)));
+            }
+        }
+        x[k] = _mm256_and_si256(v, mask);
+    }
+}
+
+AVX2_TARGET
+static void avx2_join(__m256i w[4], const __m256i x[AVX2_LIMBS])
+{
+    for (int i = 0; i < 4; i++) {
+        w[i] = _mm256_setzero_si256();
+    }
+    for (int k = 0; k < AVX2_LIMBS; k++) {
+        const int i = AVX2_BITS*k / 64, off = AVX2_BITS*k % 64;
+        w[i] = _mm256_or_si256(w[i], _mm256_sllv_epi64(x[k], _mm256_set1_epi64x(off)));
+        if (i + 1 < 4) {
+            w[i + 1] = _mm256_or_si256(w[i + 1], _mm256_srlv_epi64(x[k], _mm256_set1_epi64x(64 - off)));
+        }
+    }
+}
+
+// 4x4 transpose of 64-bit words: element-major <-> word-major
+AVX2_TARGET
+static void avx2_transpose(__m256i r[4])
+{
+    const __m256i t0 = _mm256_unpacklo_epi64(r[0], r[1]);
+    const __m256i t1 = _mm256_unpackhi_epi64(r[0], r[1]);
+    const __m256i t2 = _mm256_unpacklo_epi64(r[2], r[3]);
+    const __m256i t3 = _mm256_unpackhi_epi64(r[2], r[3]);
+    r[0] = _mm256_permute2x128_si256(t0, t2, 0x20);
+    r[1] = _mm256_permute2x128_si256(t1, t3, 0x20);
+    r[2] = _mm256_permute2x128_si256(t0, t2, 0x31);
+    r[3] = _mm256_permute2x128_si256(t1, t3, 0x31);
+}
+
+// out[0..3] = a[0..3]*b[0..3]
+AVX2_TARGET
+static void avx2_mul4(uint64_t out[][4], const uint64_t a[][4], const uint64_t b[][4],
+                      const PastaModulus *m)
+{
+    const __m256i mask = _mm256_set1_epi64x((1ULL << AVX2_BITS) - 1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ninv = _mm256_set1_epi64x(m->ninv26);
+
+    __m256i aw[4], bw[4], p[AVX2_LIMBS];
+    for (int i = 0; i < 4; i++) {
+        aw[i] = _mm256_loadu_si256((const __m256i *)a[i]);
+        bw[i] = _mm256_loadu_si256((const __m256i *)b[i]);
+    }
+    avx2_transpose(aw);
+    avx2_transpose(bw);
+    for (int j = 0; j < AVX2_LIMBS; j++) {
+        p[j] = _mm256_set1_epi64x(m->p26[j]);
+    }
+
+    __m256i x[AVX2_LIMBS], y[AVX2_LIMBS];
+    avx2_split(x, aw, 4);
+    avx2_split(y, bw, 0);
+
+    // 26x26-bit products fit in a single 64-bit accumulator, so there is no
+    // high half to track; accumulators stay below ~2^57.
+    __m256i t[AVX2_LIMBS];
+    for (int j = 0; j < AVX2_LIMBS; j++) {
+        t[j] = zero;
+    }
+    for (int i = 0; i < AVX2_LIMBS; i++) {
+        for (int j = 0; j < AVX2_LIMBS; j++) {
+            t[j] = _mm256_add_epi64(t[j], _mm256_mul_epu32(x[i], y[j]));
+        }
+
+        const __m256i u = _mm256_and_si256(_mm256_mul_epu32(t[0], ninv), mask);
+        for (int j = 0; j < AVX2_LIMBS; j++) {
+            t[j] = _mm256_add_epi64(t[j], _mm256_mul_epu32(u, p[j]));
+        }
+
+        t[1] = _mm256_add_epi64(t[1], _mm256_srli_epi64(t[0], AVX2_BITS));
+        for (int j = 0; j < AVX2_LIMBS - 1; j++) {
+            t[j] = t[j + 1];
+        }
+        t[AVX2_LIMBS - 1] = zero;
+    }
+
+    for (int j = 0; j < AVX2_LIMBS - 1; j++) {
+        t[j + 1] = _mm256_add_epi64(t[j + 1], _mm256_srli_epi64(t[j], AVX2_BITS));
+        t[j] = _mm256_and_si256(t[j], mask);
+    }
+
+    // t < 1.5p, subtract p once if that does not borrow
+    __m256i d[AVX2_LIMBS];
+    __m256i borrow = zero;
+    for (int j = 0; j < AVX2_LIMBS; j++) {
+        d[j] = _mm256_sub_epi64(_mm256_sub_epi64(t[j], p[j]), borrow);
+        borrow = _mm256_srli_epi64(d[j], 63);
+        d[j] = _mm256_and_si256(d[j], mask);
+    }
+    const __m256i keep = _mm256_sub_epi64(zero, borrow);
+    for (int j = 0; j < AVX2_LIMBS; j++) {
+        t[j] = _mm256_blendv_epi8(d[j], t[j], keep);
+    }
+
+    __m256i w[4];
+    avx2_join(w, t);
+    avx2_transpose(w);
+    for (int i = 0; i < 4; i++) {
+        _mm256_storeu_si256((__m256i *)out[i], w[i]);
+    }
+}
+
+#endif // HAVE_X86_SIMD
+
+bool pasta_simd_supported(const unsigned backend)
+{
+    switch (backend) {
+        case PASTA_SIMD_GENERIC:
+            return true;
+#ifdef HAVE_X86_SIMD
+        case PASTA_SIMD_AVX2:
+            return cpu_has(CPU_FEATURE_AVX2);
+        case PASTA_SIMD_IFMA:
+            return cpu_has(CPU_FEATURE_AVX512F | CPU_FEATURE_AVX512IFMA);
+#endif
+        default:
+            return false;
+    }
+}
+
+unsigned pasta_simd_backend(void)
+{
+    if (pasta_simd_supported(PASTA_SIMD_IFMA)) {
+        return PASTA_SIMD_IFMA;
+    }
+    if (pasta_simd_supported(PASTA_SIMD_AVX2)) {
+        return PASTA_SIMD_AVX2;
+    }
+    return PASTA_SIMD_GENERIC;
+}
+
+static void mul_batch(const unsigned backend, uint64_t out[][4], const uint64_t a[][4],
+                      const uint64_t b[][4], const size_t n, const PastaModulus *m)
+{
+    size_t i = 0;
+
+#ifdef HAVE_X86_SIMD
+    if (backend == PASTA_SIMD_IFMA) {
+        for (; i + IFMA_LANES <= n; i += IFMA_LANES) {
+            ifma_mul8(&out[i], &a[i], &b[i], m);
+        }
+    }
+    else if (backend == PASTA_SIMD_AVX2) {
+        for (; i + AVX2_LANES <= n; i += AVX2_LANES) {
+            avx2_mul4(&out[i], &a[i], &b[i], m);
+        }
+    }
+#else
+    (void)backend;
+#endif
+
+    for (; i < n; i++) {
+        m->mul(out[i], a[i], b[i]);
+    }
+}
+
+void pasta_fp_mul_batch_with(const unsigned backend, uint64_t out[][4], const uint64_t a[][4],
+                             const uint64_t b[][4], const size_t n)
+{
+    mul_batch(backend, out, a, b, n, &PASTA_FP);
+}
+
+void pasta_fq_mul_batch_with(const unsigned backend, uint64_t out[][4], const uint64_t a[][4],
+                             const uint64_t b[][4], const size_t n)
+{
+    mul_batch(backend, out, a, b, n, &PASTA_FQ);
+}
+
+void pasta_fp_mul_batch(uint64_t out[][4], const uint64_t a[][4], const uint64_t b[][4], const size_t n)
+{
+    mul_batch(dispatch.field_batch, out, a, b, n, &PASTA_FP);
+}
+
+void pasta_fp_square_batch(uint64_t out[][4], const uint64_t a[][4], const size_t n)
+{
+    mul_batch(dispatch.field_batch, out, a, a, n, &PASTA_FP);
+}
+
+void pasta_fq_mul_batch(uint64_t out[][4], const uint64_t a[][4], const uint64_t b[][4], const size_t n)
+{
+    mul_batch(dispatch.field_batch, out, a, b, n, &PASTA_FQ);
+}
+
+void pasta_fq_square_batch(uint64_t out[][4], const uint64_t a[][4], const size_t n)
+{
+    mul_batch(dispatch.field_batch, out, a, a, n, &PASTA_FQ);
+}
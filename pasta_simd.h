@@ -0,0 +1,28 @@
+// Batched Pasta field multiplication
+//
+//     Multiplies n independent pairs of elements, out[i] = a[i]*b[i], using
+//     the widest vector unit available.  Elements use the same saturated
+//     Montgomery representation as pasta_fp.c/pasta_fq.c and out may alias
+//     a or b.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PASTA_SIMD_GENERIC 0 // fiat-crypto, one element at a time
+#define PASTA_SIMD_AVX2    1 // 4 lanes, radix 2^26
+#define PASTA_SIMD_IFMA    2 // 8 lanes, radix 2^52 (AVX-512 IFMA)
+
+unsigned pasta_simd_backend(void);
+bool pasta_simd_supported(const unsigned backend);
+
+void pasta_fp_mul_batch(uint64_t out[][4], const uint64_t a[][4], const uint64_t b[][4], const size_t n);
+void pasta_fp_square_batch(uint64_t out[][4], const uint64_t a[][4], const size_t n);
+void pasta_fq_mul_batch(uint64_t out[][4], const uint64_t a[][4], const uint64_t b[][4], const size_t n);
+void pasta_fq_square_batch(uint64_t out[][4], const uint64_t a[][4], const size_t n);
+
+// Same as above with an explicit backend, for differential testing
+void pasta_fp_mul_batch_with(const unsigned backend, uint64_t out[][4], const uint64_t a[][4], const uint64_t b[][4], const size_t n);
+void pasta_fq_mul_batch_with(const unsigned backend, uint64_t out[][4], const uint64_t a[][4], const uint64_t b[][4], const size_t n);
@@ -0,0 +1,195 @@
+// Sparse-modulus Montgomery arithmetic for the Pasta fields
+//
+//     Both moduli have the shape p = 2^254 + c with c < 2^126, so in words
+//     p = (c0, c1, 0, 2^62).  A Montgomery reduction step adds m*p to the
+//     accumulator; with this shape that is two 64x64 multiplications
+//     (m*c0, m*c1), nothing for the zero word and a pair of shifts for the
+//     2^254 term (m << 62 into word 3, m >> 2 into word 4), instead of the
+//     four full multiplications the generic fiat code performs.
+//
+//     Products use operand scanning into an 8-word buffer followed by the
+//     reduction (SOS).  Sums of up to three products share the buffer and
+//     are reduced once.  Everything is straight-line and branch free, like
+//     the fiat code it replaces.
+
+#include <stddef.h>
+
+#include "pasta_sparse.h"
+
+typedef unsigned __int128 uint128_t;
+
+typedef struct {
+    uint64_t c0, c1; // p = 2^254 + c1*2^64 + c0
+    uint64_t inv;    // -p^-1 mod 2^64
+    uint64_t r2[4];  // 2^512 mod p
+} SparseModulus;
+
+static const SparseModulus FP = {
+    0x992d30ed00000001, 0x224698fc094cf91b,
+    0x992d30ecffffffff,
+    { 0x8c78ecb30000000f, 0xd7d30dbd8b0de0e7, 0x7797a99bc3c95d18, 0x096d41af7b9cb714 }
+};
+
+static const SparseModulus FQ = {
+    0x8c46eb2100000001, 0x224698fc0994a8dd,
+    0x8c46eb20ffffffff,
+    { 0xfc9678ff0000000f, 0x67bb433d891a16e3, 0x7fae231004ccf590, 0x096d41af7ccfdaa9 }
+};
+
+// out = t / 2^256 mod p, for t < 2^256 * p
+static void redc(uint64_t out[4], uint64_t t[8], const SparseModulus *p)
+{
+    uint64_t carry = 0;
+    for (size_t i = 0; i < 4; i++) {
+        const uint64_t m = t[i] * p->inv;
+
+        // The low word of t[i] + m*c0 is zero by construction
+        uint128_t acc = ((uint128_t)m * p->c0 + t[i]) >> 64;
+        acc += (uint128_t)m * p->c1 + t[i + 1];
+        t[i + 1] = (uint64_t)acc;
+        acc = (acc >> 64) + t[i + 2];
+        t[i + 2] = (uint64_t)acc;
+        acc = (acc >> 64) + t[i + 3] + (m << 62);
+        t[i + 3] = (uint64_t)acc;
+        acc = (acc >> 64) + t[i + 4] + (m >> 2) + carry;
+        t[i + 4] = (uint64_t)acc;
+        carry = (uint64_t)(acc >> 64);
+    }
+
+    // Result is t[4..7] < 2p (carry is zero), subtract p once if possible
+    uint64_t r[4];
+    uint128_t diff = (uint128_t)t[4] - p->c0;
+    r[0] = (uint64_t)diff;
+    diff = (uint128_t)t[5] - p->c1 - (uint64_t)(diff >> 127);
+    r[1] = (uint64_t)diff;
+    diff = (uint128_t)t[6] - (uint64_t)(diff >> 127);
+    r[2] = (uint64_t)diff;
+    diff = (uint128_t)t[7] - ((uint64_t)1 << 62) - (uint64_t)(diff >> 127);
+    r[3] = (uint64_t)diff;
+
+    // All ones if the subtraction borrowed, keep t in that case
+    const uint64_t keep = -(uint64_t)(diff >> 127);
+    for (size_t i = 0; i < 4; i++) {
+        out[i] = (t[i + 4] & keep) | (r[i] & ~keep);
+    }
+}
+
+// t += a*b, for t + a*b < 2^512
+static void mul_acc(uint64_t t[8], const uint64_t a[4], const uint64_t b[4])
+{
+    for (size_t i = 0; i < 4; i++) {
+        uint128_t acc = 0;
+        for (size_t j = 0; j < 4; j++) {
+            acc += (uint128_t)a[i] * b[j] + t[i + j];
+            t[i + j] = (uint64_t)acc;
+            acc >>= 64;
+        }
+        for (size_t j = i + 4; j < 8; j++) {
+            acc += t[j];
+            t[j] = (uint64_t)acc;
+            acc >>= 64;
+        }
+    }
+}
+
+static void mont_mul(uint64_t out[4], const uint64_t a[4], const uint64_t b[4], const SparseModulus *p)
+{
+    uint64_t t[8] = { 0 };
+    mul_acc(t, a, b);
+    redc(out, t, p);
+}
+
+// The products are accumulated unreduced, 3p^2 < 2^256 * p keeps the
+// single reduction within its bounds
+static void mont_sum_of_products(uint64_t out[4], const uint64_t a[][4], const uint64_t b[][4], const size_t n, const SparseModulus *p)
+{
+    uint64_t t[8] = { 0 };
+    for (size_t i = 0; i < n; i++) {
+        mul_acc(t, a[i], b[i]);
+    }
+    redc(out, t, p);
+}
+
+static void mont_square(uint64_t out[4], const uint64_t a[4], const SparseModulus *p)
+{
+    uint64_t t[8] = { 0 };
+
+    // Cross products a[i]*a[j], i < j
+    for (size_t i = 0; i < 3; i++) {
+        uint128_t acc = 0;
+        for (size_t j = i + 1; j < 4; j++) {
+            acc += (uint128_t)a[i] * a[j] + t[i + j];
+            t[i + j] = (uint64_t)acc;
+            acc >>= 64;
+        }
+        t[i + 4] = (uint64_t)acc;
+    }
+
+    // Double them and add the squares
+    uint128_t acc = 0;
+    for (size_t i = 0; i < 4; i++) {
+        const uint128_t sq = (uint128_t)a[i] * a[i];
+        acc += (uint128_t)(uint64_t)sq + ((uint128_t)t[2*i] << 1);
+        t[2*i] = (uint64_t)acc;
+        acc = (acc >> 64) + (uint64_t)(sq >> 64) + ((uint128_t)t[2*i + 1] << 1);
+        t[2*i + 1] = (uint64_t)acc;
+        acc >>= 64;
+    }
+    redc(out, t, p);
+}
+
+static void from_montgomery(uint64_t out[4], const uint64_t a[4], const SparseModulus *p)
+{
+    uint64_t t[8] = { a[0], a[1], a[2], a[3], 0, 0, 0, 0 };
+    redc(out, t, p);
+}
+
+void pasta_fp_mul_sparse(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4])
+{
+    mont_mul(out1, arg1, arg2, &FP);
+}
+
+void pasta_fp_square_sparse(uint64_t out1[4], const uint64_t arg1[4])
+{
+    mont_square(out1, arg1, &FP);
+}
+
+void pasta_fp_sum_of_products_sparse(uint64_t out1[4], const uint64_t arg1[][4], const uint64_t arg2[][4], const size_t n)
+{
+    mont_sum_of_products(out1, arg1, arg2, n, &FP);
+}
+
+void pasta_fp_to_montgomery_sparse(uint64_t out1[4], const uint64_t arg1[4])
+{
+    mont_mul(out1, arg1, FP.r2, &FP);
+}
+
+void pasta_fp_from_montgomery_sparse(uint64_t out1[4], const uint64_t arg1[4])
+{
+    from_montgomery(out1, arg1, &FP);
+}
+
+void pasta_fq_mul_sparse(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4])
+{
+    mont_mul(out1, arg1, arg2, &FQ);
+}
+
+void pasta_fq_square_sparse(uint64_t out1[4], const uint64_t arg1[4])
+{
+    mont_square(out1, arg1, &FQ);
+}
+
+void pasta_fq_sum_of_products_sparse(uint64_t out1[4], const uint64_t arg1[][4], const uint64_t arg2[][4], const size_t n)
+{
+    mont_sum_of_products(out1, arg1, arg2, n, &FQ);
+}
+
+void pasta_fq_to_montgomery_sparse(uint64_t out1[4], const uint64_t arg1[4])
+{
+    mont_mul(out1, arg1, FQ.r2, &FQ);
+}
+
+void pasta_fq_from_montgomery_sparse(uint64_t out1[4], const uint64_t arg1[4])
+{
+    from_montgomery(out1, arg1, &FQ);
+}
@@ -0,0 +1,26 @@
+// Sparse-modulus Montgomery arithmetic for the Pasta fields
+//
+//     Portable replacements for fiat_pasta_f{p,q}_{mul,square,to_montgomery,
+//     from_montgomery}.  Same representation, same pre- and postconditions.
+//
+//     The sum_of_products functions compute out = sum arg1[i]*arg2[i] with a
+//     single Montgomery reduction for n <= PASTA_SUM_OF_PRODUCTS_MAX.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PASTA_SUM_OF_PRODUCTS_MAX 3
+
+void pasta_fp_mul_sparse(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4]);
+void pasta_fp_square_sparse(uint64_t out1[4], const uint64_t arg1[4]);
+void pasta_fp_sum_of_products_sparse(uint64_t out1[4], const uint64_t arg1[][4], const uint64_t arg2[][4], const size_t n);
+void pasta_fp_to_montgomery_sparse(uint64_t out1[4], const uint64_t arg1[4]);
+void pasta_fp_from_montgomery_sparse(uint64_t out1[4], const uint64_t arg1[4]);
+
+void pasta_fq_mul_sparse(uint64_t out1[4], const uint64_t arg1[4], const uint64_t arg2[4]);
+void pasta_fq_square_sparse(uint64_t out1[4], const uint64_t arg1[4]);
+void pasta_fq_sum_of_products_sparse(uint64_t out1[4], const uint64_t arg1[][4], const uint64_t arg2[][4], const size_t n);
+void pasta_fq_to_montgomery_sparse(uint64_t out1[4], const uint64_t arg1[4]);
+void pasta_fq_from_montgomery_sparse(uint64_t out1[4], const uint64_t arg1[4]);
@@ -12,6 +12,7 @@
 #include "crypto.h"
 #include "pasta_fp.h"
 #include "pasta_fq.h"
+#include "pasta_sparse.h"
 #include "poseidon.h"
 #include "poseidon_params_legacy.h"
 #include "poseidon_params_kimchi.h"
@@ -22,18 +23,10 @@
 
 static void matrix_mul(State s1, const Field **m, const size_t width)
 {
-    Field tmp;
-
     State s2;
-    bzero(s2, sizeof(s2));
     for (size_t row = 0; row < width; row++) {
-        // Inner product
-        for (size_t col = 0; col < width; col++) {
-            Field t0;
-            field_mul(t0, s1[col], MATRIX_ELT(m, row, col, width));
-            field_copy(tmp, s2[row]);
-            field_add(s2[row], tmp, t0);
-        }
+        // Inner product, reduced once
+        field_sum_of_products(s2[row], s1, &MATRIX_ELT(m, row, 0, width), width);
     }
 
     for (size_t col = 0; col < width; col++) {
@@ -44,20 +37,16 @@ static void matrix_mul(State s1, const Field **m, const size_t width)
 // Legacy poseidon permutation function
 static void permutation_legacy(PoseidonCtx *ctx)
 {
-    Field tmp;
-
     // Full rounds only
     for (size_t r = 0; r < ctx->full_rounds; r++) {
         // ark
         for (size_t i = 0; i < ctx->sponge_width; i++) {
-            field_copy(tmp, ctx->state[i]);
-            field_add(ctx->state[i], tmp, ROUND_KEY(ctx, r, i));
+            field_add(ctx->state[i], ctx->state[i], ROUND_KEY(ctx, r, i));
         }
 
         // sbox
         for (size_t i = 0; i < ctx->sponge_width; i++) {
-            field_copy(tmp, ctx->state[i]);
-            field_pow(ctx->state[i], tmp, ctx->sbox_alpha);
+            field_pow(ctx->state[i], ctx->state[i], ctx->sbox_alpha);
         }
 
         // mds
@@ -66,22 +55,18 @@ static void permutation_legacy(PoseidonCtx *ctx)
 
     // Final ark
     for (size_t i = 0; i < ctx->sponge_width; i++) {
-        field_copy(tmp, ctx->state[i]);
-        field_add(ctx->state[i], tmp, ROUND_KEY(ctx, ctx->full_rounds, i));
+        field_add(ctx->state[i], ctx->state[i], ROUND_KEY(ctx, ctx->full_rounds, i));
     }
 }
 
 // Kimchi poseidon permutation function
 static void permutation_kimchi(PoseidonCtx *ctx)
 {
-    Field tmp;
-
     // Full rounds only
     for (size_t r = 0; r < ctx->full_rounds; r++) {
         // sbox
         for (unsigned int i = 0; i < ctx->sponge_width; i++) {
-            field_copy(tmp, ctx->state[i]);
-            field_pow(ctx->state[i], tmp, ctx->sbox_alpha);
+            field_pow(ctx->state[i], ctx->state[i], ctx->sbox_alpha);
         }
 
         // mds
@@ -89,8 +74,7 @@ static void permutation_kimchi(PoseidonCtx *ctx)
 
         // ark
         for (unsigned int i = 0; i < ctx->sponge_width; i++) {
-            field_copy(tmp, ctx->state[i]);
-            field_add(ctx->state[i], tmp, ROUND_KEY(ctx, r, i));
+            field_add(ctx->state[i], ctx->state[i], ROUND_KEY(ctx, r, i));
         }
     }
 }
@@ -175,27 +159,156 @@ bool poseidon_init(PoseidonCtx *ctx, const uint8_t type, const uint8_t network_i
 
 void poseidon_update(PoseidonCtx *ctx, const Field *input, size_t len)
 {
-    Field tmp;
     for (size_t i = 0; i < len; i++) {
         if (ctx->absorbed == ctx->sponge_rate) {
             ctx->permutation(ctx);
             ctx->absorbed = 0;
         }
-        field_copy(tmp, ctx->state[ctx->absorbed]);
-        field_add(ctx->state[ctx->absorbed], tmp, input[i]);
+        field_add(ctx->state[ctx->absorbed], ctx->state[ctx->absorbed], input[i]);
         ctx->absorbed++;
     }
 }
 
-// Squeezing poseidon returns the first element of its current state.
-void poseidon_digest(Scalar out, PoseidonCtx *ctx) {
-    ctx->permutation(ctx);
-
+static void squeeze(Scalar out, const PoseidonCtx *ctx)
+{
     uint64_t tmp[4];
-    fiat_pasta_fp_from_montgomery(tmp, ctx->state[0]);
+    pasta_fp_from_montgomery_sparse(tmp, ctx->state[0]);
 
     // since the difference in modulus between the two fields is < 2^125,
     // with high probability, a random value from one field will fit in the
     // other field.
-    fiat_pasta_fq_to_montgomery(out, tmp);
-}
\ No newline at end of file
+    pasta_fq_to_montgomery_sparse(out, tmp);
+}
+
+// Squeezing poseidon returns the first element of its current state.
+void poseidon_digest(Scalar out, PoseidonCtx *ctx) {
+    ctx->permutation(ctx);
+    squeeze(out, ctx);
+}
+
+#define POSEIDON_BATCH_LANES 8
+
+static void ark_batch(Field *s, const PoseidonCtx *ctx, const size_t n, const size_t round)
+{
+    for (size_t l = 0; l < n; l++) {
+        for (size_t i = 0; i < ctx->sponge_width; i++) {
+            field_add(s[l*ctx->sponge_width + i], s[l*ctx->sponge_width + i], ROUND_KEY(ctx, round, i));
+        }
+    }
+}
+
+// x^alpha by square and multiply, skipping the leading one bit
+static void sbox_batch(Field *s, const size_t count, const uint8_t alpha)
+{
+    Field x[POSEIDON_BATCH_LANES*MAX_SPONGE_WIDTH];
+    memcpy(x, s, count*sizeof(Field));
+
+    int bit = 7;
+    while (bit > 0 && !(alpha >> bit)) {
+        bit--;
+    }
+    while (bit-- > 0) {
+        field_sq_batch(s, s, count);
+        if (alpha & (1 << bit)) {
+            field_mul_batch(s, s, x, count);
+        }
+    }
+}
+
+// m holds each MDS row replicated once per lane
+static void matrix_mul_batch(Field *s, const Field m[][POSEIDON_BATCH_LANES*MAX_SPONGE_WIDTH],
+                             const size_t n, const size_t width)
+{
+    Field t[POSEIDON_BATCH_LANES*MAX_SPONGE_WIDTH];
+    Field u[POSEIDON_BATCH_LANES*MAX_SPONGE_WIDTH];
+
+    for (size_t row = 0; row < width; row++) {
+        field_mul_batch(t, s, m[row], n*width);
+        for (size_t l = 0; l < n; l++) {
+            field_copy(u[l*width + row], t[l*width]);
+            for (size_t col = 1; col < width; col++) {
+                field_add(u[l*width + row], u[l*width + row], t[l*width + col]);
+            }
+        }
+    }
+
+    memcpy(s, u, n*width*sizeof(Field));
+}
+
+// Runs the permutation of n sponges of the same type in lock-step so that
+// the sbox and MDS multiplications of all lanes go through the batched
+// field kernels
+static void permutation_batch(PoseidonCtx *ctx, const size_t n)
+{
+    const size_t width = ctx->sponge_width;
+    Field s[POSEIDON_BATCH_LANES*MAX_SPONGE_WIDTH];
+    Field m[MAX_SPONGE_WIDTH][POSEIDON_BATCH_LANES*MAX_SPONGE_WIDTH];
+
+    for (size_t l = 0; l < n; l++) {
+        memcpy(s[l*width], ctx[l].state, SPONGE_BYTES(width));
+    }
+    for (size_t row = 0; row < width; row++) {
+        for (size_t l = 0; l < n; l++) {
+            for (size_t col = 0; col < width; col++) {
+                field_copy(m[row][l*width + col], MATRIX_ELT(ctx->mds_matrix, row, col, width));
+            }
+        }
+    }
+
+    if (ctx->permutation == permutation_legacy) {
+        for (size_t r = 0; r < ctx->full_rounds; r++) {
+            ark_batch(s, ctx, n, r);
+            sbox_batch(s, n*width, ctx->sbox_alpha);
+            matrix_mul_batch(s, m, n, width);
+        }
+        ark_batch(s, ctx, n, ctx->full_rounds);
+    }
+    else {
+        for (size_t r = 0; r < ctx->full_rounds; r++) {
+            sbox_batch(s, n*width, ctx->sbox_alpha);
+            matrix_mul_batch(s, m, n, width);
+            ark_batch(s, ctx, n, r);
+        }
+    }
+
+    for (size_t l = 0; l < n; l++) {
+        memcpy(ctx[l].state, s[l*width], SPONGE_BYTES(width));
+    }
+}
+
+// Hashes n inputs of len field elements each, stored back to back, and is
+// equivalent to n rounds of poseidon_init/poseidon_update/poseidon_digest.
+bool poseidon_hash_batch(Scalar *out, const uint8_t type, const uint8_t network_id,
+                         const Field *inputs, const size_t len, const size_t n)
+{
+    PoseidonCtx ctx[POSEIDON_BATCH_LANES];
+
+    for (size_t base = 0; base < n; base += POSEIDON_BATCH_LANES) {
+        const size_t lanes = n - base < POSEIDON_BATCH_LANES ? n - base : POSEIDON_BATCH_LANES;
+
+        for (size_t l = 0; l < lanes; l++) {
+            if (!poseidon_init(&ctx[l], type, network_id)) {
+                return false;
+            }
+        }
+
+        size_t absorbed = 0;
+        for (size_t i = 0; i < len; i++) {
+            if (absorbed == ctx->sponge_rate) {
+                permutation_batch(ctx, lanes);
+                absorbed = 0;
+            }
+            for (size_t l = 0; l < lanes; l++) {
+                field_add(ctx[l].state[absorbed], ctx[l].state[absorbed], inputs[(base + l)*len + i]);
+            }
+            absorbed++;
+        }
+
+        permutation_batch(ctx, lanes);
+        for (size_t l = 0; l < lanes; l++) {
+            squeeze(out[base + l], &ctx[l]);
+        }
+    }
+
+    return true;
+}
@@ -43,4 +43,6 @@ typedef struct poseidon_context_t {
 
 bool poseidon_init(PoseidonCtx *ctx, const uint8_t type, const uint8_t network_id);
 void poseidon_update(PoseidonCtx *ctx, const Field *input, size_t len);
-void poseidon_digest(Scalar out, PoseidonCtx *ctx);
\ No newline at end of file
+void poseidon_digest(Scalar out, PoseidonCtx *ctx);
+bool poseidon_hash_batch(Scalar *out, const uint8_t type, const uint8_t network_id,
+                         const Field *inputs, const size_t len, const size_t n);
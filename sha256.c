@@ -17,6 +17,8 @@
 #include <stdlib.h>
 #include <memory.h>
 #include "sha256.h"
+#include "sha256_simd.h"
+#include "dispatch.h"
 
 /****************************** MACROS ******************************/
 #define ROTLEFT(a,b) (((a) << (b)) | ((a) >> (32-(b))))
@@ -42,45 +44,83 @@ static const WORD k[64] = {
 };
 
 /*********************** FUNCTION DEFINITIONS ***********************/
-void sha256_transform(SHA256_CTX *ctx, const BYTE data[])
+// Big endian word access.  Spelled out byte by byte, GCC vectorizes the
+// digest stores into a long shuffle sequence, so use a byte swap instead.
+static WORD sha256_load_be(const BYTE in[4])
+{
+	WORD w;
+	memcpy(&w, in, 4);
+	return __builtin_bswap32(w);
+}
+
+static void sha256_store_be(BYTE out[4], WORD w)
+{
+	w = __builtin_bswap32(w);
+	memcpy(out, &w, 4);
+}
+
+static void sha256_compress_generic(WORD state[8], const BYTE data[], size_t blocks)
 {
 	WORD a, b, c, d, e, f, g, h, i, j, t1, t2, m[64];
 
-	for (i = 0, j = 0; i < 16; ++i, j += 4)
-		m[i] = (data[j] << 24) | (data[j + 1] << 16) | (data[j + 2] << 8) | (data[j + 3]);
-	for ( ; i < 64; ++i)
-		m[i] = SIG1(m[i - 2]) + m[i - 7] + SIG0(m[i - 15]) + m[i - 16];
+	for ( ; blocks > 0; --blocks, data += 64) {
+		for (i = 0, j = 0; i < 16; ++i, j += 4)
+			m[i] = (data[j] << 24) | (data[j + 1] << 16) | (data[j + 2] << 8) | (data[j + 3]);
+		for ( ; i < 64; ++i)
+			m[i] = SIG1(m[i - 2]) + m[i - 7] + SIG0(m[i - 15]) + m[i - 16];
 
-	a = ctx->state[0];
-	b = ctx->state[1];
-	c = ctx->state[2];
-	d = ctx->state[3];
-	e = ctx->state[4];
-	f = ctx->state[5];
-	g = ctx->state[6];
-	h = ctx->state[7];
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
 
-	for (i = 0; i < 64; ++i) {
-		t1 = h + EP1(e) + CH(e,f,g) + k[i] + m[i];
-		t2 = EP0(a) + MAJ(a,b,c);
-		h = g;
-		g = f;
-		f = e;
-		e = d + t1;
-		d = c;
-		c = b;
-		b = a;
-		a = t1 + t2;
+		for (i = 0; i < 64; ++i) {
+			t1 = h + EP1(e) + CH(e,f,g) + k[i] + m[i];
+			t2 = EP0(a) + MAJ(a,b,c);
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
 	}
+}
+
+// Compresses blocks consecutive 64 byte blocks into state.  Only SHA-NI has
+// a single message kernel, every other backend uses the portable code.
+static void sha256_compress(unsigned backend, WORD state[8], const BYTE data[], size_t blocks)
+{
+	if (backend == SHA256_SIMD_SHANI)
+		sha256_compress_shani(state, data, blocks);
+	else
+		sha256_compress_generic(state, data, blocks);
+}
 
-	ctx->state[0] += a;
-	ctx->state[1] += b;
-	ctx->state[2] += c;
-	ctx->state[3] += d;
-	ctx->state[4] += e;
-	ctx->state[5] += f;
-	ctx->state[6] += g;
-	ctx->state[7] += h;
+// Backend for single messages, only SHA-NI differs from the portable code
+static unsigned sha256_backend(void)
+{
+	return dispatch.sha256;
+}
+
+void sha256_transform(SHA256_CTX *ctx, const BYTE data[])
+{
+	sha256_compress(sha256_backend(), ctx->state, data, 1);
 }
 
 void sha256_init(SHA256_CTX *ctx)
@@ -97,22 +137,44 @@ void sha256_init(SHA256_CTX *ctx)
 	ctx->state[7] = 0x5be0cd19;
 }
 
-void sha256_update(SHA256_CTX *ctx, const BYTE data[], size_t len)
+static void sha256_update_with(unsigned backend, SHA256_CTX *ctx, const BYTE data[], size_t len)
 {
-	WORD i;
+	size_t n, blocks;
 
-	for (i = 0; i < len; ++i) {
-		ctx->data[ctx->datalen] = data[i];
-		ctx->datalen++;
-		if (ctx->datalen == 64) {
-			sha256_transform(ctx, ctx->data);
-			ctx->bitlen += 512;
-			ctx->datalen = 0;
-		}
+	// Top up a partial block first
+	if (ctx->datalen > 0) {
+		n = 64 - ctx->datalen < len ? 64 - ctx->datalen : len;
+		memcpy(&ctx->data[ctx->datalen], data, n);
+		ctx->datalen += n;
+		data += n;
+		len -= n;
+		if (ctx->datalen < 64)
+			return;
+		sha256_compress(backend, ctx->state, ctx->data, 1);
+		ctx->bitlen += 512;
+		ctx->datalen = 0;
 	}
+
+	// Whole blocks are compressed straight from the input
+	blocks = len / 64;
+	if (blocks > 0) {
+		sha256_compress(backend, ctx->state, data, blocks);
+		ctx->bitlen += 512ull * blocks;
+		data += 64 * blocks;
+		len -= 64 * blocks;
+	}
+
+	if (len > 0)
+		memcpy(ctx->data, data, len);
+	ctx->datalen = len;
 }
 
-void sha256_final(SHA256_CTX *ctx, BYTE hash[])
+void sha256_update(SHA256_CTX *ctx, const BYTE data[], size_t len)
+{
+	sha256_update_with(sha256_backend(), ctx, data, len);
+}
+
+static void sha256_final_with(unsigned backend, SHA256_CTX *ctx, BYTE hash[])
 {
 	WORD i;
 
@@ -121,14 +183,12 @@ void sha256_final(SHA256_CTX *ctx, BYTE hash[])
 	// Pad whatever data is left in the buffer.
 	if (ctx->datalen < 56) {
 		ctx->data[i++] = 0x80;
-		while (i < 56)
-			ctx->data[i++] = 0x00;
+		memset(&ctx->data[i], 0, 56 - i);
 	}
 	else {
 		ctx->data[i++] = 0x80;
-		while (i < 64)
-			ctx->data[i++] = 0x00;
-		sha256_transform(ctx, ctx->data);
+		memset(&ctx->data[i], 0, 64 - i);
+		sha256_compress(backend, ctx->state, ctx->data, 1);
 		memset(ctx->data, 0, 56);
 	}
 
@@ -142,20 +202,25 @@ void sha256_final(SHA256_CTX *ctx, BYTE hash[])
 	ctx->data[58] = ctx->bitlen >> 40;
 	ctx->data[57] = ctx->bitlen >> 48;
 	ctx->data[56] = ctx->bitlen >> 56;
-	sha256_transform(ctx, ctx->data);
+	sha256_compress(backend, ctx->state, ctx->data, 1);
 
 	// Since this implementation uses little endian byte ordering and SHA uses big endian,
 	// reverse all the bytes when copying the final state to the output hash.
-	for (i = 0; i < 4; ++i) {
-		hash[i]      = (ctx->state[0] >> (24 - i * 8)) & 0x000000ff;
-		hash[i + 4]  = (ctx->state[1] >> (24 - i * 8)) & 0x000000ff;
-		hash[i + 8]  = (ctx->state[2] >> (24 - i * 8)) & 0x000000ff;
-		hash[i + 12] = (ctx->state[3] >> (24 - i * 8)) & 0x000000ff;
-		hash[i + 16] = (ctx->state[4] >> (24 - i * 8)) & 0x000000ff;
-		hash[i + 20] = (ctx->state[5] >> (24 - i * 8)) & 0x000000ff;
-		hash[i + 24] = (ctx->state[6] >> (24 - i * 8)) & 0x000000ff;
-		hash[i + 28] = (ctx->state[7] >> (24 - i * 8)) & 0x000000ff;
-	}
+	for (i = 0; i < 8; ++i)
+		sha256_store_be(&hash[4 * i], ctx->state[i]);
+}
+
+void sha256_final(SHA256_CTX *ctx, BYTE hash[])
+{
+	sha256_final_with(sha256_backend(), ctx, hash);
+}
+
+void sha256_hash_with(const unsigned backend, const void *in, const size_t in_len, void *out)
+{
+	SHA256_CTX sha256_ctx;
+	sha256_init(&sha256_ctx);
+	sha256_update_with(backend, &sha256_ctx, (const BYTE *)in, in_len);
+	sha256_final_with(backend, &sha256_ctx, (BYTE *)out);
 }
 
 void sha256_hash(const void *in, const size_t in_len, void *out, size_t out_len)
@@ -164,8 +229,150 @@ void sha256_hash(const void *in, const size_t in_len, void *out, size_t out_len)
 		return;
 	}
 
-	SHA256_CTX sha256_ctx;
-	sha256_init(&sha256_ctx);
-	sha256_update(&sha256_ctx, (const BYTE *)in, in_len);
-	sha256_final(&sha256_ctx, (BYTE *)out);
-}
\ No newline at end of file
+	sha256_hash_with(sha256_backend(), in, in_len, out);
+}
+
+/*********************** MULTI-BUFFER HASHING ***********************/
+// Messages of equal length are hashed SHA256_LANES at a time.  Each word of
+// the state and the schedule is a vector holding that word for every lane,
+// so the rounds below are the single-message rounds on vectors, lowered to
+// whatever SIMD the target has (SSE2 on any x86-64).  The AVX2 backend runs
+// the same lanes through one 256-bit register per word.  SHA-NI is faster
+// still and hashes two messages at a time.
+
+typedef WORD LANES __attribute__((vector_size(4 * SHA256_LANES)));
+
+static void sha256_transform_lanes(LANES state[8], LANES m[64])
+{
+	LANES a, b, c, d, e, f, g, h, t1, t2;
+	size_t i;
+
+	for (i = 16; i < 64; ++i)
+		m[i] = SIG1(m[i - 2]) + m[i - 7] + SIG0(m[i - 15]) + m[i - 16];
+
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
+
+	for (i = 0; i < 64; ++i) {
+		t1 = h + EP1(e) + CH(e,f,g) + k[i] + m[i];
+		t2 = EP0(a) + MAJ(a,b,c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+// Block number block of the padded message, which is blocks * 64 bytes long
+static void sha256_padded_block(BYTE out[64], const BYTE *msg, size_t len, size_t blocks, size_t block)
+{
+	size_t pos = block * 64, i;
+
+	memset(out, 0, 64);
+	if (pos < len)
+		memcpy(out, &msg[pos], len - pos < 64 ? len - pos : 64);
+	if (len >= pos && len < pos + 64)
+		out[len - pos] = 0x80;
+	if (block == blocks - 1)
+		for (i = 0; i < 8; ++i)
+			out[63 - i] = (BYTE)(((unsigned long long)len * 8) >> (8 * i));
+}
+
+static const WORD sha256_init_state[8] = {
+	0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19
+};
+
+static void sha256_hash_lanes(const unsigned backend, const BYTE *in, size_t in_stride, size_t in_len, BYTE *out, size_t n)
+{
+	LANES state[8];
+	LANES m[64];
+	BYTE data[64];
+	size_t blocks = (in_len + 9 + 63) / 64;
+	size_t first, lanes, block, i, l;
+
+	for (first = 0; first < n; first += SHA256_LANES) {
+		lanes = n - first < SHA256_LANES ? n - first : SHA256_LANES;
+
+		for (i = 0; i < 8; ++i)
+			for (l = 0; l < SHA256_LANES; ++l)
+				state[i][l] = sha256_init_state[i];
+
+		for (block = 0; block < blocks; ++block) {
+			memset(m, 0, sizeof(m[0]) * 16);
+			for (l = 0; l < lanes; ++l) {
+				sha256_padded_block(data, in + (first + l) * in_stride, in_len, blocks, block);
+				for (i = 0; i < 16; ++i)
+					m[i][l] = sha256_load_be(&data[4 * i]);
+			}
+			if (backend == SHA256_SIMD_AVX2)
+				sha256_compress_lanes_avx2((WORD (*)[SHA256_LANES])state, (const WORD (*)[SHA256_LANES])m);
+			else
+				sha256_transform_lanes(state, m);
+		}
+
+		for (l = 0; l < lanes; ++l)
+			for (i = 0; i < 8; ++i)
+				sha256_store_be(out + (first + l) * SHA256_BLOCK_SIZE + 4 * i, state[i][l]);
+	}
+}
+
+// SHA-NI, two messages at a time
+static void sha256_hash_shani(const BYTE *in, size_t in_stride, size_t in_len, BYTE *out, size_t n)
+{
+	WORD state[2][8];
+	BYTE data[2][64];
+	size_t blocks = (in_len + 9 + 63) / 64;
+	size_t j, pair, block, i, x;
+
+	for (j = 0; j < n; j += pair) {
+		pair = n - j < 2 ? 1 : 2;
+
+		for (x = 0; x < pair; ++x)
+			memcpy(state[x], sha256_init_state, sizeof(state[x]));
+
+		for (block = 0; block < blocks; ++block) {
+			for (x = 0; x < pair; ++x)
+				sha256_padded_block(data[x], in + (j + x) * in_stride, in_len, blocks, block);
+			if (pair == 2)
+				sha256_compress_shani_x2(state, (const BYTE (*)[64])data);
+			else
+				sha256_compress_shani(state[0], data[0], 1);
+		}
+
+		for (x = 0; x < pair; ++x)
+			for (i = 0; i < 8; ++i)
+				sha256_store_be(out + (j + x) * SHA256_BLOCK_SIZE + 4 * i, state[x][i]);
+	}
+}
+
+void sha256_hash_many_with(const unsigned backend, const void *in, const size_t in_stride, const size_t in_len, void *out, const size_t n)
+{
+	if (backend == SHA256_SIMD_SHANI)
+		sha256_hash_shani((const BYTE *)in, in_stride, in_len, (BYTE *)out, n);
+	else
+		sha256_hash_lanes(backend, (const BYTE *)in, in_stride, in_len, (BYTE *)out, n);
+}
+
+void sha256_hash_many(const void *in, const size_t in_stride, const size_t in_len, void *out, const size_t n)
+{
+	sha256_hash_many_with(dispatch.sha256, in, in_stride, in_len, out, n);
+}
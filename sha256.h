@@ -14,6 +14,7 @@
 
 /****************************** MACROS ******************************/
 #define SHA256_BLOCK_SIZE 32            // SHA256 outputs a 32 byte digest
+#define SHA256_LANES 8                  // messages hashed together by sha256_hash_many
 
 /**************************** DATA TYPES ****************************/
 typedef unsigned char BYTE;             // 8-bit byte
@@ -32,4 +33,15 @@ void sha256_update(SHA256_CTX *ctx, const BYTE data[], size_t len);
 void sha256_final(SHA256_CTX *ctx, BYTE hash[]);
 void sha256_hash(const void *in, const size_t in_len, void *out, size_t out_len);
 
+// Hashes n messages of in_len bytes each, message i at in + i * in_stride and
+// its digest to out + i * SHA256_BLOCK_SIZE.  out may be in if in_stride is
+// SHA256_BLOCK_SIZE.
+void sha256_hash_many(const void *in, const size_t in_stride, const size_t in_len, void *out, const size_t n);
+
+// Same as above with an explicit SHA256_SIMD_* backend from sha256_simd.h,
+// which must be supported, for differential testing.  sha256_hash and
+// sha256_hash_many pick the fastest supported backend at runtime.
+void sha256_hash_with(const unsigned backend, const void *in, const size_t in_len, void *out);
+void sha256_hash_many_with(const unsigned backend, const void *in, const size_t in_stride, const size_t in_len, void *out, const size_t n);
+
 #endif   // SHA256_H
@@ -0,0 +1,221 @@
+// Accelerated SHA-256 compression
+//
+//     SHA-NI keeps the state as two registers, ABEF and CDGH, which is the
+//     layout SHA256RNDS2 expects: each call does two rounds, taking the
+//     message words plus round constants from the low half of its third
+//     operand.  The schedule is four registers of four words each, extended
+//     with SHA256MSG1 (the sigma0 term), an ALIGNR for w[i-7] and
+//     SHA256MSG2 (the sigma1 term).
+//
+//     The AVX2 kernel is the textbook round function on eight lanes.
+//     AVX2 has no vector rotate, so every rotation is two shifts and an or,
+//     and the message schedule is kept as a ring of the last 16 words.
+
+#include "sha256_simd.h"
+#include "cpu.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+bool sha256_simd_supported(const unsigned backend)
+{
+    switch (backend) {
+        case SHA256_SIMD_GENERIC:
+            return true;
+#ifdef HAVE_X86_SIMD
+        case SHA256_SIMD_SHANI:
+            return cpu_has(CPU_FEATURE_SHA);
+        case SHA256_SIMD_AVX2:
+            return cpu_has(CPU_FEATURE_AVX2);
+#endif
+        default:
+            return false;
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+#define SHANI_TARGET __attribute__((target("sha,ssse3,sse4.1")))
+#define AVX2_TARGET  __attribute__((target("avx2")))
+
+_Static_assert(SHA256_LANES == 8, "the AVX2 kernel holds 8 lanes per register");
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// Byte order shuffle for big endian words
+#define SHANI_BSWAP _mm_set_epi64x(0x0c0d0e0f08090a0bull, 0x0405060700010203ull)
+
+// (a, b, c, d), (e, f, g, h) -> ABEF, CDGH
+SHANI_TARGET
+static inline void shani_load(__m128i *abef, __m128i *cdgh, const uint32_t state[8])
+{
+    const __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1); // CDAB
+    *cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);         // EFGH
+    *abef = _mm_alignr_epi8(tmp, *cdgh, 8);
+    *cdgh = _mm_blend_epi16(*cdgh, tmp, 0xf0);
+}
+
+// ABEF, CDGH -> (a, b, c, d), (e, f, g, h)
+SHANI_TARGET
+static inline void shani_store(uint32_t state[8], const __m128i abef, const __m128i cdgh)
+{
+    const __m128i tmp  = _mm_shuffle_epi32(abef, 0x1b); // FEBA
+    const __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, dchg, 0xf0)); // DCBA
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(dchg, tmp, 8));   // HGFE
+}
+
+// Rounds 4*i to 4*i + 3, computing schedule words 4*i to 4*i + 3 into w[i % 4]
+SHANI_TARGET
+static inline void shani_rounds(__m128i *abef, __m128i *cdgh, __m128i w[4], const uint8_t data[64], const int i)
+{
+    if (i < 4) {
+        w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&data[16*i]), SHANI_BSWAP);
+    }
+    else {
+        // w[i] = sigma1(w[i-2]) + w[i-7] + sigma0(w[i-15]) + w[i-16], four at a time
+        __m128i x = _mm_sha256msg1_epu32(w[i % 4], w[(i + 1) % 4]);
+        x = _mm_add_epi32(x, _mm_alignr_epi8(w[(i + 3) % 4], w[(i + 2) % 4], 4));
+        w[i % 4] = _mm_sha256msg2_epu32(x, w[(i + 3) % 4]);
+    }
+
+    __m128i wk = _mm_add_epi32(w[i % 4], _mm_loadu_si128((const __m128i *)&K[4*i]));
+    *cdgh = _mm_sha256rnds2_epu32(*cdgh, *abef, wk);
+    wk = _mm_shuffle_epi32(wk, 0x0e);
+    *abef = _mm_sha256rnds2_epu32(*abef, *cdgh, wk);
+}
+
+SHANI_TARGET
+void sha256_compress_shani(uint32_t state[8], const uint8_t *data, const size_t blocks)
+{
+    __m128i abef, cdgh, w[4];
+    shani_load(&abef, &cdgh, state);
+
+    for (size_t b = 0; b < blocks; b++, data += 64) {
+        const __m128i abef_in = abef;
+        const __m128i cdgh_in = cdgh;
+        for (int i = 0; i < 16; i++) {
+            shani_rounds(&abef, &cdgh, w, data, i);
+        }
+        abef = _mm_add_epi32(abef, abef_in);
+        cdgh = _mm_add_epi32(cdgh, cdgh_in);
+    }
+
+    shani_store(state, abef, cdgh);
+}
+
+// Two independent messages, interleaved to hide the latency of SHA256RNDS2
+SHANI_TARGET
+void sha256_compress_shani_x2(uint32_t state[2][8], const uint8_t data[2][64])
+{
+    __m128i abef0, cdgh0, w0[4];
+    __m128i abef1, cdgh1, w1[4];
+    shani_load(&abef0, &cdgh0, state[0]);
+    shani_load(&abef1, &cdgh1, state[1]);
+    const __m128i abef0_in = abef0, cdgh0_in = cdgh0;
+    const __m128i abef1_in = abef1, cdgh1_in = cdgh1;
+
+    for (int i = 0; i < 16; i++) {
+        shani_rounds(&abef0, &cdgh0, w0, data[0], i);
+        shani_rounds(&abef1, &cdgh1, w1, data[1], i);
+    }
+
+    shani_store(state[0], _mm_add_epi32(abef0, abef0_in), _mm_add_epi32(cdgh0, cdgh0_in));
+    shani_store(state[1], _mm_add_epi32(abef1, abef1_in), _mm_add_epi32(cdgh1, cdgh1_in));
+}
+
+#define ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+#define XOR3(x, y, z) _mm256_xor_si256(_mm256_xor_si256((x), (y)), (z))
+
+AVX2_TARGET
+void sha256_compress_lanes_avx2(uint32_t state[8][SHA256_LANES], const uint32_t m[16][SHA256_LANES])
+{
+    __m256i s[8], w[16];
+    for (int i = 0; i < 8; i++) {
+        s[i] = _mm256_loadu_si256((const __m256i *)state[i]);
+    }
+    for (int i = 0; i < 16; i++) {
+        w[i] = _mm256_loadu_si256((const __m256i *)m[i]);
+    }
+
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+    __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++) {
+        if (i >= 16) {
+            // w[i] = sigma1(w[i-2]) + w[i-7] + sigma0(w[i-15]) + w[i-16]
+            const __m256i w2  = w[(i - 2) % 16];
+            const __m256i w15 = w[(i - 15) % 16];
+            const __m256i s0 = XOR3(ROTR(w15, 7), ROTR(w15, 18), _mm256_srli_epi32(w15, 3));
+            const __m256i s1 = XOR3(ROTR(w2, 17), ROTR(w2, 19), _mm256_srli_epi32(w2, 10));
+            w[i % 16] = _mm256_add_epi32(_mm256_add_epi32(w[i % 16], s0),
+                                         _mm256_add_epi32(w[(i - 7) % 16], s1));
+        }
+
+        // ch = (e & f) ^ (~e & g), maj = (a & b) ^ (a & c) ^ (b & c)
+        const __m256i ch  = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        const __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        const __m256i ep0 = XOR3(ROTR(a, 2), ROTR(a, 13), ROTR(a, 22));
+        const __m256i ep1 = XOR3(ROTR(e, 6), ROTR(e, 11), ROTR(e, 25));
+
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, ep1), _mm256_add_epi32(ch, w[i % 16]));
+        t1 = _mm256_add_epi32(t1, _mm256_set1_epi32((int)K[i]));
+        const __m256i t2 = _mm256_add_epi32(ep0, maj);
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    s[0] = _mm256_add_epi32(s[0], a);
+    s[1] = _mm256_add_epi32(s[1], b);
+    s[2] = _mm256_add_epi32(s[2], c);
+    s[3] = _mm256_add_epi32(s[3], d);
+    s[4] = _mm256_add_epi32(s[4], e);
+    s[5] = _mm256_add_epi32(s[5], f);
+    s[6] = _mm256_add_epi32(s[6], g);
+    s[7] = _mm256_add_epi32(s[7], h);
+    for (int i = 0; i < 8; i++) {
+        _mm256_storeu_si256((__m256i *)state[i], s[i]);
+    }
+}
+
+#else
+
+// Never called, sha256_simd_supported() is false for both backends
+
+void sha256_compress_shani(uint32_t state[8], const uint8_t *data, const size_t blocks)
+{
+    (void)state;
+    (void)data;
+    (void)blocks;
+}
+
+void sha256_compress_shani_x2(uint32_t state[2][8], const uint8_t data[2][64])
+{
+    (void)state;
+    (void)data;
+}
+
+void sha256_compress_lanes_avx2(uint32_t state[8][SHA256_LANES], const uint32_t m[16][SHA256_LANES])
+{
+    (void)state;
+    (void)m;
+}
+
+#endif // HAVE_X86_SIMD
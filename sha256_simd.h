@@ -0,0 +1,30 @@
+// Accelerated SHA-256 compression
+//
+//     SHA256_SIMD_SHANI compresses one message with the x86 SHA extensions
+//     (SHA256RNDS2 does two rounds per instruction).  SHA256_SIMD_AVX2
+//     compresses one block of each of SHA256_LANES messages at once, with
+//     lane l of every 256-bit register belonging to message l.  Callers
+//     must check sha256_simd_supported() first; sha256.c does the dispatch.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "sha256.h"
+
+#define SHA256_SIMD_GENERIC 0 // portable C, any number of lanes
+#define SHA256_SIMD_SHANI   1 // SHA extensions, one message at a time
+#define SHA256_SIMD_AVX2    2 // 8 messages at a time
+
+bool sha256_simd_supported(const unsigned backend);
+
+// state is a, b, ..., h; data holds blocks consecutive 64 byte blocks
+void sha256_compress_shani(uint32_t state[8], const uint8_t *data, const size_t blocks);
+// One block each of two messages
+void sha256_compress_shani_x2(uint32_t state[2][8], const uint8_t data[2][64]);
+
+// state[i][l] is word i of the state of lane l and m[i][l] word i of its
+// block, already converted from big endian
+void sha256_compress_lanes_avx2(uint32_t state[8][SHA256_LANES], const uint32_t m[16][SHA256_LANES]);
@@ -0,0 +1,174 @@
+// Signature cache
+//
+//     A fixed array of entries, chained into a power of two hash table on
+//     the transaction digest and into a doubly linked list from the most to
+//     the least recently used.  Entries are linked by index, so the whole
+//     cache is two allocations made by signature_cache_init.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "signature_cache.h"
+#include "sha256.h"
+
+#define NONE UINT32_MAX
+
+#define KEY_NETWORK COMPRESSED_BYTES
+#define KEY_DIGEST  (COMPRESSED_BYTES + 1)
+
+static size_t bucket_of(const SignatureCache *cache, const uint8_t key[SIGNATURE_CACHE_KEY_BYTES])
+{
+    // The digest is already uniform, the key is mixed in for keys signing
+    // the same transaction
+    uint64_t pub, digest;
+    memcpy(&pub, key, sizeof(pub));
+    memcpy(&digest, &key[KEY_DIGEST], sizeof(digest));
+    return (size_t)(digest ^ (pub + key[KEY_NETWORK])*0x9e3779b97f4a7c15ULL) & cache->bucket_mask;
+}
+
+static void lru_unlink(SignatureCache *cache, const uint32_t i)
+{
+    const SignatureCacheEntry *e = &cache->entries[i];
+    if (e->newer != NONE) {
+        cache->entries[e->newer].older = e->older;
+    }
+    else {
+        cache->newest = e->older;
+    }
+    if (e->older != NONE) {
+        cache->entries[e->older].newer = e->newer;
+    }
+    else {
+        cache->oldest = e->newer;
+    }
+}
+
+static void lru_push(SignatureCache *cache, const uint32_t i)
+{
+    SignatureCacheEntry *e = &cache->entries[i];
+    e->newer = NONE;
+    e->older = cache->newest;
+    if (cache->newest != NONE) {
+        cache->entries[cache->newest].newer = i;
+    }
+    else {
+        cache->oldest = i;
+    }
+    cache->newest = i;
+}
+
+static void bucket_unlink(SignatureCache *cache, const uint32_t i)
+{
+    uint32_t *link = &cache->buckets[bucket_of(cache, cache->entries[i].key)];
+    while (*link != i) {
+        link = &cache->entries[*link].chain;
+    }
+    *link = cache->entries[i].chain;
+}
+
+bool signature_cache_init(SignatureCache *cache, const size_t capacity)
+{
+    memset(cache, 0, sizeof(*cache));
+    if (capacity == 0 || capacity >= (1UL << 31)) {
+        return false;
+    }
+
+    size_t buckets = 1;
+    while (buckets < capacity) {
+        buckets <<= 1;
+    }
+    cache->entries = malloc(capacity*sizeof(SignatureCacheEntry));
+    cache->buckets = malloc(buckets*sizeof(uint32_t));
+    if (!cache->entries || !cache->buckets) {
+        signature_cache_free(cache);
+        return false;
+    }
+    cache->capacity = capacity;
+    cache->bucket_mask = buckets - 1;
+    signature_cache_reset(cache);
+    return true;
+}
+
+void signature_cache_free(SignatureCache *cache)
+{
+    free(cache->entries);
+    free(cache->buckets);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void signature_cache_reset(SignatureCache *cache)
+{
+    if (!cache->buckets) {
+        return;
+    }
+    memset(cache->buckets, 0xff, (cache->bucket_mask + 1)*sizeof(uint32_t));
+    cache->count = 0;
+    cache->newest = NONE;
+    cache->oldest = NONE;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+}
+
+bool sign_cached(SignatureCache *cache, SignerContext *ctx, Signature *sig, const Keypair *kp,
+                 const Transaction *transaction)
+{
+    if (!cache->buckets) {
+        // signature_cache_init failed, nothing to look up or store
+        sign_with_context(ctx, sig, kp, transaction);
+        return false;
+    }
+
+    uint8_t key[SIGNATURE_CACHE_KEY_BYTES];
+    uint8_t record[TRANSACTION_BYTES];
+    Compressed pub;
+    compress(&pub, &kp->pub);
+    compressed_to_bytes(key, &pub);
+    key[KEY_NETWORK] = ctx->network_id;
+    transaction_to_bytes(record, transaction);
+    sha256_hash(record, sizeof(record), &key[KEY_DIGEST], SHA256_BLOCK_SIZE);
+
+    const size_t b = bucket_of(cache, key);
+    for (uint32_t i = cache->buckets[b]; i != NONE; i = cache->entries[i].chain) {
+        if (memcmp(cache->entries[i].key, key, sizeof(key)) == 0) {
+            *sig = cache->entries[i].sig;
+            lru_unlink(cache, i);
+            lru_push(cache, i);
+            cache->hits++;
+            return true;
+        }
+    }
+
+    cache->misses++;
+    sign_with_context(ctx, sig, kp, transaction);
+
+    uint32_t i;
+    if (cache->count < cache->capacity) {
+        i = (uint32_t)cache->count++;
+    }
+    else {
+        i = cache->oldest;
+        lru_unlink(cache, i);
+        bucket_unlink(cache, i);
+        cache->evictions++;
+    }
+
+    SignatureCacheEntry *e = &cache->entries[i];
+    memcpy(e->key, key, sizeof(key));
+    e->sig = *sig;
+    e->chain = cache->buckets[b];
+    cache->buckets[b] = i;
+    lru_push(cache, i);
+    return false;
+}
+
+void signature_cache_stats(SignatureCacheStats *stats, const SignatureCache *cache)
+{
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->entries = cache->count;
+    stats->capacity = cache->capacity;
+    const uint64_t lookups = cache->hits + cache->misses;
+    stats->hit_rate = lookups ? (double)cache->hits / lookups : 0.0;
+}
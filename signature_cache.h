@@ -0,0 +1,69 @@
+// Signature cache
+//
+//     Signatures are deterministic, so re-signing a byte-identical
+//     transaction with the same key and network gives the same signature.
+//     A broadcasting layer that retries may ask for it again and again.
+//     sign_cached looks the signature up by (public key, network, SHA-256
+//     of the transaction record) first, and only signs on a miss, skipping
+//     the nonce derivation, k*G and the Poseidon hash.
+//
+//     The cache holds at most `capacity` signatures, allocated once by
+//     signature_cache_init, and evicts the least recently used one when
+//     full.  Like SignerContext it is not thread safe: use one per thread,
+//     or lock around sign_cached.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crypto.h"
+#include "signer_context.h"
+
+#define SIGNATURE_CACHE_KEY_BYTES (COMPRESSED_BYTES + 1 + 32) // public key, network, digest
+
+typedef struct signature_cache_entry_t {
+    uint8_t key[SIGNATURE_CACHE_KEY_BYTES];
+    Signature sig;
+    uint32_t newer, older;  // LRU list
+    uint32_t chain;         // next entry in the same bucket
+} SignatureCacheEntry;
+
+typedef struct signature_cache_t {
+    SignatureCacheEntry *entries;
+    uint32_t *buckets;
+    size_t capacity;
+    size_t bucket_mask;
+    size_t count;
+    uint32_t newest, oldest;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} SignatureCache;
+
+typedef struct signature_cache_stats_t {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t capacity;
+    double hit_rate;        // hits / (hits + misses), 0 before any lookup
+} SignatureCacheStats;
+
+// capacity is at least 1 and below 2^31.  Returns false if it is not or
+// the memory cannot be allocated, leaving an empty cache of capacity 0:
+// sign_cached then signs every time without storing anything or counting.
+bool signature_cache_init(SignatureCache *cache, const size_t capacity);
+void signature_cache_free(SignatureCache *cache);
+
+// Drops every signature, keeping the memory, and zeroes the counters
+void signature_cache_reset(SignatureCache *cache);
+
+// sign_with_context(ctx, sig, kp, transaction), from the cache if the same
+// key signed the same transaction for ctx's network before.  Returns true
+// on a hit.
+bool sign_cached(SignatureCache *cache, SignerContext *ctx, Signature *sig, const Keypair *kp,
+                 const Transaction *transaction);
+
+void signature_cache_stats(SignatureCacheStats *stats, const SignatureCache *cache);
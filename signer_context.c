@@ -0,0 +1,174 @@
+// Reusable signing and verification context
+//
+//     The random oracle input of a message is built in the context's
+//     scratch: the transaction for the nonce derivation, then pub.x, pub.y
+//     and rx appended for the Poseidon hash.  Keys are compared with the
+//     cached ones on every call, so alternating keys still work, just
+//     without the saving.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "signer_context.h"
+#include "keygen.h"
+#include "pasta_fq.h"
+#include "utils.h"
+
+bool signer_context_init(SignerContext *ctx, const uint8_t network_id)
+{
+    if (!poseidon_init(&ctx->poseidon, POSEIDON_LEGACY, network_id)) {
+        return false;
+    }
+    ctx->network_id = network_id;
+    ctx->has_signing_key = false;
+    ctx->has_verifying_key = false;
+    return true;
+}
+
+void signer_context_clear(SignerContext *ctx)
+{
+    secure_bzero(ctx, sizeof(*ctx));
+}
+
+static void roinput_init(ROInput *input, SignerContext *ctx)
+{
+    input->fields = ctx->fields;
+    input->bits = ctx->bits;
+    input->fields_capacity = SIGNER_ROINPUT_FIELDS;
+    input->bits_capacity = 8*sizeof(ctx->bits);
+    input->fields_len = 0;
+    input->bits_len = 0;
+}
+
+// e = H(transaction || pub.x || pub.y || rx), appending to input
+static void message_hash(Scalar e, SignerContext *ctx, ROInput *input, const Affine *pub, const Field rx)
+{
+    roinput_add_field(input, pub->x);
+    roinput_add_field(input, pub->y);
+    roinput_add_field(input, rx);
+    const size_t len = roinput_to_fields((uint64_t *)ctx->packed, input);
+
+    PoseidonCtx sponge = ctx->poseidon;
+    poseidon_update(&sponge, (const Field *)ctx->packed, len);
+    poseidon_digest(e, &sponge);
+}
+
+// Signs the transaction in input, which message_hash then extends
+static void sign_input(SignerContext *ctx, Signature *sig, const Keypair *kp, ROInput *input)
+{
+    if (!ctx->has_signing_key || !scalar_eq(ctx->signing_key, kp->priv)) {
+        derive_init(&ctx->derive, kp, ctx->network_id);
+        scalar_copy(ctx->signing_key, kp->priv);
+        ctx->has_signing_key = true;
+    }
+
+    Scalar k;
+    derive_nonce(k, &ctx->derive, input);
+
+    uint64_t k_nonzero;
+    fiat_pasta_fq_nonzero(&k_nonzero, k);
+    if (!k_nonzero) {
+        exit(1);
+    }
+
+    // r = k*G, with k negated if r.y is odd
+    Group rg;
+    Affine r;
+    generator_mul_secret(&rg, k);
+    affine_from_group(&r, &rg);
+    field_copy(sig->rx, r.x);
+    if (field_is_odd(r.y)) {
+        scalar_negate(k, k);
+    }
+
+    // s = k + e*sk
+    Scalar e;
+    message_hash(e, ctx, input, &kp->pub, r.x);
+    scalar_mul(e, e, kp->priv);
+    scalar_add(sig->s, k, e);
+
+    secure_bzero(k, sizeof(k));
+}
+
+void sign_with_context(SignerContext *ctx, Signature *sig, const Keypair *kp, const Transaction *transaction)
+{
+    ROInput input;
+    roinput_init(&input, ctx);
+    roinput_add_transaction(&input, transaction);
+    sign_input(ctx, sig, kp, &input);
+}
+
+bool sign_record(SignerContext *ctx, uint8_t sig[SIGNATURE_BYTES], const Keypair *kp,
+                 const uint8_t transaction[TRANSACTION_BYTES])
+{
+    ROInput input;
+    roinput_init(&input, ctx);
+    if (!roinput_add_transaction_record(&input, transaction)) {
+        return false;
+    }
+    Signature out;
+    sign_input(ctx, &out, kp, &input);
+    signature_to_bytes(sig, &out);
+    return true;
+}
+
+// Decompresses pub unless it is the cached verifying key, false if it is
+// not on the curve
+static bool set_verifying_key(SignerContext *ctx, const Compressed *pub)
+{
+    if (!ctx->has_verifying_key || !field_eq(ctx->verifying_key.x, pub->x)
+        || ctx->verifying_key.is_odd != pub->is_odd) {
+        field_copy(ctx->verifying_key.x, pub->x);
+        ctx->verifying_key.is_odd = pub->is_odd;
+        ctx->verifying_key_valid = decompress(&ctx->verifying_point, pub);
+        ctx->has_verifying_key = true;
+    }
+    return ctx->verifying_key_valid;
+}
+
+// Verifies sig on the transaction in input for the verifying key
+static bool verify_input(SignerContext *ctx, const Signature *sig, ROInput *input)
+{
+    Scalar e;
+    message_hash(e, ctx, input, &ctx->verifying_point, sig->rx);
+
+    // r = s*G - e*pub must have an even y and x = rx
+    Group sg, epub, pub_proj, r;
+    generator_mul_public(&sg, sig->s);
+    affine_to_group(&pub_proj, &ctx->verifying_point);
+    group_scalar_mul(&epub, e, &pub_proj);
+    field_negate(epub.Y, epub.Y);
+    group_add(&r, &sg, &epub);
+
+    Affine raff;
+    affine_from_group(&raff, &r);
+    return !field_is_odd(raff.y) && field_eq(raff.x, sig->rx);
+}
+
+bool verify_with_context(SignerContext *ctx, const Signature *sig, const Compressed *pub,
+                         const Transaction *transaction)
+{
+    if (!set_verifying_key(ctx, pub)) {
+        return false;
+    }
+
+    ROInput input;
+    roinput_init(&input, ctx);
+    roinput_add_transaction(&input, transaction);
+    return verify_input(ctx, sig, &input);
+}
+
+bool verify_record(SignerContext *ctx, const uint8_t sig[SIGNATURE_BYTES], const uint8_t pub[COMPRESSED_BYTES],
+                   const uint8_t transaction[TRANSACTION_BYTES])
+{
+    // Malformed records are rejected before the key is decompressed
+    Compressed key;
+    Signature s;
+    ROInput input;
+    roinput_init(&input, ctx);
+    if (!compressed_from_bytes(&key, pub) || !signature_from_bytes(&s, sig)
+        || !roinput_add_transaction_record(&input, transaction) || !set_verifying_key(ctx, &key)) {
+        return false;
+    }
+    return verify_input(ctx, &s, &input);
+}
@@ -0,0 +1,69 @@
+// Reusable signing and verification context
+//
+//     sign and verify redo the same setup for every message: copy the
+//     network's Poseidon configuration and initial sponge, pack the
+//     signing key's part of the nonce derivation input, decompress the
+//     public key (a square root) and size VLAs for the random oracle input.
+//     A SignerContext does that once.  It holds the network id and initial
+//     sponge, the derivation input of the last signing key, the last
+//     verifying key decompressed, and fixed scratch for one message, so
+//     signing or verifying many messages for the same network and key only
+//     pays for the message itself.  The nonce commitment k*G and the s*G of
+//     verification come from the shared generator table of keygen.h, in
+//     constant time for the secret k, instead of a ladder or a double and
+//     add chain.
+//
+//     A context is not thread safe: allocate one per thread and pass it to
+//     every call.  signer_context_clear wipes the cached private key.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "crypto.h"
+#include "poseidon.h"
+
+// Random oracle input of a signature: the transaction, then pub.x, pub.y
+// and rx, with the transaction's bits packed into fields after those
+#define SIGNER_ROINPUT_FIELDS (TRANSACTION_ROINPUT_FIELDS + 3)
+#define SIGNER_PACKED_FIELDS  (SIGNER_ROINPUT_FIELDS + (TRANSACTION_ROINPUT_BITS + FIELD_SIZE_IN_BITS - 2)/(FIELD_SIZE_IN_BITS - 1))
+
+typedef struct signer_context_t {
+    uint8_t network_id;
+    PoseidonCtx poseidon;         // legacy sponge with the network's IV, copied per message
+
+    bool has_signing_key;
+    Scalar signing_key;
+    DeriveCtx derive;             // derive_init of signing_key
+
+    bool has_verifying_key;
+    bool verifying_key_valid;     // whether verifying_key decompressed
+    Compressed verifying_key;
+    Affine verifying_point;
+
+    uint64_t fields[LIMBS_PER_FIELD*SIGNER_ROINPUT_FIELDS];
+    uint8_t bits[(TRANSACTION_ROINPUT_BITS + 7)/8];
+    Field packed[SIGNER_PACKED_FIELDS];
+} SignerContext;
+
+// network_id is TESTNET_ID, MAINNET_ID or NULLNET_ID, returns false otherwise
+bool signer_context_init(SignerContext *ctx, const uint8_t network_id);
+void signer_context_clear(SignerContext *ctx);
+
+// Same results as sign and verify for the context's network
+void sign_with_context(SignerContext *ctx, Signature *sig, const Keypair *kp, const Transaction *transaction);
+bool verify_with_context(SignerContext *ctx, const Signature *sig, const Compressed *pub,
+                         const Transaction *transaction);
+
+// Sign and verify transaction records (TRANSACTION_BYTES, see minasigner.h)
+// where they are, e.g. in a memory mapped file or a socket buffer: the
+// random oracle input is read straight from the bytes, without decoding a
+// Transaction first.  Signatures are SIGNATURE_BYTES and public keys
+// COMPRESSED_BYTES records, as signature_to_bytes and compressed_to_bytes
+// write them.  Both return false for a malformed record, verify_record
+// also for a bad signature or key.
+bool sign_record(SignerContext *ctx, uint8_t sig[SIGNATURE_BYTES], const Keypair *kp,
+                 const uint8_t transaction[TRANSACTION_BYTES]);
+bool verify_record(SignerContext *ctx, const uint8_t sig[SIGNATURE_BYTES], const uint8_t pub[COMPRESSED_BYTES],
+                   const uint8_t transaction[TRANSACTION_BYTES]);
@@ -1,5 +1,6 @@
 
 #include <stdio.h>
+#include <ctype.h>
 #include <assert.h>
 #include <sys/resource.h>
 #include <inttypes.h>
@@ -11,60 +12,61 @@
 #include "base10.h"
 #include "utils.h"
 #include "sha256.h"
+#include "sha256_simd.h"
+#include "blake2.h"
+#include "blake2b_simd.h"
+#include "libbase58.h"
+#include "base58_address.h"
 #include "curve_checks.h"
-
-#ifdef OSX
-  #define explicit_bzero bzero
-#endif
+#include "pasta_simd.h"
+#include "pasta_adx.h"
+#include "pasta_sparse.h"
+#include "msm.h"
+#include "keygen.h"
+#include "vanity.h"
+#include "op_counters.h"
+#include "dispatch.h"
+#include "minasigner.h"
+#include "signer_context.h"
+#include "signature_cache.h"
 
 #define ARRAY_LEN(x) (sizeof(x)/sizeof(x[0]))
 
 #define DEFAULT_TOKEN_ID 1
 static bool _verbose;
 static bool _ledger_gen;
+static bool _ops;
 
+// Mina privkey hex format is in big-endian
 void privkey_to_hex(char *hex, const size_t len, const Scalar priv_key) {
-  uint64_t priv_words[4];
   hex[0] = '\0';
 
-  assert(len > 2*sizeof(priv_words));
-  if (len < 2*sizeof(priv_words)) {
+  assert(len > 2*SCALAR_BYTES);
+  if (len <= 2*SCALAR_BYTES) {
     return;
   }
 
-  uint8_t *p = (uint8_t *)priv_words;
-  fiat_pasta_fq_from_montgomery(priv_words, priv_key);
-  // Mina privkey hex format is in big-endian
-  for (size_t i = sizeof(priv_words); i > 0; i--) {
-    sprintf(&hex[2*(sizeof(priv_words) - i)], "%02x", p[i - 1]);
+  uint8_t bytes[SCALAR_BYTES], be[SCALAR_BYTES];
+  scalar_to_bytes(bytes, priv_key);
+  for (size_t i = 0; i < SCALAR_BYTES; i++) {
+    be[i] = bytes[SCALAR_BYTES - 1 - i];
   }
-  hex[len] = '\0';
+  hex_encode(hex, be, sizeof(be));
 }
 
 bool privkey_from_hex(Scalar priv_key, const char *priv_hex) {
-  size_t priv_hex_len = strnlen(priv_hex, 64);
-  if (priv_hex_len != 64) {
+  if (strnlen(priv_hex, 2*SCALAR_BYTES + 1) != 2*SCALAR_BYTES) {
     return false;
   }
-  uint8_t priv_bytes[32];
-  // Mina privkey hex format is in big-endian
-  for (size_t i = sizeof(priv_bytes); i > 0; i--) {
-    sscanf(&priv_hex[2*(i - 1)], "%02hhx", &priv_bytes[sizeof(priv_bytes) - i]);
-  }
 
-  if (priv_bytes[3] & 0xc000000000000000) {
-      return false;
+  uint8_t bytes[SCALAR_BYTES], be[SCALAR_BYTES];
+  if (!hex_decode(be, priv_hex, sizeof(be))) {
+    return false;
   }
-
-  fiat_pasta_fq_to_montgomery(priv_key, (uint64_t *)priv_bytes);
-
-  char priv_key_hex[65];
-  privkey_to_hex(priv_key_hex, sizeof(priv_key_hex), priv_key);
-
-  // sanity check
-  int result = memcmp(priv_key_hex, priv_hex, sizeof(priv_key_hex)) == 0;
-  assert(result);
-  return result;
+  for (size_t i = 0; i < SCALAR_BYTES; i++) {
+    bytes[i] = be[SCALAR_BYTES - 1 - i];
+  }
+  return scalar_from_bytes(priv_key, bytes);
 }
 
 bool privhex_to_address(char *address, const size_t len,
@@ -95,25 +97,6 @@ bool privhex_to_address(char *address, const size_t len,
   return true;
 }
 
-void sig_to_hex(char *hex, const size_t len, const Signature sig) {
-  hex[0] = '\0';
-
-  assert(len == 2*sizeof(Signature) + 1);
-  if (len < 2*sizeof(Signature) + 1) {
-    return;
-  }
-
-  uint64_t words[4];
-  fiat_pasta_fp_from_montgomery(words, sig.rx);
-  for (size_t i = 4; i > 0; i--) {
-    sprintf(&hex[16*(4 - i)], "%016" PRIx64, words[i - 1]);
-  }
-  fiat_pasta_fq_from_montgomery(words, sig.s);
-  for (size_t i = 4; i > 0; i--) {
-    sprintf(&hex[64 + 16*(4 - i)], "%016" PRIx64, words[i - 1]);
-  }
-}
-
 bool sign_transaction(char *signature, const size_t len,
                       const char *account_number,
                       const char *sender_priv_hex,
@@ -183,7 +166,7 @@ bool sign_transaction(char *signature, const size_t len,
     return false;
   }
 
-  sig_to_hex(signature, len, sig);
+  signature_to_hex(signature, &sig);
 
   if (_verbose) {
     fprintf(stderr, "%d %s\n", delegation, signature);
@@ -257,32 +240,6 @@ bool check_sign_tx(const char *account_number,
    return strcmp(signature, target) == 0;
 }
 
-char *field_to_hex(char *hex, size_t len, const Field x) {
-  assert(len == 65);
-  hex[64] = '\0';
-  Scalar y;
-  fiat_pasta_fp_from_montgomery(y, x);
-  uint8_t *p = (uint8_t *)y;
-  for (size_t i = 0; i < sizeof(y); i++) {
-    sprintf(&hex[2*i], "%02x", p[i]);
-  }
-
-  return hex;
-}
-
-char *scalar_to_hex(char *hex, size_t len, const Scalar x) {
-  assert(len == 65);
-  hex[64] = '\0';
-  Scalar y;
-  fiat_pasta_fq_from_montgomery(y, x);
-  uint8_t *p = (uint8_t *)y;
-  for (size_t i = 0; i < sizeof(y); i++) {
-    sprintf(&hex[2*i], "%02x", p[i]);
-  }
-
-  return hex;
-}
-
 void print_scalar_as_cstruct(const Scalar x) {
   printf("        { ");
   for (size_t i = 0; i < sizeof(Scalar)/sizeof(x[0]); i++) {
@@ -376,7 +333,7 @@ void generate_curve_checks(bool ledger_gen) {
   printf("static const Scalar S[%u][2] = {\n", EPOCHS);
 
   Scalar s0; // Seed with zero scalar
-  explicit_bzero(s0, sizeof(s0));
+  secure_bzero(s0, sizeof(s0));
   for (size_t i = 0; i < EPOCHS; i++) {
     // Generate two more scalars
     Scalar s1, s2;
@@ -590,6 +547,1585 @@ void test_fields() {
     assert(!field_from_hex(f, "01000000ed302d991bf94c09fc98462200000000000000000000000000000040"));
 }
 
+// Deterministic xorshift64* so that differential tests are reproducible
+static uint64_t _rand_state = 0x2545f4914f6cdd1d;
+
+uint64_t rand_u64(void) {
+    _rand_state ^= _rand_state >> 12;
+    _rand_state ^= _rand_state << 25;
+    _rand_state ^= _rand_state >> 27;
+    return _rand_state * 0x2545f4914f6cdd1dULL;
+}
+
+// Random element below 2^254, i.e. a valid representative for both fields
+void rand_element(uint64_t x[4]) {
+    for (size_t i = 0; i < 4; i++) {
+        x[i] = rand_u64();
+    }
+    x[3] &= (((uint64_t)1 << 62) - 1);
+}
+
+static const uint64_t FP_MINUS_ONE[4] = {
+    0x992d30ed00000000, 0x224698fc094cf91b, 0x0000000000000000, 0x4000000000000000
+};
+static const uint64_t FQ_MINUS_ONE[4] = {
+    0x8c46eb2100000000, 0x224698fc0994a8dd, 0x0000000000000000, 0x4000000000000000
+};
+
+void test_field_bytes() {
+    // Every byte both ways, in both cases
+    uint8_t bytes[256], decoded[256];
+    char hex[2*sizeof(bytes) + 1], expected[2*sizeof(bytes) + 1];
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        bytes[i] = i;
+        snprintf(&expected[2*i], 3, "%02x", (unsigned)i);
+    }
+    hex_encode(hex, bytes, sizeof(bytes));
+    assert(strcmp(hex, expected) == 0);
+    assert(hex_decode(decoded, hex, sizeof(decoded)));
+    assert(memcmp(decoded, bytes, sizeof(bytes)) == 0);
+    for (size_t i = 0; i < sizeof(hex); i++) {
+        hex[i] = toupper((unsigned char)hex[i]);
+    }
+    assert(hex_decode(decoded, hex, sizeof(decoded)));
+    assert(memcmp(decoded, bytes, sizeof(bytes)) == 0);
+    assert(!hex_decode(decoded, "0g", 1));
+    assert(!hex_decode(decoded, "g0", 1));
+    assert(!hex_decode(decoded, " 0", 1));
+    assert(!hex_decode(decoded, "01", 2)); // short, stops at the null
+
+    // Canonical encodings: below the modulus round trip, the rest is rejected
+    for (size_t field = 0; field < 2; field++) {
+        const uint64_t *minus_one = field == 0 ? FP_MINUS_ONE : FQ_MINUS_ONE;
+        for (size_t i = 0; i < 200; i++) {
+            uint64_t words[4];
+            uint8_t in[32], out[32];
+            rand_element(words);
+            if (i == 0) {
+                bzero(words, sizeof(words));
+            }
+            else if (i == 1) {
+                memcpy(words, minus_one, sizeof(words));
+            }
+            for (size_t j = 0; j < 32; j++) {
+                in[j] = words[j / 8] >> 8*(j % 8);
+            }
+
+            Field x;
+            char x_hex[65], y_hex[65];
+            if (field == 0) {
+                assert(field_from_bytes(x, in));
+                field_to_bytes(out, x);
+                field_to_hex(x_hex, sizeof(x_hex), x);
+            }
+            else {
+                assert(scalar_from_bytes(x, in));
+                scalar_to_bytes(out, x);
+                scalar_to_hex(x_hex, sizeof(x_hex), x);
+            }
+            assert(memcmp(in, out, sizeof(in)) == 0);
+            hex_encode(y_hex, in, sizeof(in));
+            assert(strcmp(x_hex, y_hex) == 0);
+
+            // p, p + 1, values above 2^255 and 2^256 - 1
+            if (i == 1) {
+                in[0] += 1;
+                assert(field == 0 ? !field_from_bytes(x, in) : !scalar_from_bytes(x, in));
+                in[0] += 1;
+                assert(field == 0 ? !field_from_bytes(x, in) : !scalar_from_bytes(x, in));
+            }
+            else if (i == 2) {
+                in[31] |= 0x80;
+                assert(field == 0 ? !field_from_bytes(x, in) : !scalar_from_bytes(x, in));
+            }
+            else if (i == 3) {
+                memset(in, 0xff, sizeof(in));
+                assert(field == 0 ? !field_from_bytes(x, in) : !scalar_from_bytes(x, in));
+            }
+        }
+    }
+
+    // Signatures, against the test vector format
+    const char *sig_hex = "11a36a8dfe5b857b95a2a7b7b17c62c3ea33411ae6f4eb3a907064aecae353c6"
+                          "0794f1d0288322fe3f8bb69d6fabd4fd7c15f8d09f8783b2f087a80407e299af";
+    Signature sig, sig2;
+    uint8_t sig_bytes[SIGNATURE_BYTES];
+    char sig_out[2*SIGNATURE_BYTES + 1];
+    assert(signature_from_hex(&sig, sig_hex));
+    signature_to_hex(sig_out, &sig);
+    assert(strcmp(sig_out, sig_hex) == 0);
+    signature_to_bytes(sig_bytes, &sig);
+    assert(sig_bytes[0] == 0xc6 && sig_bytes[FIELD_BYTES] == 0xaf);
+    assert(signature_from_bytes(&sig2, sig_bytes));
+    assert(field_eq(sig.rx, sig2.rx) && scalar_eq(sig.s, sig2.s));
+    assert(!signature_from_hex(&sig, "11a3"));
+    snprintf(sig_out, sizeof(sig_out), "%s", sig_hex);
+    sig_out[2*SIGNATURE_BYTES - 1] = 'x';
+    assert(!signature_from_hex(&sig, sig_out));
+    sig_out[0] = 'f'; // rx above the modulus
+    sig_out[2*SIGNATURE_BYTES - 1] = 'f';
+    assert(!signature_from_hex(&sig, sig_out));
+}
+
+#define BATCH_TEST_LEN 67
+
+void test_op_counters() {
+    const uint64_t expected = op_counters_enabled() ? 1 : 0;
+    Field a, b;
+    rand_element(a);
+    op_counts_reset();
+    field_mul(b, a, a);
+    field_mul_batch(&b, &a, &a, 1);
+    group_dbl(&(Group){ 0 }, &(Group){ 0 });
+
+    OpCounts c;
+    op_counts_snapshot(&c);
+    assert(c.field_mul == 2*expected && c.field_sq == 0 && c.group_dbl == expected);
+    op_counts_reset();
+    op_counts_snapshot(&c);
+    assert(c.field_mul == 0 && c.group_dbl == 0);
+}
+
+void test_field_batch() {
+    static uint64_t a[BATCH_TEST_LEN][4], b[BATCH_TEST_LEN][4];
+    static uint64_t expected[BATCH_TEST_LEN][4], actual[BATCH_TEST_LEN][4];
+
+    for (size_t field = 0; field < 2; field++) {
+        const uint64_t *minus_one = field == 0 ? FP_MINUS_ONE : FQ_MINUS_ONE;
+
+        for (size_t i = 0; i < BATCH_TEST_LEN; i++) {
+            rand_element(a[i]);
+            rand_element(b[i]);
+        }
+        // Edge cases: zero, one and p - 1 against each other
+        bzero(a[0], sizeof(a[0]));
+        memcpy(a[1], minus_one, sizeof(a[1]));
+        memcpy(b[1], minus_one, sizeof(b[1]));
+        memcpy(a[2], minus_one, sizeof(a[2]));
+        if (field == 0) {
+            fiat_pasta_fp_set_one(b[2]);
+            fiat_pasta_fp_set_one(a[3]);
+        }
+        else {
+            fiat_pasta_fq_set_one(b[2]);
+            fiat_pasta_fq_set_one(a[3]);
+        }
+        memcpy(b[3], minus_one, sizeof(b[3]));
+
+        for (size_t i = 0; i < BATCH_TEST_LEN; i++) {
+            if (field == 0) {
+                fiat_pasta_fp_mul(expected[i], a[i], b[i]);
+            }
+            else {
+                fiat_pasta_fq_mul(expected[i], a[i], b[i]);
+            }
+        }
+
+        for (unsigned backend = PASTA_SIMD_GENERIC; backend <= PASTA_SIMD_IFMA; backend++) {
+            if (!pasta_simd_supported(backend)) {
+                if (_verbose) {
+                    printf("field batch backend %u not supported, skipping\n", backend);
+                }
+                continue;
+            }
+
+            // Every length up to a few vectors, to cover the scalar tail
+            for (size_t n = 0; n <= 20; n++) {
+                bzero(actual, sizeof(actual));
+                if (field == 0) {
+                    pasta_fp_mul_batch_with(backend, actual, a, b, n);
+                }
+                else {
+                    pasta_fq_mul_batch_with(backend, actual, a, b, n);
+                }
+                assert(memcmp(actual, expected, n*sizeof(actual[0])) == 0);
+            }
+
+            // In place
+            memcpy(actual, a, sizeof(actual));
+            if (field == 0) {
+                pasta_fp_mul_batch_with(backend, actual, actual, b, BATCH_TEST_LEN);
+            }
+            else {
+                pasta_fq_mul_batch_with(backend, actual, actual, b, BATCH_TEST_LEN);
+            }
+            assert(memcmp(actual, expected, sizeof(actual)) == 0);
+        }
+    }
+
+    // Squaring through the field wrapper and the dispatched Fq kernel
+    for (size_t i = 0; i < BATCH_TEST_LEN; i++) {
+        fiat_pasta_fp_square(expected[i], a[i]);
+    }
+    field_sq_batch(actual, (const Field *)a, BATCH_TEST_LEN);
+    assert(memcmp(actual, expected, sizeof(actual)) == 0);
+
+    for (size_t i = 0; i < BATCH_TEST_LEN; i++) {
+        fiat_pasta_fq_mul(expected[i], a[i], b[i]);
+    }
+    pasta_fq_mul_batch(actual, (const uint64_t (*)[4])a, (const uint64_t (*)[4])b, BATCH_TEST_LEN);
+    assert(memcmp(actual, expected, sizeof(actual)) == 0);
+}
+
+void test_field_adx() {
+    if (!pasta_adx_supported()) {
+        if (_verbose) {
+            printf("ADX backend not supported, skipping\n");
+        }
+        return;
+    }
+
+    for (size_t field = 0; field < 2; field++) {
+        const uint64_t *minus_one = field == 0 ? FP_MINUS_ONE : FQ_MINUS_ONE;
+        void (*ref_mul)(uint64_t[4], const uint64_t[4], const uint64_t[4]) = field == 0 ? fiat_pasta_fp_mul : fiat_pasta_fq_mul;
+        void (*ref_sq)(uint64_t[4], const uint64_t[4]) = field == 0 ? fiat_pasta_fp_square : fiat_pasta_fq_square;
+        void (*adx_mul)(uint64_t[4], const uint64_t[4], const uint64_t[4]) = field == 0 ? pasta_fp_mul_adx : pasta_fq_mul_adx;
+        void (*adx_sq)(uint64_t[4], const uint64_t[4]) = field == 0 ? pasta_fp_square_adx : pasta_fq_square_adx;
+
+        for (size_t i = 0; i < 20000; i++) {
+            uint64_t a[4], b[4], expected[4], actual[4];
+            rand_element(a);
+            rand_element(b);
+            // Edge cases: zero, p - 1 and all-ones low words
+            if (i == 0) {
+                bzero(a, sizeof(a));
+            }
+            else if (i == 1) {
+                memcpy(a, minus_one, sizeof(a));
+                memcpy(b, minus_one, sizeof(b));
+            }
+            else if (i == 2) {
+                memcpy(a, minus_one, sizeof(a));
+                a[0] = a[1] = 0xffffffffffffffff;
+                a[3] = 0x3fffffffffffffff;
+            }
+
+            ref_mul(expected, a, b);
+            adx_mul(actual, a, b);
+            assert(memcmp(actual, expected, sizeof(actual)) == 0);
+
+            // In place
+            adx_mul(a, a, b);
+            assert(memcmp(a, expected, sizeof(a)) == 0);
+
+            ref_sq(expected, b);
+            adx_sq(actual, b);
+            assert(memcmp(actual, expected, sizeof(actual)) == 0);
+        }
+    }
+}
+
+void test_field_sparse() {
+    // Every element whose limbs are drawn from these boundary words (top
+    // limb masked below 2^62 or set to exactly 2^62), plus random elements
+    static const uint64_t words[] = {
+        0, 1, 2, 0xffffffff, 0x100000000, 0x7fffffffffffffff, 0x8000000000000000,
+        0xfffffffffffffffe, 0xffffffffffffffff, 0x992d30ed00000000, 0x224698fc094cf91b,
+        0x8c46eb2100000000, 0x224698fc0994a8dd
+    };
+    static const uint64_t tops[] = {
+        0, 1, 0x3fffffffffffffff, 0x4000000000000000, 0x8000000000000000, 0xffffffffffffffff
+    };
+    #define SPARSE_TEST_STRUCTURED (ARRAY_LEN(words)*ARRAY_LEN(words)*ARRAY_LEN(words)*ARRAY_LEN(tops))
+    #define SPARSE_TEST_RANDOM 20000
+
+    for (size_t field = 0; field < 2; field++) {
+        const uint64_t *minus_one = field == 0 ? FP_MINUS_ONE : FQ_MINUS_ONE;
+        void (*ref_mul)(uint64_t[4], const uint64_t[4], const uint64_t[4]) = field == 0 ? fiat_pasta_fp_mul : fiat_pasta_fq_mul;
+        void (*ref_sq)(uint64_t[4], const uint64_t[4]) = field == 0 ? fiat_pasta_fp_square : fiat_pasta_fq_square;
+        void (*ref_to)(uint64_t[4], const uint64_t[4]) = field == 0 ? fiat_pasta_fp_to_montgomery : fiat_pasta_fq_to_montgomery;
+        void (*ref_from)(uint64_t[4], const uint64_t[4]) = field == 0 ? fiat_pasta_fp_from_montgomery : fiat_pasta_fq_from_montgomery;
+        void (*sparse_mul)(uint64_t[4], const uint64_t[4], const uint64_t[4]) = field == 0 ? pasta_fp_mul_sparse : pasta_fq_mul_sparse;
+        void (*sparse_sq)(uint64_t[4], const uint64_t[4]) = field == 0 ? pasta_fp_square_sparse : pasta_fq_square_sparse;
+        void (*sparse_to)(uint64_t[4], const uint64_t[4]) = field == 0 ? pasta_fp_to_montgomery_sparse : pasta_fq_to_montgomery_sparse;
+        void (*sparse_from)(uint64_t[4], const uint64_t[4]) = field == 0 ? pasta_fp_from_montgomery_sparse : pasta_fq_from_montgomery_sparse;
+
+        uint64_t prev[4];
+        memcpy(prev, minus_one, sizeof(prev));
+        for (size_t i = 0; i < SPARSE_TEST_STRUCTURED + SPARSE_TEST_RANDOM; i++) {
+            uint64_t a[4], expected[4], actual[4];
+            if (i < SPARSE_TEST_STRUCTURED) {
+                size_t k = i;
+                for (size_t j = 0; j < 3; j++) {
+                    a[j] = words[k % ARRAY_LEN(words)];
+                    k /= ARRAY_LEN(words);
+                }
+                a[3] = tops[k];
+            }
+            else {
+                rand_element(a);
+                a[3] |= rand_u64() & 0xc000000000000000;
+            }
+
+            // Conversions accept any 256-bit input
+            ref_to(expected, a);
+            sparse_to(actual, a);
+            assert(memcmp(actual, expected, sizeof(actual)) == 0);
+
+            ref_from(expected, a);
+            sparse_from(actual, a);
+            assert(memcmp(actual, expected, sizeof(actual)) == 0);
+
+            // Multiplication and squaring need reduced inputs
+            if (a[3] > minus_one[3] || (a[3] == minus_one[3] && (a[2] || a[1] > minus_one[1] || (a[1] == minus_one[1] && a[0] > minus_one[0])))) {
+                continue;
+            }
+
+            ref_sq(expected, a);
+            sparse_sq(actual, a);
+            assert(memcmp(actual, expected, sizeof(actual)) == 0);
+
+            ref_mul(expected, a, prev);
+            sparse_mul(actual, a, prev);
+            assert(memcmp(actual, expected, sizeof(actual)) == 0);
+
+            ref_mul(expected, a, a);
+            sparse_mul(actual, a, a);
+            assert(memcmp(actual, expected, sizeof(actual)) == 0);
+
+            // In place, chaining each product into the next iteration
+            ref_mul(expected, a, prev);
+            sparse_mul(prev, a, prev);
+            assert(memcmp(prev, expected, sizeof(prev)) == 0);
+        }
+    }
+}
+
+void test_field_sum_of_products() {
+    #define SOP_TEST_MAX 7
+    static Field a[SOP_TEST_MAX], b[SOP_TEST_MAX];
+
+    for (size_t iter = 0; iter < 2000; iter++) {
+        for (size_t i = 0; i < SOP_TEST_MAX; i++) {
+            rand_element(a[i]);
+            rand_element(b[i]);
+            // Largest possible unreduced sums
+            if (iter == 0) {
+                memcpy(a[i], FP_MINUS_ONE, sizeof(a[i]));
+                memcpy(b[i], FP_MINUS_ONE, sizeof(b[i]));
+            }
+        }
+
+        for (size_t n = 0; n <= SOP_TEST_MAX; n++) {
+            Field expected = { 0, 0, 0, 0 };
+            for (size_t i = 0; i < n; i++) {
+                Field t, sum;
+                fiat_pasta_fp_mul(t, a[i], b[i]);
+                fiat_pasta_fp_add(sum, expected, t);
+                memcpy(expected, sum, sizeof(expected));
+            }
+
+            Field actual;
+            field_sum_of_products(actual, a, b, n);
+            assert(memcmp(actual, expected, sizeof(actual)) == 0);
+
+            if (n > PASTA_SUM_OF_PRODUCTS_MAX) {
+                continue;
+            }
+            pasta_fp_sum_of_products_sparse(actual, a, b, n);
+            assert(memcmp(actual, expected, sizeof(actual)) == 0);
+            if (pasta_adx_supported()) {
+                pasta_fp_sum_of_products_adx(actual, a, b, n);
+                assert(memcmp(actual, expected, sizeof(actual)) == 0);
+            }
+
+            // Scalar field, low level only
+            Scalar sexpected = { 0, 0, 0, 0 };
+            for (size_t i = 0; i < n; i++) {
+                Scalar t, sum;
+                fiat_pasta_fq_mul(t, a[i], b[i]);
+                fiat_pasta_fq_add(sum, sexpected, t);
+                memcpy(sexpected, sum, sizeof(sexpected));
+            }
+            pasta_fq_sum_of_products_sparse(actual, a, b, n);
+            assert(memcmp(actual, sexpected, sizeof(actual)) == 0);
+            if (pasta_adx_supported()) {
+                pasta_fq_sum_of_products_adx(actual, a, b, n);
+                assert(memcmp(actual, sexpected, sizeof(actual)) == 0);
+            }
+        }
+    }
+}
+
+void test_group_scalar_mul() {
+    static const uint64_t edge[][4] = {
+        { 0, 0, 0, 0 },
+        { 1, 0, 0, 0 },
+        { 2, 0, 0, 0 },
+        { 3, 0, 0, 0 },
+        { 0, 0, 0, 0x2000000000000000 },
+        { 0xffffffffffffffff, 0xffffffffffffffff, 0xffffffffffffffff, 0x3fffffffffffffff },
+        { 0x8c46eb2100000000, 0x224698fc0994a8dd, 0, 0x4000000000000000 }, // order - 1
+        { 0x8c46eb20ffffffff, 0x224698fc0994a8dd, 0, 0x4000000000000000 }, // order - 2
+        { 0x8c46eb20fffffffe, 0x224698fc0994a8dd, 0, 0x4000000000000000 }, // order - 3
+        { 0x73b914defffffffe, 0xddb96703f66b5722, 0xffffffffffffffff, 0x3fffffffffffffff }, // 2^255 - order - 1
+        { 0x73b914deffffffff, 0xddb96703f66b5722, 0xffffffffffffffff, 0x3fffffffffffffff }, // 2^255 - order
+        { 0xc623759080000000, 0x11234c7e04ca546e, 0, 0x2000000000000000 }, // (order - 1)/2
+        { 0xc623759080000001, 0x11234c7e04ca546e, 0, 0x2000000000000000 }, // (order + 1)/2
+    };
+
+    Affine g, p;
+    Scalar s;
+    uint64_t words[4] = { 1, 0, 0, 0 };
+    scalar_from_words(s, words);
+    generate_pubkey(&g, s);
+
+    // Second base point with an unrelated discrete log
+    rand_element(words);
+    scalar_from_words(s, words);
+    affine_scalar_mul(&p, s, &g);
+
+    for (size_t i = 0; i < ARRAY_LEN(edge) + 40; i++) {
+        Scalar k;
+        if (i < ARRAY_LEN(edge)) {
+            fiat_pasta_fq_to_montgomery(k, edge[i]);
+        }
+        else {
+            rand_element(words);
+            scalar_from_words(k, words);
+        }
+
+        const Affine *base = i % 2 ? &p : &g;
+        Group pp, scaled, r0, r1, r2;
+        affine_to_group(&pp, base);
+
+        // Same point with Z != 1 to take the group_add path
+        Field z, z2, z3;
+        rand_element(z);
+        field_sq(z2, z);
+        field_mul(z3, z2, z);
+        field_mul(scaled.X, pp.X, z2);
+        field_mul(scaled.Y, pp.Y, z3);
+        memcpy(scaled.Z, z, sizeof(z));
+
+        group_scalar_mul(&r0, k, &pp);
+        group_scalar_mul(&r1, k, &scaled);
+        group_scalar_mul_coz(&r2, k, base);
+
+        Affine a0, a1, a2;
+        affine_from_group(&a0, &r0);
+        affine_from_group(&a1, &r1);
+        affine_from_group(&a2, &r2);
+        assert(affine_eq(&a0, &a1));
+        assert(affine_eq(&a0, &a2));
+        assert(affine_is_on_curve(&a2));
+    }
+}
+
+#define MSM_TEST_MULTIPLES 16
+#define MSM_TEST_MAX       8192
+
+static Affine _msm_points[MSM_TEST_MAX];
+static Scalar _msm_scalars[MSM_TEST_MAX];
+
+void test_group_msm() {
+    static const size_t sizes[] = { 0, 1, 2, 3, 5, 64, 300, 2000, MSM_TEST_MAX };
+    static const size_t threads[] = { 1, 3 };
+
+    // _msm_points[j] = (j + 1)*G via a chain of mixed additions
+    Affine g;
+    Group acc, gg, tmp;
+    static Group chain[MSM_TEST_MAX];
+    uint64_t words[4] = { 1, 0, 0, 0 };
+    Scalar one;
+    scalar_from_words(one, words);
+    generate_pubkey(&g, one);
+    affine_to_group(&gg, &g);
+    acc = gg;
+    for (size_t j = 0; j < MSM_TEST_MAX; j++) {
+        chain[j] = acc;
+        group_madd(&tmp, &acc, &gg);
+        acc = tmp;
+    }
+    static Affine multiples[MSM_TEST_MAX];
+    affine_from_group_batch(multiples, chain, MSM_TEST_MAX);
+    for (size_t j = 0; j < MSM_TEST_MAX; j++) {
+        Affine expected;
+        affine_from_group(&expected, &chain[j]);
+        assert(affine_eq(&multiples[j], &expected));
+    }
+
+    for (size_t s = 0; s < ARRAY_LEN(sizes); s++) {
+        const size_t n = sizes[s];
+        for (size_t variant = 0; variant < 3; variant++) {
+            // Expected result e*G with e = sum k[i]*m[i], where P[i] = m[i]*G
+            Scalar e, m, term;
+            memset(words, 0, sizeof(words));
+            scalar_from_words(e, words);
+
+            for (size_t i = 0; i < n; i++) {
+                // Variant 0 has distinct points, variant 1 a few multiples
+                // with repeats, negations, zero scalars and infinity, and
+                // variant 2 one point and its negation with a fixed scalar
+                size_t j = i;
+                uint64_t r = 4;
+                if (variant == 1) {
+                    j = rand_u64() % MSM_TEST_MULTIPLES;
+                    r = rand_u64() % 8;
+                }
+                else if (variant == 2) {
+                    j = 0;
+                    r = rand_u64() % 2 ? 1 : 3;
+                }
+
+                words[0] = j + 1;
+                scalar_from_words(m, words);
+                _msm_points[i] = multiples[j];
+                if (r == 0) {
+                    memset(&_msm_points[i], 0, sizeof(Affine));
+                    memset(m, 0, sizeof(m));
+                }
+                else if (r == 1) {
+                    affine_negate(&_msm_points[i], &multiples[j]);
+                    scalar_negate(m, m);
+                }
+
+                rand_element(words);
+                if (r == 2) {
+                    memset(words, 0, sizeof(words));
+                }
+                scalar_from_words(_msm_scalars[i], words);
+                if (r == 3 || variant == 2) {
+                    pasta_fq_to_montgomery_sparse(_msm_scalars[i], FQ_MINUS_ONE);
+                }
+                scalar_mul(term, _msm_scalars[i], m);
+                scalar_add(e, e, term);
+                memset(words, 0, sizeof(words));
+            }
+
+            Group expected;
+            group_scalar_mul(&expected, e, &gg);
+            Affine a_expected;
+            affine_from_group(&a_expected, &expected);
+
+            for (size_t t = 0; t < ARRAY_LEN(threads); t++) {
+                Group actual;
+                group_msm_threads(&actual, _msm_scalars, _msm_points, n, threads[t]);
+
+                Affine a_actual;
+                affine_from_group(&a_actual, &actual);
+                assert(affine_eq(&a_actual, &a_expected));
+            }
+        }
+    }
+
+    // Window size grows with n
+    assert(msm_window_bits(1) == 2);
+    for (size_t n = 2; n < ((size_t)1 << 24); n *= 2) {
+        assert(msm_window_bits(n) >= msm_window_bits(n/2));
+    }
+}
+
+#define KEYGEN_TEST_KEYS 1500
+
+static Keypair _keygen_keypairs[KEYGEN_TEST_KEYS];
+static char _keygen_addresses[KEYGEN_TEST_KEYS][MINA_ADDRESS_LEN];
+
+void test_keygen_batch() {
+    static const uint64_t edge[][4] = {
+        { 0, 0, 0, 0 },
+        { 1, 0, 0, 0 },
+        { 0x7f, 0, 0, 0 },
+        { 0x80, 0, 0, 0 },
+        { 0xff, 0, 0, 0 },
+        { 0x8080808080808080, 0x8080808080808080, 0x8080808080808080, 0x0080808080808080 },
+        { 0xffffffffffffffff, 0xffffffffffffffff, 0xffffffffffffffff, 0x3fffffffffffffff },
+        { 0x8c46eb2100000000, 0x224698fc0994a8dd, 0, 0x4000000000000000 }, // order - 1
+    };
+
+    Scalar priv[ARRAY_LEN(edge) + 8];
+    Affine pub[ARRAY_LEN(priv)];
+    for (size_t i = 0; i < ARRAY_LEN(priv); i++) {
+        uint64_t words[4];
+        if (i < ARRAY_LEN(edge)) {
+            pasta_fq_to_montgomery_sparse(priv[i], edge[i]);
+        }
+        else {
+            rand_element(words);
+            scalar_from_words(priv[i], words);
+        }
+    }
+    generate_pubkeys_batch(pub, (const Scalar *)priv, ARRAY_LEN(priv));
+    for (size_t i = 0; i < ARRAY_LEN(priv); i++) {
+        Affine expected;
+        generate_pubkey(&expected, priv[i]);
+        assert(affine_eq(&pub[i], &expected));
+    }
+
+    // More than one chunk
+    assert(generate_keypairs_batch(_keygen_keypairs, KEYGEN_TEST_KEYS));
+    for (size_t i = 0; i < KEYGEN_TEST_KEYS; i += 7) {
+        Affine expected;
+        generate_pubkey(&expected, _keygen_keypairs[i].priv);
+        assert(affine_eq(&_keygen_keypairs[i].pub, &expected));
+        assert(!scalar_eq(_keygen_keypairs[i].priv, _keygen_keypairs[i + 1].priv));
+    }
+
+    static const size_t threads[] = { 1, 4 };
+    for (size_t t = 0; t < ARRAY_LEN(threads); t++) {
+        memset(_keygen_addresses, 0, sizeof(_keygen_addresses));
+        assert(generate_addresses_batch(&_keygen_addresses[0][0], _keygen_keypairs, KEYGEN_TEST_KEYS, threads[t]));
+        for (size_t i = 0; i < KEYGEN_TEST_KEYS; i += 3) {
+            char expected[MINA_ADDRESS_LEN];
+            assert(generate_address(expected, sizeof(expected), &_keygen_keypairs[i].pub));
+            assert(strcmp(_keygen_addresses[i], expected) == 0);
+        }
+    }
+}
+
+void test_vanity_search() {
+    assert(vanity_prefix_possible("B62q"));
+    assert(vanity_prefix_possible(""));
+    assert(!vanity_prefix_possible("B62q0"));   // not a base58 digit
+    assert(!vanity_prefix_possible("zzz"));
+    assert(!vanity_prefix_possible("1"));
+    assert(!vanity_prefix_possible("B62qoCvDGrbMFn5bj7PRmQC7CVvXzNQSoXXo5BmwVGTZUdUV3aCgkaKx"));
+
+    Keypair kp;
+    char address[MINA_ADDRESS_LEN], expected[MINA_ADDRESS_LEN];
+    uint64_t candidates;
+
+    // Every address matches, the first candidate is taken
+    assert(vanity_search(&kp, address, sizeof(address), "B62q", 1, 0, &candidates));
+    assert(candidates == 1);
+
+    // Five characters taken from a random address, one and two threads
+    char prefix[6];
+    memcpy(prefix, address, 5);
+    prefix[5] = '\0';
+    for (size_t threads = 1; threads <= 2; threads++) {
+        assert(vanity_search(&kp, address, sizeof(address), prefix, threads, 1000000, &candidates));
+        assert(candidates > 0);
+        assert(strncmp(address, prefix, strlen(prefix)) == 0);
+
+        Affine pub;
+        generate_pubkey(&pub, kp.priv);
+        assert(affine_eq(&pub, &kp.pub));
+        assert(generate_address(expected, sizeof(expected), &pub));
+        assert(strcmp(address, expected) == 0);
+    }
+
+    // A full address is out of reach, the search stops at the limit
+    assert(!vanity_search(&kp, address, sizeof(address), expected, 2, 3000, &candidates));
+    assert(candidates == 3000);
+}
+
+void test_base10() {
+    static const struct {
+        uint64_t x[4];
+        const char *dec;
+    } vectors[] = {
+        { { 0, 0, 0, 0 }, "0" },
+        { { 9, 0, 0, 0 }, "9" },
+        { { 9999999999999999999ull, 0, 0, 0 }, "9999999999999999999" },
+        { { 10000000000000000000ull, 0, 0, 0 }, "10000000000000000000" },
+        { { 0, 1, 0, 0 }, "18446744073709551616" },
+        { { 0x992d30ed00000001, 0x224698fc094cf91b, 0, 0x4000000000000000 },
+          "28948022309329048855892746252171976963363056481941560715954676764349967630337" },
+        { { 0x8c46eb2100000001, 0x224698fc0994a8dd, 0, 0x4000000000000000 },
+          "28948022309329048855892746252171976963363056481941647379679742748393362948097" },
+        { { UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX },
+          "115792089237316195423570985008687907853269984665640564039457584007913129639935" },
+    };
+
+    char dec[DIGITS + 1];
+    uint64_t x[4];
+    for (size_t i = 0; i < ARRAY_LEN(vectors); i++) {
+        assert(bigint_to_string(dec, vectors[i].x) == strlen(vectors[i].dec));
+        assert(strcmp(dec, vectors[i].dec) == 0);
+        assert(bigint_from_string(x, vectors[i].dec));
+        assert(memcmp(x, vectors[i].x, sizeof(x)) == 0);
+    }
+
+    // Against printf below 2^64, and round trips of every length
+    char expected[32];
+    for (size_t i = 0; i < 4000; i++) {
+        uint64_t y[4] = { 0, 0, 0, 0 };
+        const size_t limbs = 1 + i % 4;
+        for (size_t j = 0; j < limbs; j++) {
+            y[j] = rand_u64() >> (i % 64);
+        }
+        const size_t len = bigint_to_string(dec, y);
+        assert(len == strlen(dec) && (len == 1 || dec[0] != '0'));
+        if (limbs == 1) {
+            snprintf(expected, sizeof(expected), "%" PRIu64, y[0]);
+            assert(strcmp(dec, expected) == 0);
+        }
+        assert(bigint_from_string(x, dec));
+        assert(memcmp(x, y, sizeof(x)) == 0);
+    }
+
+    // Leading zeros are fine, anything else is not
+    char padded[101];
+    memset(padded, '0', 99);
+    strcpy(&padded[99], "7");
+    assert(bigint_from_string(x, padded) && x[0] == 7 && x[1] == 0 && x[2] == 0 && x[3] == 0);
+    assert(!bigint_from_string(x, ""));
+    assert(!bigint_from_string(x, "-1"));
+    assert(!bigint_from_string(x, "12a"));
+    assert(!bigint_from_string(x, "1 "));
+    assert(!bigint_from_string(x, "115792089237316195423570985008687907853269984665640564039457584007913129639936"));
+    assert(!bigint_from_string(x, "1000000000000000000000000000000000000000000000000000000000000000000000000000000"));
+}
+
+void test_base58_address() {
+    uint8_t bin[B58_ADDRESS_BYTES], expected_bin[B58_ADDRESS_BYTES];
+    char b58[B58_ADDRESS_DIGITS + 1], expected[B58_ADDRESS_DIGITS + 16];
+
+    // Encoding, against the generic encoder
+    for (size_t i = 0; i < 2000; i++) {
+        for (size_t j = 0; j < sizeof(bin); j += 8) {
+            const uint64_t r = rand_u64();
+            memcpy(&bin[j], &r, 8);
+        }
+        switch (i) {
+            case 0: memset(bin, 0xff, sizeof(bin)); break;
+            case 1: memset(bin, 0, sizeof(bin)); break;
+            case 2: bin[0] = 0xcb; break;
+            default:
+                // Short encodings from small leading bytes
+                if (i % 4 == 0) {
+                    bin[0] = rand_u64() % 4;
+                }
+        }
+
+        size_t len = sizeof(expected);
+        assert(b58enc(expected, &len, bin, sizeof(bin)));
+        const bool ok = b58enc_address(b58, bin);
+        assert(ok == (len == B58_ADDRESS_DIGITS + 1 && expected[0] != '1'));
+        if (ok) {
+            assert(strcmp(b58, expected) == 0);
+
+            assert(b58tobin_address(expected_bin, b58));
+            assert(memcmp(expected_bin, bin, sizeof(bin)) == 0);
+        }
+    }
+
+    // Decoding random digit strings, against the generic decoder
+    static const char digits[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    for (size_t i = 0; i < 2000; i++) {
+        for (size_t j = 0; j < B58_ADDRESS_DIGITS; j++) {
+            b58[j] = digits[rand_u64() % 58];
+        }
+        b58[B58_ADDRESS_DIGITS] = '\0';
+        if (i == 0) {
+            memset(b58, 'z', B58_ADDRESS_DIGITS);
+        }
+        else if (i == 1) {
+            memset(b58, '1', B58_ADDRESS_DIGITS);
+        }
+        else if (i % 3 == 0) {
+            b58[0] = digits[rand_u64() % 10];
+        }
+
+        size_t len = sizeof(expected_bin);
+        memset(expected_bin, 0, sizeof(expected_bin));
+        const bool expected_ok = b58tobin(expected_bin, &len, b58, B58_ADDRESS_DIGITS);
+        assert(b58tobin_address(bin, b58) == expected_ok);
+        if (expected_ok) {
+            assert(memcmp(bin, expected_bin, sizeof(bin)) == 0);
+        }
+    }
+
+    // Wrong length and invalid digits
+    const char *address = "B62qoCvDGrbMFn5bj7PRmQC7CVvXzNQSoXXo5BmwVGTZUdUV3aCgkaK";
+    assert(b58tobin_address(bin, address));
+    assert(b58enc_address(b58, bin));
+    assert(strcmp(b58, address) == 0);
+    strcpy(expected, address);
+    expected[10] = '0';
+    assert(!b58tobin_address(bin, expected));
+    expected[10] = 'l';
+    assert(!b58tobin_address(bin, expected));
+    expected[10] = (char)0xc3;
+    assert(!b58tobin_address(bin, expected));
+    assert(!b58tobin_address(bin, "B62qoCvDGrbMFn5bj7PRmQC7CVvXzNQSoXXo5BmwVGTZUdUV3aCgka"));
+    assert(!b58tobin_address(bin, "B62qoCvDGrbMFn5bj7PRmQC7CVvXzNQSoXXo5BmwVGTZUdUV3aCgkaKK"));
+}
+
+void test_sha256_many() {
+    static uint8_t msgs[19][200];
+    static uint8_t digests[19][SHA256_BLOCK_SIZE];
+    for (size_t i = 0; i < sizeof(msgs); i += 8) {
+        const uint64_t r = rand_u64();
+        memcpy(&msgs[0][0] + i, &r, 8);
+    }
+
+    static const size_t lengths[] = { 0, 1, 32, 36, 55, 56, 63, 64, 65, 119, 120, 200 };
+    for (size_t j = 0; j < ARRAY_LEN(lengths); j++) {
+        for (size_t n = 0; n <= ARRAY_LEN(msgs); n += 3) {
+            sha256_hash_many(msgs, sizeof(msgs[0]), lengths[j], digests, n);
+            for (size_t i = 0; i < n; i++) {
+                uint8_t expected[SHA256_BLOCK_SIZE];
+                sha256_hash(msgs[i], lengths[j], expected, sizeof(expected));
+                assert(memcmp(digests[i], expected, sizeof(expected)) == 0);
+            }
+        }
+    }
+
+    // In place, as used for double hashing
+    for (size_t i = 0; i < ARRAY_LEN(digests); i++) {
+        memcpy(digests[i], msgs[i], SHA256_BLOCK_SIZE);
+    }
+    sha256_hash_many(digests, SHA256_BLOCK_SIZE, SHA256_BLOCK_SIZE, digests, ARRAY_LEN(digests));
+    for (size_t i = 0; i < ARRAY_LEN(digests); i++) {
+        uint8_t expected[SHA256_BLOCK_SIZE];
+        sha256_hash(msgs[i], SHA256_BLOCK_SIZE, expected, sizeof(expected));
+        assert(memcmp(digests[i], expected, sizeof(expected)) == 0);
+    }
+}
+
+void test_sha256_backends() {
+    static const struct {
+        const char *msg;
+        const char *digest;
+    } vectors[] = {
+        { "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    };
+
+    static uint8_t msgs[17][1000];
+    static uint8_t expected[17][SHA256_BLOCK_SIZE];
+    static uint8_t digests[17][SHA256_BLOCK_SIZE];
+    for (size_t i = 0; i < sizeof(msgs); i += 8) {
+        const uint64_t r = rand_u64();
+        memcpy(&msgs[0][0] + i, &r, 8);
+    }
+
+    static const size_t lengths[] = { 0, 3, 36, 55, 56, 64, 127, 128, 1000 };
+    for (unsigned backend = SHA256_SIMD_GENERIC; backend <= SHA256_SIMD_AVX2; backend++) {
+        if (!sha256_simd_supported(backend)) {
+            continue;
+        }
+
+        for (size_t v = 0; v < ARRAY_LEN(vectors); v++) {
+            uint8_t digest[SHA256_BLOCK_SIZE];
+            char hex[2*SHA256_BLOCK_SIZE + 1];
+            sha256_hash_with(backend, vectors[v].msg, strlen(vectors[v].msg), digest);
+            for (size_t i = 0; i < sizeof(digest); i++) {
+                sprintf(&hex[2*i], "%02x", digest[i]);
+            }
+            assert(strcmp(hex, vectors[v].digest) == 0);
+        }
+
+        for (size_t j = 0; j < ARRAY_LEN(lengths); j++) {
+            for (size_t i = 0; i < ARRAY_LEN(msgs); i++) {
+                sha256_hash_with(SHA256_SIMD_GENERIC, msgs[i], lengths[j], expected[i]);
+                sha256_hash_with(backend, msgs[i], lengths[j], digests[i]);
+                assert(memcmp(digests[i], expected[i], SHA256_BLOCK_SIZE) == 0);
+            }
+
+            memset(digests, 0, sizeof(digests));
+            sha256_hash_many_with(backend, msgs, sizeof(msgs[0]), lengths[j], digests, ARRAY_LEN(msgs));
+            assert(memcmp(digests, expected, sizeof(expected)) == 0);
+        }
+    }
+
+    // Streaming in uneven pieces through the default backend
+    for (size_t step = 1; step < 150; step += 37) {
+        SHA256_CTX ctx;
+        sha256_init(&ctx);
+        for (size_t pos = 0; pos < sizeof(msgs[0]); pos += step) {
+            sha256_update(&ctx, &msgs[0][pos], pos + step <= sizeof(msgs[0]) ? step : sizeof(msgs[0]) - pos);
+        }
+        sha256_final(&ctx, digests[0]);
+        sha256_hash_with(SHA256_SIMD_GENERIC, msgs[0], sizeof(msgs[0]), expected[0]);
+        assert(memcmp(digests[0], expected[0], SHA256_BLOCK_SIZE) == 0);
+    }
+}
+
+static void hex_bytes(char *hex, const uint8_t *bytes, const size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        sprintf(&hex[2*i], "%02x", bytes[i]);
+    }
+}
+
+void test_blake2b_backends() {
+    // Keyed vectors from the BLAKE2 reference package (key and input are
+    // 0, 1, 2, ...), indexed by input length, and RFC 7693 "abc"
+    static const struct {
+        size_t len;
+        const char *digest;
+    } keyed[] = {
+        { 0,   "10ebb67700b1868efb4417987acf4690ae9d972fb7a590c2f02871799aaa4786b5e996e8f0f4eb981fc214b005f42d2ff4233499391653df7aefcbc13fc51568" },
+        { 1,   "961f6dd1e4dd30f63901690c512e78e4b45e4742ed197c3c5e45c549fd25f2e4187b0bc9fe30492b16b0d0bc4ef9b0f34c7003fac09a5ef1532e69430234cebd" },
+        { 255, "142709d62e28fcccd0af97fad0f8465b971e82201dc51070faa0372aa43e92484be1c1e73ba10906d5d1853db6a4106e0a7bf9800d373d6dee2d46d62ef2a461" },
+    };
+    static const char *abc = "ba80a53f981c4d0d6a2797b69f12f6e94c212f14685ac4b74b12bb6fdbffa2d17d87c5392aab792dc252d5de4533cc9518d38aa8dbf1925ab92386edd4009923";
+
+    uint8_t key[BLAKE2B_KEYBYTES];
+    static uint8_t buf[1000];
+    for (size_t i = 0; i < sizeof(key); i++) {
+        key[i] = i;
+    }
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = i;
+    }
+
+    uint8_t hash[BLAKE2B_OUTBYTES], expected[BLAKE2B_OUTBYTES];
+    char hex[2*BLAKE2B_OUTBYTES + 1];
+    for (unsigned backend = BLAKE2B_SIMD_GENERIC; backend <= BLAKE2B_SIMD_AVX2; backend++) {
+        if (!blake2b_simd_supported(backend)) {
+            continue;
+        }
+
+        for (size_t v = 0; v < ARRAY_LEN(keyed); v++) {
+            assert(blake2b_with(backend, hash, sizeof(hash), buf, keyed[v].len, key, sizeof(key)) == 0);
+            hex_bytes(hex, hash, sizeof(hash));
+            assert(strcmp(hex, keyed[v].digest) == 0);
+        }
+        assert(blake2b_with(backend, hash, sizeof(hash), "abc", 3, NULL, 0) == 0);
+        hex_bytes(hex, hash, sizeof(hash));
+        assert(strcmp(hex, abc) == 0);
+
+        // Every length of the reference self-test, keyed and not
+        for (size_t len = 0; len < 256; len++) {
+            blake2b_with(BLAKE2B_SIMD_GENERIC, expected, sizeof(expected), buf, len, key, sizeof(key));
+            blake2b_with(backend, hash, sizeof(hash), buf, len, key, sizeof(key));
+            assert(memcmp(hash, expected, sizeof(hash)) == 0);
+
+            blake2b_with(BLAKE2B_SIMD_GENERIC, expected, 32, buf, len, NULL, 0);
+            blake2b_with(backend, hash, 32, buf, len, NULL, 0);
+            assert(memcmp(hash, expected, 32) == 0);
+        }
+    }
+
+    // Streaming API in uneven steps, through the default backend
+    static const size_t steps[] = { 1, 3, 17, 64, 127 };
+    for (size_t s = 0; s < ARRAY_LEN(steps); s++) {
+        blake2b_state S;
+        assert(blake2b_init_key(&S, sizeof(hash), key, sizeof(key)) == 0);
+        for (size_t pos = 0; pos < 255; pos += steps[s]) {
+            assert(blake2b_update(&S, &buf[pos], pos + steps[s] <= 255 ? steps[s] : 255 - pos) == 0);
+        }
+        assert(blake2b_final(&S, hash, sizeof(hash)) == 0);
+        hex_bytes(hex, hash, sizeof(hash));
+        assert(strcmp(hex, keyed[2].digest) == 0);
+    }
+
+    // Batches of mixed lengths, including empty and whole block messages
+    static const size_t lengths[] = { 0, 1, 127, 128, 129, 256, 400, 1000, 3, 255, 128, 0, 600 };
+    const void *in[ARRAY_LEN(lengths)];
+    size_t inlen[ARRAY_LEN(lengths)];
+    static uint8_t digests[ARRAY_LEN(lengths)][32];
+    for (size_t i = 0; i < ARRAY_LEN(lengths); i++) {
+        in[i] = &buf[i];
+        inlen[i] = lengths[i] < sizeof(buf) - i ? lengths[i] : sizeof(buf) - i;
+    }
+    for (unsigned backend = BLAKE2B_SIMD_GENERIC; backend <= BLAKE2B_SIMD_AVX2; backend++) {
+        if (!blake2b_simd_supported(backend)) {
+            continue;
+        }
+        for (size_t n = 0; n <= ARRAY_LEN(lengths); n++) {
+            memset(digests, 0, sizeof(digests));
+            assert(blake2b_many_with(backend, digests, 32, in, inlen, n) == 0);
+            for (size_t i = 0; i < n; i++) {
+                blake2b_with(BLAKE2B_SIMD_GENERIC, expected, 32, in[i], inlen[i], NULL, 0);
+                assert(memcmp(digests[i], expected, 32) == 0);
+            }
+        }
+    }
+    assert(blake2b_many(digests, 0, in, inlen, 1) == -1);
+    assert(blake2b_many(digests, BLAKE2B_OUTBYTES + 1, in, inlen, 1) == -1);
+}
+
+// Encodes a 40 byte address payload with a valid checksum
+static void encode_raw_address(char *address, uint8_t raw[B58_ADDRESS_BYTES]) {
+    uint8_t hash[SHA256_BLOCK_SIZE];
+    sha256_hash(raw, B58_ADDRESS_BYTES - 4, hash, sizeof(hash));
+    sha256_hash(hash, sizeof(hash), hash, sizeof(hash));
+    memcpy(&raw[B58_ADDRESS_BYTES - 4], hash, 4);
+    assert(b58enc_address(address, raw));
+}
+
+#define PARSE_TEST_ADDRESSES 150
+
+// The serialization message_derive did before DeriveCtx
+static void derive_nonce_reference(Scalar out, const Keypair *kp, const ROInput *msg, const uint8_t network_id) {
+    static uint64_t fields[LIMBS_PER_FIELD * 8];
+    static uint8_t bits[128];
+    static uint8_t bytes[sizeof(fields) + sizeof(bits)];
+    ROInput input = { fields, bits, msg->fields_len, ARRAY_LEN(fields)/LIMBS_PER_FIELD, msg->bits_len, 8 * sizeof(bits) };
+    memcpy(fields, msg->fields, sizeof(uint64_t) * LIMBS_PER_FIELD * msg->fields_len);
+    memcpy(bits, msg->bits, (msg->bits_len + 7) / 8);
+    roinput_add_field(&input, kp->pub.x);
+    roinput_add_field(&input, kp->pub.y);
+    roinput_add_scalar(&input, kp->priv);
+    roinput_add_bytes(&input, &network_id, 1);
+
+    memset(bytes, 0, sizeof(bytes));
+    roinput_to_bytes(bytes, &input);
+    uint8_t hash[32];
+    blake2b(hash, 32, bytes, (input.bits_len + FIELD_SIZE_IN_BITS * input.fields_len + 7) / 8, NULL, 0);
+    hash[31] &= 0x3f;
+
+    uint64_t tmp[4];
+    memcpy(tmp, hash, sizeof(tmp));
+    pasta_fq_to_montgomery_sparse(out, tmp);
+}
+
+// Every forced configuration computes the same results as the detected one
+static void dispatch_outputs(uint8_t *out, const Field a[9], const Field b[9], const uint8_t msgs[9][200]) {
+    Field *fields = (Field *)out;
+    field_mul(fields[0], a[0], b[0]);
+    field_sq(fields[1], a[1]);
+    scalar_mul(fields[2], a[2], b[2]);
+    field_sum_of_products(fields[3], a, b, 9);
+    field_mul_batch(&fields[4], a, b, 9);
+
+    uint8_t *digests = out + 13*sizeof(Field);
+    sha256_hash_many(msgs, sizeof(msgs[0]), sizeof(msgs[0]), digests, 9);
+    sha256_hash(msgs[0], 55, digests + 9*SHA256_BLOCK_SIZE, SHA256_BLOCK_SIZE);
+    const void *ins[9];
+    size_t inlens[9];
+    for (size_t i = 0; i < 9; i++) {
+        ins[i] = msgs[i];
+        inlens[i] = 20*i;
+    }
+    assert(blake2b_many(digests + 10*SHA256_BLOCK_SIZE, 32, ins, inlens, 9) == 0);
+}
+
+void test_dispatch() {
+    static Field a[9], b[9];
+    static uint8_t msgs[9][200];
+    static uint8_t expected[13*sizeof(Field) + 19*32], actual[sizeof(expected)];
+    for (size_t i = 0; i < 9; i++) {
+        rand_element(a[i]);
+        rand_element(b[i]);
+        for (size_t j = 0; j < sizeof(msgs[0]); j++) {
+            msgs[i][j] = rand_u64();
+        }
+    }
+
+    const Dispatch saved = dispatch;
+    char described[128];
+    dispatch_describe(described, sizeof(described));
+    assert(strncmp(described, "field=", 6) == 0 && strstr(described, ",blake2b="));
+    dispatch_outputs(expected, a, b, msgs);
+
+    static const char *specs[] = {
+        "all=generic",
+        "field=sparse,field_batch=generic,sha256=generic,blake2b=generic",
+        "all=generic,field=auto",
+        "field=adx", "field_batch=avx2", "field_batch=ifma",
+        "sha256=shani", "sha256=avx2", "blake2b=avx2",
+        "",
+    };
+    for (size_t i = 0; i < ARRAY_LEN(specs); i++) {
+        const Dispatch before = dispatch;
+        if (!dispatch_configure(specs[i])) {
+            // Only refused for a backend this CPU lacks
+            assert(memcmp(&before, &dispatch, sizeof(dispatch)) == 0);
+            assert(i >= 3 && i < ARRAY_LEN(specs) - 1);
+            continue;
+        }
+        if (i < 2) {
+            assert(dispatch.field == DISPATCH_FIELD_SPARSE && dispatch.field_batch == PASTA_SIMD_GENERIC);
+            assert(dispatch.sha256 == SHA256_SIMD_GENERIC && dispatch.blake2b == BLAKE2B_SIMD_GENERIC);
+        }
+        memset(actual, 0, sizeof(actual));
+        dispatch_outputs(actual, a, b, msgs);
+        assert(memcmp(actual, expected, sizeof(expected)) == 0);
+    }
+
+    static const char *invalid[] = {
+        "field", "field=", "=adx", "field=avx2", "sha256=adx", "all=avx2",
+        "bogus=generic", "field=sparse,,sha256=generic", "Field=sparse",
+    };
+    const Dispatch before = dispatch;
+    for (size_t i = 0; i < ARRAY_LEN(invalid); i++) {
+        assert(!dispatch_configure(invalid[i]));
+        assert(memcmp(&before, &dispatch, sizeof(dispatch)) == 0);
+    }
+
+    dispatch = saved;
+}
+
+// A transaction with random amounts and keys, as a record
+static void rand_transaction(uint8_t record[TRANSACTION_BYTES], const Keypair *kp) {
+    Transaction txn;
+    memset(&txn, 0, sizeof(txn));
+    compress(&txn.fee_payer_pk, &kp->pub);
+    txn.source_pk = txn.fee_payer_pk;
+    Affine receiver;
+    Scalar k;
+    rand_element(k);
+    generate_pubkey(&receiver, k);
+    compress(&txn.receiver_pk, &receiver);
+    txn.fee = rand_u64();
+    txn.fee_token = DEFAULT_TOKEN_ID;
+    txn.nonce = rand_u64();
+    txn.valid_until = rand_u64();
+    txn.token_id = DEFAULT_TOKEN_ID;
+    txn.amount = rand_u64();
+    txn.tag[2] = rand_u64() & 1;
+    prepare_memo(txn.memo, "batch");
+    transaction_to_bytes(record, &txn);
+
+    uint8_t again[TRANSACTION_BYTES];
+    assert(transaction_from_bytes(&txn, record));
+    transaction_to_bytes(again, &txn);
+    assert(memcmp(again, record, TRANSACTION_BYTES) == 0);
+}
+
+#define CONTEXT_TEST_LEN 8
+
+void test_signer_context() {
+    static SignerContext ctx, testnet;
+    assert(!signer_context_init(&ctx, 0x02));
+    assert(signer_context_init(&ctx, MAINNET_ID));
+    assert(signer_context_init(&testnet, TESTNET_ID));
+
+    Keypair kps[2];
+    Compressed pubs[2];
+    for (size_t i = 0; i < 2; i++) {
+        Scalar k;
+        rand_element(k);
+        pasta_fq_to_montgomery_sparse(kps[i].priv, k);
+        generate_pubkey(&kps[i].pub, kps[i].priv);
+        compress(&pubs[i], &kps[i].pub);
+    }
+
+    // Keys change every other message, so the cached ones are both reused
+    // and replaced
+    for (size_t i = 0; i < CONTEXT_TEST_LEN; i++) {
+        const size_t key = (i >> 1) & 1;
+        uint8_t record[TRANSACTION_BYTES];
+        Transaction txn;
+        rand_transaction(record, &kps[key]);
+        assert(transaction_from_bytes(&txn, record));
+
+        Signature sig, expected;
+        sign_with_context(&ctx, &sig, &kps[key], &txn);
+        sign(&expected, &kps[key], &txn, MAINNET_ID);
+        assert(memcmp(&sig, &expected, sizeof(sig)) == 0);
+
+        assert(verify_with_context(&ctx, &sig, &pubs[key], &txn));
+        assert(verify(&sig, &pubs[key], &txn, MAINNET_ID));
+        assert(!verify_with_context(&testnet, &sig, &pubs[key], &txn));
+        assert(!verify_with_context(&ctx, &sig, &pubs[key ^ 1], &txn));
+        txn.amount ^= 1;
+        assert(!verify_with_context(&ctx, &sig, &pubs[key], &txn));
+    }
+
+    // A key that is not on the curve fails every time, also once cached
+    Compressed bad = pubs[0];
+    Affine pt;
+    while (decompress(&pt, &bad)) {
+        bad.x[0]++;
+    }
+    Transaction txn;
+    uint8_t record[TRANSACTION_BYTES];
+    Signature sig;
+    rand_transaction(record, &kps[0]);
+    assert(transaction_from_bytes(&txn, record));
+    sign_with_context(&ctx, &sig, &kps[0], &txn);
+    assert(!verify_with_context(&ctx, &sig, &bad, &txn));
+    assert(!verify_with_context(&ctx, &sig, &bad, &txn));
+    assert(verify_with_context(&ctx, &sig, &pubs[0], &txn));
+
+    signer_context_clear(&ctx);
+    signer_context_clear(&testnet);
+}
+
+void test_transaction_record() {
+    static SignerContext ctx;
+    assert(signer_context_init(&ctx, MAINNET_ID));
+
+    for (size_t i = 0; i < CONTEXT_TEST_LEN; i++) {
+        Keypair kp;
+        Scalar k;
+        rand_element(k);
+        pasta_fq_to_montgomery_sparse(kp.priv, k);
+        generate_pubkey(&kp.pub, kp.priv);
+
+        uint8_t record[TRANSACTION_BYTES], pub[COMPRESSED_BYTES];
+        uint8_t sig[SIGNATURE_BYTES], expected[SIGNATURE_BYTES];
+        Transaction txn;
+        Compressed compressed;
+        Signature s;
+        rand_transaction(record, &kp);
+        assert(transaction_from_bytes(&txn, record));
+        compress(&compressed, &kp.pub);
+        compressed_to_bytes(pub, &compressed);
+
+        assert(sign_record(&ctx, sig, &kp, record));
+        sign(&s, &kp, &txn, MAINNET_ID);
+        signature_to_bytes(expected, &s);
+        assert(memcmp(sig, expected, SIGNATURE_BYTES) == 0);
+        assert(verify_record(&ctx, sig, pub, record));
+
+        // Every byte of the record is signed
+        for (size_t j = 0; i == 0 && j < TRANSACTION_BYTES; j++) {
+            record[j] ^= 1;
+            assert(!verify_record(&ctx, sig, pub, record));
+            record[j] ^= 1;
+        }
+        // Malformed records, keys and signatures
+        record[TRANSACTION_BYTES - 1] = 1;
+        assert(!sign_record(&ctx, sig, &kp, record) && !verify_record(&ctx, expected, pub, record));
+        record[TRANSACTION_BYTES - 1] = 0;
+        memset(&record[40], 0xff, FIELD_BYTES);
+        assert(!sign_record(&ctx, sig, &kp, record));
+        assert(transaction_from_bytes(&txn, record) == false);
+        pub[COMPRESSED_BYTES - 1] = 2;
+        assert(!verify_record(&ctx, expected, pub, record));
+        expected[SIGNATURE_BYTES - 1] = 0xff;
+        pub[COMPRESSED_BYTES - 1] = compressed.is_odd;
+        assert(!verify_record(&ctx, expected, pub, record));
+    }
+
+    signer_context_clear(&ctx);
+}
+
+#define CACHE_TEST_LEN 4
+
+void test_signature_cache() {
+    static SignatureCache cache, failed;
+    static SignerContext ctx, testnet;
+    assert(!signature_cache_init(&failed, 0));
+    assert(signature_cache_init(&cache, 3));
+    assert(signer_context_init(&ctx, MAINNET_ID));
+    assert(signer_context_init(&testnet, TESTNET_ID));
+
+    Keypair kps[2];
+    for (size_t i = 0; i < 2; i++) {
+        Scalar k;
+        rand_element(k);
+        pasta_fq_to_montgomery_sparse(kps[i].priv, k);
+        generate_pubkey(&kps[i].pub, kps[i].priv);
+    }
+    Transaction txns[CACHE_TEST_LEN];
+    for (size_t i = 0; i < CACHE_TEST_LEN; i++) {
+        uint8_t record[TRANSACTION_BYTES];
+        rand_transaction(record, &kps[0]);
+        assert(transaction_from_bytes(&txns[i], record));
+    }
+
+    // A cache whose init failed still signs, without caching
+    SignatureCacheStats stats;
+    Signature sig, expected;
+    signature_cache_reset(&failed);
+    sign(&expected, &kps[0], &txns[0], MAINNET_ID);
+    for (size_t i = 0; i < 2; i++) {
+        assert(!sign_cached(&failed, &ctx, &sig, &kps[0], &txns[0]));
+        assert(memcmp(&sig, &expected, sizeof(sig)) == 0);
+    }
+    signature_cache_stats(&stats, &failed);
+    assert(stats.hits == 0 && stats.misses == 0 && stats.entries == 0 && stats.capacity == 0);
+    signature_cache_free(&failed);
+
+    // Oldest first: 0 1 2, 0 hit: 1 2 0, 3 evicts 1: 2 0 3, 1 evicts 2: 0 3 1,
+    // 0 hit: 3 1 0, 2 evicts 3: 1 0 2
+    const size_t order[] = { 0, 1, 2, 0, 3, 1, 0, 2 };
+    const bool hit[] = { false, false, false, true, false, false, true, false };
+    for (size_t i = 0; i < sizeof(order)/sizeof(order[0]); i++) {
+        Signature sig, expected;
+        assert(sign_cached(&cache, &ctx, &sig, &kps[0], &txns[order[i]]) == hit[i]);
+        sign(&expected, &kps[0], &txns[order[i]], MAINNET_ID);
+        assert(memcmp(&sig, &expected, sizeof(sig)) == 0);
+    }
+
+    // Another key or network is another entry
+    assert(!sign_cached(&cache, &testnet, &sig, &kps[0], &txns[2]));
+    sign(&expected, &kps[0], &txns[2], TESTNET_ID);
+    assert(memcmp(&sig, &expected, sizeof(sig)) == 0);
+    assert(!sign_cached(&cache, &ctx, &sig, &kps[1], &txns[2]));
+    sign(&expected, &kps[1], &txns[2], MAINNET_ID);
+    assert(memcmp(&sig, &expected, sizeof(sig)) == 0);
+
+    signature_cache_stats(&stats, &cache);
+    assert(stats.hits == 2 && stats.misses == 8 && stats.evictions == 5);
+    assert(stats.entries == 3 && stats.capacity == 3 && stats.hit_rate == 0.2);
+
+    signature_cache_reset(&cache);
+    signature_cache_stats(&stats, &cache);
+    assert(stats.hits == 0 && stats.entries == 0 && stats.hit_rate == 0.0);
+    assert(!sign_cached(&cache, &ctx, &sig, &kps[1], &txns[2]));
+    assert(sign_cached(&cache, &ctx, &sig, &kps[1], &txns[2]));
+    assert(memcmp(&sig, &expected, sizeof(sig)) == 0);
+
+    signature_cache_free(&cache);
+    signer_context_clear(&ctx);
+    signer_context_clear(&testnet);
+}
+
+#define ABI_TEST_LEN 6
+
+void test_minasigner() {
+    assert(minasigner_abi_version() == MINASIGNER_ABI_VERSION);
+
+    // The first sign_tx vector through the ABI
+    Transaction txn;
+    memset(&txn, 0, sizeof(txn));
+    Keypair kp;
+    assert(privkey_from_hex(kp.priv, "164244176fddb5d769b7de2027469d027ad428fadcc0c02396e6280142efb718"));
+    generate_pubkey(&kp.pub, kp.priv);
+    compress(&txn.fee_payer_pk, &kp.pub);
+    txn.source_pk = txn.fee_payer_pk;
+    read_public_key_compressed(&txn.receiver_pk, "B62qicipYxyEHu7QjUqS7QvBipTs5CzgkYZZZkPoKVYBu6tnDUcE9Zt");
+    txn.fee = 2000000000;
+    txn.fee_token = DEFAULT_TOKEN_ID;
+    txn.nonce = 16;
+    txn.valid_until = 271828;
+    txn.token_id = DEFAULT_TOKEN_ID;
+    txn.amount = 1729000000000;
+    prepare_memo(txn.memo, "Hello Mina!");
+
+    static uint8_t privkeys[ABI_TEST_LEN][MINASIGNER_PRIVKEY_BYTES];
+    static uint8_t pubkeys[ABI_TEST_LEN][MINASIGNER_PUBKEY_BYTES];
+    static uint8_t txns[ABI_TEST_LEN][MINASIGNER_TRANSACTION_BYTES];
+    static uint8_t sigs[ABI_TEST_LEN][MINASIGNER_SIGNATURE_BYTES];
+    uint8_t status[ABI_TEST_LEN];
+    char hex[2*SIGNATURE_BYTES + 1];
+    Signature sig;
+
+    scalar_to_bytes(privkeys[0], kp.priv);
+    transaction_to_bytes(txns[0], &txn);
+    assert(minasigner_sign_batch(sigs[0], status, privkeys[0], 0, txns[0], 1, MINASIGNER_TESTNET) == 1);
+    assert(status[0] == MINASIGNER_OK && signature_from_bytes(&sig, sigs[0]));
+    signature_to_hex(hex, &sig);
+    assert(strcmp(hex, "11a36a8dfe5b857b95a2a7b7b17c62c3ea33411ae6f4eb3a907064aecae353c6"
+                       "0794f1d0288322fe3f8bb69d6fabd4fd7c15f8d09f8783b2f087a80407e299af") == 0);
+
+    // One key for the whole batch, then one key per transaction
+    for (size_t stride = 0; stride <= MINASIGNER_PRIVKEY_BYTES; stride += MINASIGNER_PRIVKEY_BYTES) {
+        Keypair kps[ABI_TEST_LEN];
+        for (size_t i = 0; i < ABI_TEST_LEN; i++) {
+            Scalar k;
+            rand_element(k);
+            if (stride == 0 && i > 0) {
+                kps[i] = kps[0];
+            }
+            else {
+                pasta_fq_to_montgomery_sparse(kps[i].priv, k);
+                generate_pubkey(&kps[i].pub, kps[i].priv);
+            }
+            scalar_to_bytes(privkeys[i], kps[i].priv);
+            rand_transaction(txns[i], &kps[i]);
+        }
+
+        assert(minasigner_pubkeys(pubkeys[0], status, privkeys[0], ABI_TEST_LEN) == ABI_TEST_LEN);
+        assert(minasigner_sign_batch(sigs[0], status, privkeys[0], stride, txns[0], ABI_TEST_LEN,
+                                     MINASIGNER_MAINNET) == ABI_TEST_LEN);
+        for (size_t i = 0; i < ABI_TEST_LEN; i++) {
+            Compressed pub;
+            uint8_t expected[SIGNATURE_BYTES > COMPRESSED_BYTES ? SIGNATURE_BYTES : COMPRESSED_BYTES];
+            compress(&pub, &kps[i].pub);
+            compressed_to_bytes(expected, &pub);
+            assert(memcmp(pubkeys[i], expected, COMPRESSED_BYTES) == 0);
+
+            assert(transaction_from_bytes(&txn, txns[i]));
+            sign(&sig, &kps[i], &txn, MAINNET_ID);
+            signature_to_bytes(expected, &sig);
+            assert(status[i] == MINASIGNER_OK && memcmp(sigs[i], expected, SIGNATURE_BYTES) == 0);
+        }
+
+        const size_t pub_stride = stride ? MINASIGNER_PUBKEY_BYTES : 0;
+        assert(minasigner_verify_batch(status, sigs[0], pubkeys[0], pub_stride, txns[0], ABI_TEST_LEN,
+                                       MINASIGNER_MAINNET) == ABI_TEST_LEN);
+        assert(minasigner_verify_batch(NULL, sigs[0], pubkeys[0], pub_stride, txns[0], ABI_TEST_LEN,
+                                       MINASIGNER_TESTNET) == 0);
+    }
+
+    // Each record failing its own way
+    txns[1][32] ^= 1;                                // amount
+    txns[2][MINASIGNER_TRANSACTION_BYTES - 1] = 1;   // padding
+    pubkeys[3][MINASIGNER_PUBKEY_BYTES - 1] = 2;     // parity
+    sigs[4][MINASIGNER_SIGNATURE_BYTES - 1] = 0xff;  // s above the modulus
+    assert(minasigner_verify_batch(status, sigs[0], pubkeys[0], MINASIGNER_PUBKEY_BYTES, txns[0], ABI_TEST_LEN,
+                                   MINASIGNER_MAINNET) == 2);
+    assert(status[0] == MINASIGNER_OK && status[1] == MINASIGNER_BAD_SIGNATURE);
+    assert(status[2] == MINASIGNER_BAD_TRANSACTION && status[3] == MINASIGNER_BAD_PUBKEY);
+    assert(status[4] == MINASIGNER_BAD_SIGNATURE && status[5] == MINASIGNER_OK);
+    assert(minasigner_verify_batch(status, sigs[0], pubkeys[0], 0, txns[0], 1, 7) == 0);
+    assert(status[0] == MINASIGNER_BAD_NETWORK);
+
+    memset(privkeys[0], 0, MINASIGNER_PRIVKEY_BYTES);
+    memset(privkeys[5], 0xff, MINASIGNER_PRIVKEY_BYTES);
+    assert(minasigner_sign_batch(sigs[0], status, privkeys[0], MINASIGNER_PRIVKEY_BYTES, txns[0], ABI_TEST_LEN,
+                                 MINASIGNER_MAINNET) == 3);
+    assert(status[0] == MINASIGNER_BAD_PRIVKEY && status[5] == MINASIGNER_BAD_PRIVKEY);
+    assert(status[1] == MINASIGNER_OK && status[2] == MINASIGNER_BAD_TRANSACTION);
+    static const uint8_t zero_sig[MINASIGNER_SIGNATURE_BYTES];
+    assert(memcmp(sigs[0], zero_sig, sizeof(zero_sig)) == 0 && memcmp(sigs[2], zero_sig, sizeof(zero_sig)) == 0);
+    assert(minasigner_pubkeys(pubkeys[0], NULL, privkeys[0], ABI_TEST_LEN) == ABI_TEST_LEN - 2);
+
+    // Poseidon, short messages batched and long ones streamed
+    static const size_t lens[] = { 0, 1, 3, 70 };
+    static uint8_t fields[4*70][FIELD_BYTES];
+    static Field inputs[4*70];
+    Scalar expected[4];
+    uint8_t hashes[4][MINASIGNER_HASH_BYTES], expected_bytes[MINASIGNER_HASH_BYTES];
+    for (size_t i = 0; i < ARRAY_LEN(inputs); i++) {
+        uint64_t x[4];
+        rand_element(x);
+        pasta_fp_to_montgomery_sparse(inputs[i], x);
+        field_to_bytes(fields[i], inputs[i]);
+    }
+    for (size_t l = 0; l < ARRAY_LEN(lens); l++) {
+        for (uint8_t type = POSEIDON_LEGACY; type <= POSEIDON_KIMCHI; type++) {
+            assert(minasigner_poseidon_batch(hashes[0], fields[0], lens[l], 4, type, MINASIGNER_MAINNET) == 4);
+            for (size_t i = 0; i < 4; i++) {
+                PoseidonCtx ctx;
+                assert(poseidon_init(&ctx, type, MAINNET_ID));
+                poseidon_update(&ctx, &inputs[i*lens[l]], lens[l]);
+                poseidon_digest(expected[i], &ctx);
+                scalar_to_bytes(expected_bytes, expected[i]);
+                assert(memcmp(hashes[i], expected_bytes, sizeof(expected_bytes)) == 0);
+            }
+        }
+    }
+    memset(fields[5], 0xff, FIELD_BYTES);
+    assert(minasigner_poseidon_batch(hashes[0], fields[0], 3, 4, POSEIDON_KIMCHI, MINASIGNER_TESTNET) == 0);
+    assert(minasigner_poseidon_batch(hashes[0], fields[0], 1, 1, 2, MINASIGNER_TESTNET) == 0);
+}
+
+void test_derive_nonce() {
+    static uint64_t fields[LIMBS_PER_FIELD * 5];
+    static uint8_t bits[34]; // one byte of slack after the last message bit
+    for (size_t iter = 0; iter < 40; iter++) {
+        Keypair kp;
+        uint64_t x[4];
+        rand_element(x);
+        pasta_fp_to_montgomery_sparse(kp.pub.x, x);
+        rand_element(x);
+        pasta_fp_to_montgomery_sparse(kp.pub.y, x);
+        rand_element(x);
+        pasta_fq_to_montgomery_sparse(kp.priv, x);
+        const uint8_t network_id = iter < 2 ? (iter ? MAINNET_ID : TESTNET_ID) : rand_u64();
+
+        DeriveCtx ctx;
+        derive_init(&ctx, &kp, network_id);
+
+        // Every field count, and bit lengths around the word and block boundaries
+        for (size_t fields_len = 0; fields_len <= 5; fields_len++) {
+            for (size_t bits_len = 0; bits_len <= 8 * sizeof(bits) - 8; bits_len += 1 + iter % 7) {
+                for (size_t i = 0; i < fields_len; i++) {
+                    rand_element(x);
+                    pasta_fp_to_montgomery_sparse(&fields[LIMBS_PER_FIELD * i], x);
+                }
+                for (size_t i = 0; i < sizeof(bits); i++) {
+                    bits[i] = rand_u64();
+                }
+                // Bits past bits_len are garbage, derive_nonce must ignore them
+                ROInput msg = { fields, bits, fields_len, 5, bits_len, 8 * sizeof(bits) };
+
+                Scalar k, expected;
+                derive_nonce(k, &ctx, &msg);
+                if (bits_len % 8) {
+                    bits[bits_len / 8] &= (1 << (bits_len % 8)) - 1;
+                }
+                derive_nonce_reference(expected, &kp, &msg, network_id);
+                assert(scalar_eq(k, expected));
+            }
+        }
+        derive_clear(&ctx);
+    }
+}
+
+void test_parse_addresses_batch() {
+    static char addresses[PARSE_TEST_ADDRESSES][MINA_ADDRESS_LEN + 1];
+    static const char *ptrs[PARSE_TEST_ADDRESSES];
+    static AddressStatus expected[PARSE_TEST_ADDRESSES], status[PARSE_TEST_ADDRESSES];
+    static Compressed parsed[PARSE_TEST_ADDRESSES];
+
+    assert(generate_keypairs_batch(_keygen_keypairs, PARSE_TEST_ADDRESSES));
+    assert(generate_addresses_batch(_keygen_addresses[0], _keygen_keypairs, PARSE_TEST_ADDRESSES, 1));
+    for (size_t i = 0; i < PARSE_TEST_ADDRESSES; i++) {
+        strcpy(addresses[i], _keygen_addresses[i]);
+    }
+
+    static const uint64_t modulus[4] = {
+        0x992d30ed00000001, 0x224698fc094cf91b, 0x0000000000000000, 0x4000000000000000
+    };
+
+    size_t expected_valid = 0;
+    for (size_t i = 0; i < PARSE_TEST_ADDRESSES; i++) {
+        uint8_t raw[B58_ADDRESS_BYTES];
+        ptrs[i] = addresses[i];
+        expected[i] = ADDRESS_OK;
+        switch (i % 10) {
+            case 1:
+                addresses[i][20] = addresses[i][20] == 'a' ? 'b' : 'a';
+                expected[i] = ADDRESS_BAD_CHECKSUM;
+                break;
+            case 2:
+                addresses[i][54] = '\0';
+                expected[i] = ADDRESS_BAD_LENGTH;
+                break;
+            case 3:
+                addresses[i][55] = 'a';
+                addresses[i][56] = '\0';
+                expected[i] = ADDRESS_BAD_LENGTH;
+                break;
+            case 4:
+                addresses[i][30] = 'O';
+                expected[i] = ADDRESS_BAD_ENCODING;
+                break;
+            case 5:
+                assert(b58tobin_address(raw, addresses[i]));
+                raw[1] = 0x02;
+                encode_raw_address(addresses[i], raw);
+                expected[i] = ADDRESS_BAD_VERSION;
+                break;
+            case 6:
+                assert(b58tobin_address(raw, addresses[i]));
+                memcpy(&raw[3], modulus, sizeof(modulus));
+                encode_raw_address(addresses[i], raw);
+                expected[i] = ADDRESS_BAD_KEY;
+                break;
+            case 7:
+                assert(b58tobin_address(raw, addresses[i]));
+                raw[35] = 2;
+                encode_raw_address(addresses[i], raw);
+                expected[i] = ADDRESS_BAD_KEY;
+                break;
+            default:
+                expected_valid++;
+        }
+    }
+
+    assert(parse_addresses_batch(parsed, status, ptrs, PARSE_TEST_ADDRESSES) == expected_valid);
+    for (size_t i = 0; i < PARSE_TEST_ADDRESSES; i++) {
+        assert(status[i] == expected[i]);
+        if (status[i] == ADDRESS_OK) {
+            Compressed c;
+            compress(&c, &_keygen_keypairs[i].pub);
+            assert(field_eq(c.x, parsed[i].x) && c.is_odd == parsed[i].is_odd);
+        }
+    }
+
+    assert(parse_addresses_batch(parsed, status, ptrs, 0) == 0);
+}
+
+void test_poseidon_batch() {
+    #define POSEIDON_BATCH_TEST_N 11
+    #define POSEIDON_BATCH_TEST_MAX_LEN 5
+    static Field inputs[POSEIDON_BATCH_TEST_N*POSEIDON_BATCH_TEST_MAX_LEN];
+    static Scalar expected[POSEIDON_BATCH_TEST_N], actual[POSEIDON_BATCH_TEST_N];
+
+    for (size_t i = 0; i < ARRAY_LEN(inputs); i++) {
+        rand_element(inputs[i]);
+    }
+
+    const uint8_t types[2] = { POSEIDON_LEGACY, POSEIDON_KIMCHI };
+    for (size_t t = 0; t < ARRAY_LEN(types); t++) {
+        for (size_t len = 0; len <= POSEIDON_BATCH_TEST_MAX_LEN; len++) {
+            for (size_t i = 0; i < POSEIDON_BATCH_TEST_N; i++) {
+                PoseidonCtx ctx;
+                assert(poseidon_init(&ctx, types[t], TESTNET_ID));
+                poseidon_update(&ctx, &inputs[i*len], len);
+                poseidon_digest(expected[i], &ctx);
+            }
+
+            assert(poseidon_hash_batch(actual, types[t], TESTNET_ID, inputs, len, POSEIDON_BATCH_TEST_N));
+            assert(memcmp(actual, expected, sizeof(actual)) == 0);
+        }
+    }
+}
+
 void test_poseidon() {
     //
     // Legacy tests
@@ -905,6 +2441,88 @@ void test_sign_tx() {
       }
 }
 
+void print_op_counts(const char *name) {
+    OpCounts c;
+    op_counts_snapshot(&c);
+    printf("%-16s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+           name, c.field_mul, c.field_sq, c.field_inv, c.scalar_mul,
+           c.group_add, c.group_madd, c.group_dbl, c.group_coz_add);
+    op_counts_reset();
+}
+
+// Operations performed by one call of each top level function
+void ops_report() {
+    if (!op_counters_enabled()) {
+        printf("Built without OP_COUNTERS, run make clean && make OP_COUNTERS=1\n");
+        return;
+    }
+
+    printf("%-16s %10s %10s %10s %10s %10s %10s %10s %10s\n", "operation",
+           "field_mul", "field_sq", "field_inv", "scalar_mul", "group_add", "group_madd", "group_dbl", "coz_add");
+
+    Keypair kp;
+    uint64_t words[4];
+    rand_element(words);
+    scalar_from_words(kp.priv, words);
+
+    op_counts_reset();
+    generate_pubkey(&kp.pub, kp.priv);
+    print_op_counts("generate_pubkey");
+
+    char address[MINA_ADDRESS_LEN];
+    generate_address(address, sizeof(address), &kp.pub);
+    print_op_counts("generate_address");
+
+    Field input[3];
+    for (size_t i = 0; i < ARRAY_LEN(input); i++) {
+        rand_element(words);
+        pasta_fp_to_montgomery_sparse(input[i], words);
+    }
+    static const uint8_t types[2] = { POSEIDON_LEGACY, POSEIDON_KIMCHI };
+    static const char *type_names[2] = { "poseidon_legacy", "poseidon_kimchi" };
+    for (size_t i = 0; i < 2; i++) {
+        PoseidonCtx ctx;
+        Scalar out;
+        op_counts_reset();
+        poseidon_init(&ctx, types[i], MAINNET_ID);
+        poseidon_update(&ctx, input, ARRAY_LEN(input));
+        poseidon_digest(out, &ctx);
+        print_op_counts(type_names[i]);
+    }
+
+    Transaction txn;
+    prepare_memo(txn.memo, "this is a memo");
+    txn.fee = 3;
+    txn.fee_token = DEFAULT_TOKEN_ID;
+    read_public_key_compressed(&txn.fee_payer_pk, address);
+    txn.nonce = 200;
+    txn.valid_until = 10000;
+    txn.tag[0] = 0;
+    txn.tag[1] = 0;
+    txn.tag[2] = 0;
+    txn.source_pk = txn.fee_payer_pk;
+    read_public_key_compressed(&txn.receiver_pk, "B62qrcFstkpqXww1EkSGrqMCwCNho86kuqBd4FrAAUsPxNKdiPzAUsy");
+    txn.token_id = DEFAULT_TOKEN_ID;
+    txn.amount = 42;
+    txn.token_locked = false;
+
+    // sign and verify use the generator table of keygen.h, which is built
+    // once on first use; build it here so its setup is not counted
+    Group table_warmup;
+    generator_mul_public(&table_warmup, kp.priv);
+
+    Signature sig;
+    op_counts_reset();
+    sign(&sig, &kp, &txn, MAINNET_ID);
+    print_op_counts("sign");
+
+    Compressed pub_compressed;
+    compress(&pub_compressed, &kp.pub);
+    op_counts_reset();
+    assert(verify(&sig, &pub_compressed, &txn, MAINNET_ID));
+    print_op_counts("verify");
+}
+
 int main(int argc, char* argv[]) {
   printf("Running unit tests\n");
 
@@ -912,6 +2530,9 @@ int main(int argc, char* argv[]) {
     if (strncmp(argv[1], "ledger_gen", 10) == 0) {
         _ledger_gen = true;
     }
+    else if (strcmp(argv[1], "ops") == 0) {
+        _ops = true;
+    }
     else {
         _verbose = true;
     }
@@ -922,6 +2543,11 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  if (_ops) {
+    ops_report();
+    return 0;
+  }
+
   // Perform crypto tests
   if (!curve_checks()) {
       // Dump computed c-reference signer constants
@@ -946,16 +2572,59 @@ int main(int argc, char* argv[]) {
     assert(!decompress(&pub, &bad_pk));
   }
 
+  test_base10();
+
+  test_base58_address();
+
   test_scalars();
 
   test_fields();
 
+  test_field_bytes();
+
+  test_field_batch();
+
+  test_op_counters();
+
+  test_field_adx();
+
+  test_field_sparse();
+
+  test_field_sum_of_products();
+
+  test_group_scalar_mul();
+
+  test_group_msm();
+
+  test_keygen_batch();
+
+  test_vanity_search();
+
+  test_sha256_many();
+  test_sha256_backends();
+  test_blake2b_backends();
+  test_dispatch();
+
+  test_derive_nonce();
+
+  test_parse_addresses_batch();
+
   test_poseidon();
 
+  test_poseidon_batch();
+
   test_get_address();
 
   test_sign_tx();
 
+  test_minasigner();
+
+  test_signer_context();
+
+  test_transaction_record();
+
+  test_signature_cache();
+
   printf("Unit tests completed successfully\n");
 
   return 0;
@@ -1,5 +1,18 @@
+#include <string.h>
+
 #include "utils.h"
 
+void secure_bzero(void *p, const size_t len) {
+#if defined(__GNUC__) || defined(__clang__)
+  memset(p, 0, len);
+  // The compiler must assume the asm reads the zeroed memory through p
+  __asm__ __volatile__("" : : "r"(p) : "memory");
+#else
+  static void *(*const volatile memset_v)(void *, int, size_t) = &memset;
+  memset_v(p, 0, len);
+#endif
+}
+
 // Not constant time
 void packed_bit_array_set(uint8_t *bits, size_t i, bool b) {
   size_t byte_idx = i / 8;
@@ -18,3 +31,57 @@ bool packed_bit_array_get(uint8_t *bits, size_t i) {
 
   return (bits[byte_idx] >> in_byte_idx) & 1;
 }
+
+static const char hex_pairs[513] =
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+// Value of each hex digit, -1 for anything else
+static const int8_t hex_values[256] = {
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+     0, 1, 2, 3, 4, 5, 6, 7,  8, 9,-1,-1,-1,-1,-1,-1,
+    -1,10,11,12,13,14,15,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,10,11,12,13,14,15,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1, -1,-1,-1,-1,-1,-1,-1,-1,
+};
+
+void hex_encode(char *hex, const uint8_t *bytes, const size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    hex[2*i] = hex_pairs[2*bytes[i]];
+    hex[2*i + 1] = hex_pairs[2*bytes[i] + 1];
+  }
+  hex[2*len] = '\0';
+}
+
+// Stops at the first bad digit, so never reads past the null of a short string
+bool hex_decode(uint8_t *bytes, const char *hex, const size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    const int8_t hi = hex_values[(uint8_t)hex[2*i]];
+    if (hi < 0) {
+      return false;
+    }
+    const int8_t lo = hex_values[(uint8_t)hex[2*i + 1]];
+    if (lo < 0) {
+      return false;
+    }
+    bytes[i] = (uint8_t)(hi << 4 | lo);
+  }
+  return true;
+}
@@ -1,6 +1,19 @@
+#pragma once
+
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 
+// Zeroes len bytes of secret data.  Unlike a memset or bzero just before
+// the memory goes out of scope or is freed, this is not removed as a dead
+// store by the compiler or by link time optimization.
+void secure_bzero(void *p, const size_t len);
+
 void packed_bit_array_set(uint8_t *bits, size_t i, bool b);
 bool packed_bit_array_get(uint8_t *bits, size_t i);
+
+// Lowercase hex of len bytes, in order: 2*len digits and a null
+void hex_encode(char *hex, const uint8_t *bytes, const size_t len);
+// Parses the first 2*len characters of hex, either case, into len bytes.
+// Returns false if any of them is not a hex digit (including a null).
+bool hex_decode(uint8_t *bytes, const char *hex, const size_t len);
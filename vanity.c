@@ -0,0 +1,280 @@
+// Vanity address search
+//
+//     An address is the base58 encoding of 40 bytes: version (0xcb, 0x01,
+//     0x01), x (32 bytes, little endian), the parity of y and a 4 byte
+//     checksum.  Base58 preserves numeric order, so all addresses starting
+//     with a prefix form one range of 40 byte strings, found once by
+//     decoding the prefix padded with '1's and with 'z's.  Candidates are
+//     compared against that range on their first 36 bytes; only a
+//     candidate that ties with a bound needs the checksum and the full
+//     encoding.
+//
+//     Candidates are k + 1, k + 2, ... for a random k per thread, one mixed
+//     addition of the generator each, normalized in batches with a single
+//     inversion.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "vanity.h"
+#include "keygen.h"
+#include "libbase58.h"
+#include "pasta_sparse.h"
+#include "utils.h"
+
+#define VANITY_RAW_BYTES     40
+#define VANITY_RANGE_BYTES   36 // everything but the checksum
+#define VANITY_ADDRESS_CHARS (MINA_ADDRESS_LEN - 1)
+#define VANITY_BATCH         1024
+#define VANITY_THREAD_STACK  (256*1024)
+
+typedef struct vanity_range_t {
+    uint8_t lo[VANITY_RAW_BYTES];
+    uint8_t hi[VANITY_RAW_BYTES];
+} VanityRange;
+
+typedef struct vanity_shared_t {
+    VanityRange range;
+    const char *prefix;
+    size_t prefix_len;
+    uint64_t max_candidates;
+    Group g;
+
+    atomic_bool found;
+    atomic_uint_fast64_t budget;  // candidates handed out to threads
+    atomic_uint_fast64_t checked;
+    Keypair keypair;
+    char address[MINA_ADDRESS_LEN];
+} VanityShared;
+
+typedef struct vanity_worker_t {
+    VanityShared *shared;
+    Keypair start;
+} VanityWorker;
+
+// Decodes prefix padded to a full address with pad, false on overflow
+static bool decode_padded(uint8_t out[VANITY_RAW_BYTES], const char *prefix, const size_t prefix_len, const char pad)
+{
+    char padded[VANITY_ADDRESS_CHARS];
+    memcpy(padded, prefix, prefix_len);
+    memset(&padded[prefix_len], pad, sizeof(padded) - prefix_len);
+
+    size_t len = VANITY_RAW_BYTES;
+    memset(out, 0, VANITY_RAW_BYTES);
+    return b58tobin(out, &len, padded, sizeof(padded));
+}
+
+static bool prefix_range(VanityRange *range, const char *prefix)
+{
+    const size_t prefix_len = strlen(prefix);
+    if (prefix_len > VANITY_ADDRESS_CHARS) {
+        return false;
+    }
+
+    // Also rejects invalid base58 digits
+    if (!decode_padded(range->lo, prefix, prefix_len, '1')) {
+        return false;
+    }
+    if (!decode_padded(range->hi, prefix, prefix_len, 'z')) {
+        // Above the largest 40 byte string, only the lower bound matters
+        memset(range->hi, 0xff, VANITY_RAW_BYTES);
+    }
+
+    // Every address lies within version || 0^32 || 0 and version || 1^256 || 1
+    uint8_t min[VANITY_RANGE_BYTES] = { 0xcb, 0x01, 0x01 };
+    uint8_t max[VANITY_RANGE_BYTES] = { 0xcb, 0x01, 0x01 };
+    memset(&max[3], 0xff, 32);
+    max[35] = 0x01;
+    return memcmp(range->lo, max, VANITY_RANGE_BYTES) <= 0
+        && memcmp(range->hi, min, VANITY_RANGE_BYTES) >= 0;
+}
+
+bool vanity_prefix_possible(const char *prefix)
+{
+    VanityRange range;
+    return prefix_range(&range, prefix);
+}
+
+static bool matches(const VanityShared *s, const Affine *p)
+{
+    uint8_t raw[VANITY_RANGE_BYTES] = { 0xcb, 0x01, 0x01 };
+    uint64_t x[4];
+    pasta_fp_from_montgomery_sparse(x, p->x);
+    memcpy(&raw[3], x, sizeof(x));
+    raw[35] = field_is_odd(p->y);
+
+    const int lo = memcmp(raw, s->range.lo, VANITY_RANGE_BYTES);
+    const int hi = memcmp(raw, s->range.hi, VANITY_RANGE_BYTES);
+    if (lo < 0 || hi > 0) {
+        return false;
+    }
+    if (lo > 0 && hi < 0) {
+        return true;
+    }
+
+    // Ties with a bound, depends on the checksum
+    char address[MINA_ADDRESS_LEN];
+    return generate_address(address, sizeof(address), p)
+        && strncmp(address, s->prefix, s->prefix_len) == 0;
+}
+
+static void report(VanityShared *s, const Keypair *start, const uint64_t offset, const Affine *p)
+{
+    if (atomic_exchange(&s->found, true)) {
+        return;
+    }
+
+    Scalar step;
+    const uint64_t words[4] = { offset, 0, 0, 0 };
+    scalar_from_words(step, words);
+    scalar_add(s->keypair.priv, start->priv, step);
+    s->keypair.pub = *p;
+    generate_address(s->address, sizeof(s->address), p);
+}
+
+static void *search(void *arg)
+{
+    VanityWorker *w = arg;
+    VanityShared *s = w->shared;
+
+    Group *chain = malloc(VANITY_BATCH*sizeof(Group));
+    Affine *points = malloc(VANITY_BATCH*sizeof(Affine));
+    if (!chain || !points) {
+        free(points);
+        free(chain);
+        return NULL;
+    }
+
+    Group cur;
+    affine_to_group(&cur, &w->start.pub);
+    uint64_t offset = 0; // cur = (start + offset) * G
+    while (!atomic_load(&s->found)) {
+        size_t count = VANITY_BATCH;
+        if (s->max_candidates) {
+            const uint64_t claimed = atomic_fetch_add(&s->budget, VANITY_BATCH);
+            if (claimed >= s->max_candidates) {
+                break;
+            }
+            if (s->max_candidates - claimed < count) {
+                count = s->max_candidates - claimed;
+            }
+        }
+
+        group_madd(&chain[0], &cur, &s->g);
+        for (size_t i = 1; i < count; i++) {
+            group_madd(&chain[i], &chain[i - 1], &s->g);
+        }
+        affine_from_group_batch(points, chain, count);
+
+        size_t checked = 0;
+        while (checked < count) {
+            if (matches(s, &points[checked++])) {
+                report(s, &w->start, offset + checked, &points[checked - 1]);
+                break;
+            }
+        }
+        atomic_fetch_add(&s->checked, checked);
+
+        cur = chain[count - 1];
+        offset += count;
+    }
+
+    free(points);
+    free(chain);
+    return NULL;
+}
+
+bool vanity_search(Keypair *keypair, char *address, const size_t len, const char *prefix,
+                   const size_t threads, const uint64_t max_candidates, uint64_t *candidates)
+{
+    if (candidates) {
+        *candidates = 0;
+    }
+    if (len != MINA_ADDRESS_LEN) {
+        return false;
+    }
+
+    VanityShared *s = calloc(1, sizeof(VanityShared));
+    if (!s) {
+        return false;
+    }
+    if (!prefix_range(&s->range, prefix)) {
+        free(s);
+        return false;
+    }
+    s->prefix = prefix;
+    s->prefix_len = strlen(prefix);
+    s->max_candidates = max_candidates;
+    atomic_init(&s->found, false);
+    atomic_init(&s->budget, 0);
+    atomic_init(&s->checked, 0);
+
+    Affine g;
+    Scalar one;
+    const uint64_t words[4] = { 1, 0, 0, 0 };
+    scalar_from_words(one, words);
+    generate_pubkey(&g, one);
+    affine_to_group(&s->g, &g);
+
+    const size_t nthreads = threads < 1 ? 1 : threads;
+    VanityWorker *workers = calloc(nthreads, sizeof(VanityWorker));
+    Keypair *starts = malloc(nthreads*sizeof(Keypair));
+    pthread_t *tids = calloc(nthreads, sizeof(pthread_t));
+    bool *spawned = calloc(nthreads, sizeof(bool));
+
+    if (workers && starts && tids && spawned && generate_keypairs_batch(starts, nthreads)) {
+        for (size_t t = 0; t < nthreads; t++) {
+            workers[t].shared = s;
+            workers[t].start = starts[t];
+        }
+
+        pthread_attr_t attr;
+        const bool attr_ok = nthreads > 1 && pthread_attr_init(&attr) == 0;
+        if (attr_ok) {
+            pthread_attr_setstacksize(&attr, VANITY_THREAD_STACK);
+        }
+        for (size_t t = 1; attr_ok && t < nthreads; t++) {
+            spawned[t] = pthread_create(&tids[t], &attr, search, &workers[t]) == 0;
+        }
+
+        // Anything that could not be spawned runs on this thread
+        for (size_t t = 0; t < nthreads; t++) {
+            if (!spawned[t]) {
+                search(&workers[t]);
+            }
+        }
+        for (size_t t = 1; t < nthreads; t++) {
+            if (spawned[t]) {
+                pthread_join(tids[t], NULL);
+            }
+        }
+        if (attr_ok) {
+            pthread_attr_destroy(&attr);
+        }
+    }
+
+    const bool found = atomic_load(&s->found);
+    if (found) {
+        *keypair = s->keypair;
+        memcpy(address, s->address, MINA_ADDRESS_LEN);
+    }
+    if (candidates) {
+        *candidates = atomic_load(&s->checked);
+    }
+
+    if (starts) {
+        secure_bzero(starts, nthreads*sizeof(Keypair));
+    }
+    if (workers) {
+        secure_bzero(workers, nthreads*sizeof(VanityWorker));
+    }
+    secure_bzero(s, sizeof(*s));
+    free(spawned);
+    free(tids);
+    free(starts);
+    free(workers);
+    free(s);
+    return found;
+}
@@ -0,0 +1,20 @@
+// Vanity address search
+//
+//     vanity_search looks for a keypair whose address starts with prefix
+//     (including the fixed "B62q").  Each thread starts from a random key k
+//     and walks k, k + 1, k + 2, ... with one mixed addition per candidate.
+//     Returns false if the prefix cannot occur or nothing was found within
+//     max_candidates (0 for no limit); *candidates receives the number of
+//     keys checked.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crypto.h"
+
+bool vanity_prefix_possible(const char *prefix);
+bool vanity_search(Keypair *keypair, char *address, const size_t len, const char *prefix,
+                   const size_t threads, const uint64_t max_candidates, uint64_t *candidates);